@@ -0,0 +1,642 @@
+
+/* Generated by the introspection codegen tool for protocol my_proto. Do not edit. */
+
+#include <introspection/sample_chat.h>
+
+EXTERN_PROTOCOL(my_proto);
+
+#include <introspection/codegen.h>
+
+namespace
+{
+
+void encode(LoginPacket const &p, introspection::stream &s)
+{
+    introspection::gen::put(p.version, s);
+    introspection::gen::put(p.name, s);
+    introspection::gen::put(p.password, s);
+}
+
+void decode(LoginPacket &p, introspection::stream &s)
+{
+    introspection::gen::get(p.version, s);
+    introspection::gen::get(p.name, s);
+    introspection::gen::get(p.password, s);
+}
+
+void to_text(LoginPacket const &p, std::string &oStr)
+{
+    oStr = "[ ";
+    introspection::gen::text(p.version, oStr);
+    introspection::gen::text(p.name, oStr);
+    introspection::gen::text(p.password, oStr);
+    oStr += "] ";
+}
+
+void encode_LoginPacket(void const *p, introspection::stream &s)
+{
+    encode(*(LoginPacket const *)p, s);
+}
+
+void decode_LoginPacket(void *p, introspection::stream &s)
+{
+    decode(*(LoginPacket *)p, s);
+}
+
+void to_text_LoginPacket(void const *p, std::string &oStr)
+{
+    to_text(*(LoginPacket const *)p, oStr);
+}
+
+introspection::generated_codec_t const codec_LoginPacket = {
+    &encode_LoginPacket, &decode_LoginPacket, &to_text_LoginPacket
+};
+
+introspection::generated_member_t const layout_LoginPacket[] = {
+    { "version", 0, 4 },
+    { "name", 8, 32 },
+    { "password", 40, 32 },
+};
+
+bool const registered_LoginPacket = introspection::register_generated_codec(
+    LoginPacket::member_info(), codec_LoginPacket, layout_LoginPacket, 3);
+
+void encode(UserInfo const &p, introspection::stream &s)
+{
+    introspection::gen::put(p.name, s);
+    introspection::gen::put(p.email, s);
+    introspection::gen::put(p.password, s);
+    introspection::gen::put(p.shoe_size, s);
+}
+
+void decode(UserInfo &p, introspection::stream &s)
+{
+    introspection::gen::get(p.name, s);
+    introspection::gen::get(p.email, s);
+    introspection::gen::get(p.password, s);
+    introspection::gen::get(p.shoe_size, s);
+}
+
+void to_text(UserInfo const &p, std::string &oStr)
+{
+    oStr = "[ ";
+    introspection::gen::text(p.name, oStr);
+    introspection::gen::text(p.email, oStr);
+    introspection::gen::text(p.password, oStr);
+    introspection::gen::text(p.shoe_size, oStr);
+    oStr += "] ";
+}
+
+void encode_UserInfo(void const *p, introspection::stream &s)
+{
+    encode(*(UserInfo const *)p, s);
+}
+
+void decode_UserInfo(void *p, introspection::stream &s)
+{
+    decode(*(UserInfo *)p, s);
+}
+
+void to_text_UserInfo(void const *p, std::string &oStr)
+{
+    to_text(*(UserInfo const *)p, oStr);
+}
+
+introspection::generated_codec_t const codec_UserInfo = {
+    &encode_UserInfo, &decode_UserInfo, &to_text_UserInfo
+};
+
+introspection::generated_member_t const layout_UserInfo[] = {
+    { "name", 0, 32 },
+    { "email", 32, 32 },
+    { "password", 64, 32 },
+    { "shoe_size", 96, 4 },
+};
+
+bool const registered_UserInfo = introspection::register_generated_codec(
+    UserInfo::member_info(), codec_UserInfo, layout_UserInfo, 4);
+
+void encode(ConnectedPacket const &p, introspection::stream &s)
+{
+#if !INTROSPECTION_WIRE_SWAPS
+    s.write_bytes(8, &p.result);  // result version
+#else
+    introspection::gen::put(p.result, s);
+    introspection::gen::put(p.version, s);
+#endif
+    introspection::gen::put(p.users, s);
+}
+
+void decode(ConnectedPacket &p, introspection::stream &s)
+{
+#if !INTROSPECTION_WIRE_SWAPS
+    s.read_bytes(8, &p.result);  // result version
+#else
+    introspection::gen::get(p.result, s);
+    introspection::gen::get(p.version, s);
+#endif
+    introspection::gen::get(p.users, s);
+}
+
+void to_text(ConnectedPacket const &p, std::string &oStr)
+{
+    oStr = "[ ";
+    introspection::gen::text(p.result, oStr);
+    introspection::gen::text(p.version, oStr);
+    introspection::gen::text(p.users, oStr);
+    oStr += "] ";
+}
+
+void encode_ConnectedPacket(void const *p, introspection::stream &s)
+{
+    encode(*(ConnectedPacket const *)p, s);
+}
+
+void decode_ConnectedPacket(void *p, introspection::stream &s)
+{
+    decode(*(ConnectedPacket *)p, s);
+}
+
+void to_text_ConnectedPacket(void const *p, std::string &oStr)
+{
+    to_text(*(ConnectedPacket const *)p, oStr);
+}
+
+introspection::generated_codec_t const codec_ConnectedPacket = {
+    &encode_ConnectedPacket, &decode_ConnectedPacket, &to_text_ConnectedPacket
+};
+
+introspection::generated_member_t const layout_ConnectedPacket[] = {
+    { "result", 0, 4 },
+    { "version", 4, 4 },
+    { "users", 8, 24 },
+};
+
+bool const registered_ConnectedPacket = introspection::register_generated_codec(
+    ConnectedPacket::member_info(), codec_ConnectedPacket, layout_ConnectedPacket, 3);
+
+void encode(SaySomethingPacket const &p, introspection::stream &s)
+{
+    introspection::gen::put(p.message, s);
+}
+
+void decode(SaySomethingPacket &p, introspection::stream &s)
+{
+    introspection::gen::get(p.message, s);
+}
+
+void to_text(SaySomethingPacket const &p, std::string &oStr)
+{
+    oStr = "[ ";
+    introspection::gen::text(p.message, oStr);
+    oStr += "] ";
+}
+
+void encode_SaySomethingPacket(void const *p, introspection::stream &s)
+{
+    encode(*(SaySomethingPacket const *)p, s);
+}
+
+void decode_SaySomethingPacket(void *p, introspection::stream &s)
+{
+    decode(*(SaySomethingPacket *)p, s);
+}
+
+void to_text_SaySomethingPacket(void const *p, std::string &oStr)
+{
+    to_text(*(SaySomethingPacket const *)p, oStr);
+}
+
+introspection::generated_codec_t const codec_SaySomethingPacket = {
+    &encode_SaySomethingPacket, &decode_SaySomethingPacket, &to_text_SaySomethingPacket
+};
+
+introspection::generated_member_t const layout_SaySomethingPacket[] = {
+    { "message", 0, 32 },
+};
+
+bool const registered_SaySomethingPacket = introspection::register_generated_codec(
+    SaySomethingPacket::member_info(), codec_SaySomethingPacket, layout_SaySomethingPacket, 1);
+
+void encode(SomeoneSaidSomethingPacket const &p, introspection::stream &s)
+{
+    introspection::gen::put(p.who, s);
+    introspection::gen::put(p.what, s);
+}
+
+void decode(SomeoneSaidSomethingPacket &p, introspection::stream &s)
+{
+    introspection::gen::get(p.who, s);
+    introspection::gen::get(p.what, s);
+}
+
+void to_text(SomeoneSaidSomethingPacket const &p, std::string &oStr)
+{
+    oStr = "[ ";
+    introspection::gen::text(p.who, oStr);
+    introspection::gen::text(p.what, oStr);
+    oStr += "] ";
+}
+
+void encode_SomeoneSaidSomethingPacket(void const *p, introspection::stream &s)
+{
+    encode(*(SomeoneSaidSomethingPacket const *)p, s);
+}
+
+void decode_SomeoneSaidSomethingPacket(void *p, introspection::stream &s)
+{
+    decode(*(SomeoneSaidSomethingPacket *)p, s);
+}
+
+void to_text_SomeoneSaidSomethingPacket(void const *p, std::string &oStr)
+{
+    to_text(*(SomeoneSaidSomethingPacket const *)p, oStr);
+}
+
+introspection::generated_codec_t const codec_SomeoneSaidSomethingPacket = {
+    &encode_SomeoneSaidSomethingPacket, &decode_SomeoneSaidSomethingPacket, &to_text_SomeoneSaidSomethingPacket
+};
+
+introspection::generated_member_t const layout_SomeoneSaidSomethingPacket[] = {
+    { "who", 0, 32 },
+    { "what", 32, 32 },
+};
+
+bool const registered_SomeoneSaidSomethingPacket = introspection::register_generated_codec(
+    SomeoneSaidSomethingPacket::member_info(), codec_SomeoneSaidSomethingPacket, layout_SomeoneSaidSomethingPacket, 2);
+
+void encode(UserJoinedPacket const &p, introspection::stream &s)
+{
+    introspection::gen::put(p.who, s);
+}
+
+void decode(UserJoinedPacket &p, introspection::stream &s)
+{
+    introspection::gen::get(p.who, s);
+}
+
+void to_text(UserJoinedPacket const &p, std::string &oStr)
+{
+    oStr = "[ ";
+    introspection::gen::text(p.who, oStr);
+    oStr += "] ";
+}
+
+void encode_UserJoinedPacket(void const *p, introspection::stream &s)
+{
+    encode(*(UserJoinedPacket const *)p, s);
+}
+
+void decode_UserJoinedPacket(void *p, introspection::stream &s)
+{
+    decode(*(UserJoinedPacket *)p, s);
+}
+
+void to_text_UserJoinedPacket(void const *p, std::string &oStr)
+{
+    to_text(*(UserJoinedPacket const *)p, oStr);
+}
+
+introspection::generated_codec_t const codec_UserJoinedPacket = {
+    &encode_UserJoinedPacket, &decode_UserJoinedPacket, &to_text_UserJoinedPacket
+};
+
+introspection::generated_member_t const layout_UserJoinedPacket[] = {
+    { "who", 0, 32 },
+};
+
+bool const registered_UserJoinedPacket = introspection::register_generated_codec(
+    UserJoinedPacket::member_info(), codec_UserJoinedPacket, layout_UserJoinedPacket, 1);
+
+void encode(UserLeftPacket const &p, introspection::stream &s)
+{
+    introspection::gen::put(p.who, s);
+}
+
+void decode(UserLeftPacket &p, introspection::stream &s)
+{
+    introspection::gen::get(p.who, s);
+}
+
+void to_text(UserLeftPacket const &p, std::string &oStr)
+{
+    oStr = "[ ";
+    introspection::gen::text(p.who, oStr);
+    oStr += "] ";
+}
+
+void encode_UserLeftPacket(void const *p, introspection::stream &s)
+{
+    encode(*(UserLeftPacket const *)p, s);
+}
+
+void decode_UserLeftPacket(void *p, introspection::stream &s)
+{
+    decode(*(UserLeftPacket *)p, s);
+}
+
+void to_text_UserLeftPacket(void const *p, std::string &oStr)
+{
+    to_text(*(UserLeftPacket const *)p, oStr);
+}
+
+introspection::generated_codec_t const codec_UserLeftPacket = {
+    &encode_UserLeftPacket, &decode_UserLeftPacket, &to_text_UserLeftPacket
+};
+
+introspection::generated_member_t const layout_UserLeftPacket[] = {
+    { "who", 0, 32 },
+};
+
+bool const registered_UserLeftPacket = introspection::register_generated_codec(
+    UserLeftPacket::member_info(), codec_UserLeftPacket, layout_UserLeftPacket, 1);
+
+void encode(ServerStatsRequest const &p, introspection::stream &s)
+{
+    introspection::gen::put(p.version, s);
+}
+
+void decode(ServerStatsRequest &p, introspection::stream &s)
+{
+    introspection::gen::get(p.version, s);
+}
+
+void to_text(ServerStatsRequest const &p, std::string &oStr)
+{
+    oStr = "[ ";
+    introspection::gen::text(p.version, oStr);
+    oStr += "] ";
+}
+
+void encode_ServerStatsRequest(void const *p, introspection::stream &s)
+{
+    encode(*(ServerStatsRequest const *)p, s);
+}
+
+void decode_ServerStatsRequest(void *p, introspection::stream &s)
+{
+    decode(*(ServerStatsRequest *)p, s);
+}
+
+void to_text_ServerStatsRequest(void const *p, std::string &oStr)
+{
+    to_text(*(ServerStatsRequest const *)p, oStr);
+}
+
+introspection::generated_codec_t const codec_ServerStatsRequest = {
+    &encode_ServerStatsRequest, &decode_ServerStatsRequest, &to_text_ServerStatsRequest
+};
+
+introspection::generated_member_t const layout_ServerStatsRequest[] = {
+    { "version", 0, 4 },
+};
+
+bool const registered_ServerStatsRequest = introspection::register_generated_codec(
+    ServerStatsRequest::member_info(), codec_ServerStatsRequest, layout_ServerStatsRequest, 1);
+
+void encode(CountByReason const &p, introspection::stream &s)
+{
+    introspection::gen::put(p.reason, s);
+    introspection::gen::put(p.count, s);
+}
+
+void decode(CountByReason &p, introspection::stream &s)
+{
+    introspection::gen::get(p.reason, s);
+    introspection::gen::get(p.count, s);
+}
+
+void to_text(CountByReason const &p, std::string &oStr)
+{
+    oStr = "[ ";
+    introspection::gen::text(p.reason, oStr);
+    introspection::gen::text(p.count, oStr);
+    oStr += "] ";
+}
+
+void encode_CountByReason(void const *p, introspection::stream &s)
+{
+    encode(*(CountByReason const *)p, s);
+}
+
+void decode_CountByReason(void *p, introspection::stream &s)
+{
+    decode(*(CountByReason *)p, s);
+}
+
+void to_text_CountByReason(void const *p, std::string &oStr)
+{
+    to_text(*(CountByReason const *)p, oStr);
+}
+
+introspection::generated_codec_t const codec_CountByReason = {
+    &encode_CountByReason, &decode_CountByReason, &to_text_CountByReason
+};
+
+introspection::generated_member_t const layout_CountByReason[] = {
+    { "reason", 0, 32 },
+    { "count", 32, 8 },
+};
+
+bool const registered_CountByReason = introspection::register_generated_codec(
+    CountByReason::member_info(), codec_CountByReason, layout_CountByReason, 2);
+
+void encode(ServerStats const &p, introspection::stream &s)
+{
+    introspection::gen::put(p.shards, s);
+#if !INTROSPECTION_WIRE_SWAPS
+    s.write_bytes(32, &p.uptime_s);  // uptime_s connections logged_in accepts refused
+#else
+    introspection::gen::put(p.uptime_s, s);
+    introspection::gen::put(p.connections, s);
+    introspection::gen::put(p.logged_in, s);
+    introspection::gen::put(p.accepts, s);
+    introspection::gen::put(p.refused, s);
+#endif
+    introspection::gen::put(p.kicks, s);
+#if !INTROSPECTION_WIRE_SWAPS
+    s.write_bytes(68, &p.timeouts);  // timeouts disconnects bytes_in bytes_out frames_in frames_out frames_dropped frames_in_per_s frames_out_per_s queue_depth
+#else
+    introspection::gen::put(p.timeouts, s);
+    introspection::gen::put(p.disconnects, s);
+    introspection::gen::put(p.bytes_in, s);
+    introspection::gen::put(p.bytes_out, s);
+    introspection::gen::put(p.frames_in, s);
+    introspection::gen::put(p.frames_out, s);
+    introspection::gen::put(p.frames_dropped, s);
+    introspection::gen::put(p.frames_in_per_s, s);
+    introspection::gen::put(p.frames_out_per_s, s);
+    introspection::gen::put(p.queue_depth, s);
+#endif
+#if !INTROSPECTION_WIRE_SWAPS
+    s.write_bytes(20, &p.queued_bytes);  // queued_bytes peak_queued_bytes throttled
+#else
+    introspection::gen::put(p.queued_bytes, s);
+    introspection::gen::put(p.peak_queued_bytes, s);
+    introspection::gen::put(p.throttled, s);
+#endif
+    introspection::gen::put(p.tick_ns_log2, s);
+}
+
+void decode(ServerStats &p, introspection::stream &s)
+{
+    introspection::gen::get(p.shards, s);
+#if !INTROSPECTION_WIRE_SWAPS
+    s.read_bytes(32, &p.uptime_s);  // uptime_s connections logged_in accepts refused
+#else
+    introspection::gen::get(p.uptime_s, s);
+    introspection::gen::get(p.connections, s);
+    introspection::gen::get(p.logged_in, s);
+    introspection::gen::get(p.accepts, s);
+    introspection::gen::get(p.refused, s);
+#endif
+    introspection::gen::get(p.kicks, s);
+#if !INTROSPECTION_WIRE_SWAPS
+    s.read_bytes(68, &p.timeouts);  // timeouts disconnects bytes_in bytes_out frames_in frames_out frames_dropped frames_in_per_s frames_out_per_s queue_depth
+#else
+    introspection::gen::get(p.timeouts, s);
+    introspection::gen::get(p.disconnects, s);
+    introspection::gen::get(p.bytes_in, s);
+    introspection::gen::get(p.bytes_out, s);
+    introspection::gen::get(p.frames_in, s);
+    introspection::gen::get(p.frames_out, s);
+    introspection::gen::get(p.frames_dropped, s);
+    introspection::gen::get(p.frames_in_per_s, s);
+    introspection::gen::get(p.frames_out_per_s, s);
+    introspection::gen::get(p.queue_depth, s);
+#endif
+#if !INTROSPECTION_WIRE_SWAPS
+    s.read_bytes(20, &p.queued_bytes);  // queued_bytes peak_queued_bytes throttled
+#else
+    introspection::gen::get(p.queued_bytes, s);
+    introspection::gen::get(p.peak_queued_bytes, s);
+    introspection::gen::get(p.throttled, s);
+#endif
+    introspection::gen::get(p.tick_ns_log2, s);
+}
+
+void to_text(ServerStats const &p, std::string &oStr)
+{
+    oStr = "[ ";
+    introspection::gen::text(p.shards, oStr);
+    introspection::gen::text(p.uptime_s, oStr);
+    introspection::gen::text(p.connections, oStr);
+    introspection::gen::text(p.logged_in, oStr);
+    introspection::gen::text(p.accepts, oStr);
+    introspection::gen::text(p.refused, oStr);
+    introspection::gen::text(p.kicks, oStr);
+    introspection::gen::text(p.timeouts, oStr);
+    introspection::gen::text(p.disconnects, oStr);
+    introspection::gen::text(p.bytes_in, oStr);
+    introspection::gen::text(p.bytes_out, oStr);
+    introspection::gen::text(p.frames_in, oStr);
+    introspection::gen::text(p.frames_out, oStr);
+    introspection::gen::text(p.frames_dropped, oStr);
+    introspection::gen::text(p.frames_in_per_s, oStr);
+    introspection::gen::text(p.frames_out_per_s, oStr);
+    introspection::gen::text(p.queue_depth, oStr);
+    introspection::gen::text(p.queued_bytes, oStr);
+    introspection::gen::text(p.peak_queued_bytes, oStr);
+    introspection::gen::text(p.throttled, oStr);
+    introspection::gen::text(p.tick_ns_log2, oStr);
+    oStr += "] ";
+}
+
+void encode_ServerStats(void const *p, introspection::stream &s)
+{
+    encode(*(ServerStats const *)p, s);
+}
+
+void decode_ServerStats(void *p, introspection::stream &s)
+{
+    decode(*(ServerStats *)p, s);
+}
+
+void to_text_ServerStats(void const *p, std::string &oStr)
+{
+    to_text(*(ServerStats const *)p, oStr);
+}
+
+introspection::generated_codec_t const codec_ServerStats = {
+    &encode_ServerStats, &decode_ServerStats, &to_text_ServerStats
+};
+
+introspection::generated_member_t const layout_ServerStats[] = {
+    { "shards", 0, 4 },
+    { "uptime_s", 8, 8 },
+    { "connections", 16, 4 },
+    { "logged_in", 20, 4 },
+    { "accepts", 24, 8 },
+    { "refused", 32, 8 },
+    { "kicks", 40, 24 },
+    { "timeouts", 64, 8 },
+    { "disconnects", 72, 8 },
+    { "bytes_in", 80, 8 },
+    { "bytes_out", 88, 8 },
+    { "frames_in", 96, 8 },
+    { "frames_out", 104, 8 },
+    { "frames_dropped", 112, 8 },
+    { "frames_in_per_s", 120, 4 },
+    { "frames_out_per_s", 124, 4 },
+    { "queue_depth", 128, 4 },
+    { "queued_bytes", 136, 8 },
+    { "peak_queued_bytes", 144, 8 },
+    { "throttled", 152, 4 },
+    { "tick_ns_log2", 160, 24 },
+};
+
+bool const registered_ServerStats = introspection::register_generated_codec(
+    ServerStats::member_info(), codec_ServerStats, layout_ServerStats, 21);
+
+void decode_body_my_proto(int code, void *pdu, introspection::stream &s)
+{
+    switch (code)
+    {
+        case 1:
+            decode(*(LoginPacket *)pdu, s);
+            break;
+        case 2:
+            decode(*(UserInfo *)pdu, s);
+            break;
+        case 3:
+            decode(*(ConnectedPacket *)pdu, s);
+            break;
+        case 4:
+            decode(*(SaySomethingPacket *)pdu, s);
+            break;
+        case 5:
+            decode(*(SomeoneSaidSomethingPacket *)pdu, s);
+            break;
+        case 6:
+            decode(*(UserJoinedPacket *)pdu, s);
+            break;
+        case 7:
+            decode(*(UserLeftPacket *)pdu, s);
+            break;
+        case 8:
+            decode(*(ServerStatsRequest *)pdu, s);
+            break;
+        case 9:
+            decode(*(ServerStats *)pdu, s);
+            break;
+        default:
+            throw std::runtime_error("could not find type for code - is it registered?");
+    }
+}
+
+char const *const names_my_proto[] = {
+    "LoginPacket",
+    "UserInfo",
+    "ConnectedPacket",
+    "SaySomethingPacket",
+    "SomeoneSaidSomethingPacket",
+    "UserJoinedPacket",
+    "UserLeftPacket",
+    "ServerStatsRequest",
+    "ServerStats",
+};
+
+bool const registered_my_proto = introspection::register_generated_protocol(
+    my_proto, &decode_body_my_proto, names_my_proto, 9);
+
+}
@@ -0,0 +1,15 @@
+
+/* This file includes the sources from the "introspection" directory directly. 
+   This is to simplify building the samples. In production use, a library would 
+   be built as a DLL/.so, and linked separately.
+ */
+#include <introspection/introspection.cpp>
+#include <introspection/protocol.cpp>
+#include <introspection/protocol_stats.cpp>
+#include <introspection/codegen.cpp>
+#include <introspection/json.cpp>
+#include <introspection/transcode.cpp>
+#include <introspection/lazy_pdu.cpp>
+#include <introspection/registry.cpp>
+#include <introspection/pool.cpp>
+#include <introspection/sample_protocol.cpp>
@@ -0,0 +1,37 @@
+
+#include <introspection/sample_chat.h>
+#include <introspection/codegen.h>
+#include <stdio.h>
+
+/* The codegen tool for the sample protocol. It links in the introspected 
+   types (see hacklib.cpp), and writes straight-line codecs for the 
+   protocols named here. Build with "make GENERATED=1" to use them.
+   */
+
+EXTERN_PROTOCOL(my_proto);
+
+static void usage()
+{
+    fprintf(stderr, "usage: codegen output.cpp\n");
+    exit(1);
+}
+
+int main(int argc, char const *argv[])
+{
+    if (argc != 2)
+    {
+        usage();
+    }
+    std::string src;
+    introspection::generate_codecs(my_proto,
+        "#include <introspection/sample_chat.h>\n\nEXTERN_PROTOCOL(my_proto);\n", src);
+    FILE *f = fopen(argv[1], "wb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "%s: can't create\n", argv[1]);
+        return 1;
+    }
+    fwrite(src.c_str(), 1, src.size(), f);
+    fclose(f);
+    return 0;
+}
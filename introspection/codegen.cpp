@@ -0,0 +1,257 @@
+
+#include <introspection/codegen.h>
+
+#include <stdio.h>
+
+
+namespace introspection
+{
+
+//  nested types come before the types that contain them, so the generated
+//  functions are defined before they're called
+static void collect_type(type_info_base const &t, std::vector<type_info_base const *> &oTypes);
+
+static void collect_access(member_access_base const &acc, std::vector<type_info_base const *> &oTypes)
+{
+    if (acc.collection())
+    {
+        collect_access(acc.collection_info().element_access(), oTypes);
+    }
+    else if (acc.compound())
+    {
+        collect_type(acc.member_info(), oTypes);
+    }
+}
+
+static void collect_type(type_info_base const &t, std::vector<type_info_base const *> &oTypes)
+{
+    for (size_t i = 0; i != oTypes.size(); ++i)
+    {
+        if (oTypes[i] == &t)
+        {
+            return;
+        }
+    }
+    for (member_t::iterator ptr(t.begin()), end(t.end()); ptr != end; ++ptr)
+    {
+        collect_access((*ptr).access(), oTypes);
+    }
+    oTypes.push_back(&t);
+}
+
+static std::string num(size_t n)
+{
+    char buf[32];
+    sprintf(buf, "%lu", (unsigned long)n);
+    return buf;
+}
+
+//  members that are bitwise, not collections, and directly follow the
+//  previous one in memory can be copied together
+static bool continues_run(member_t::iterator ptr, size_t runEnd, bool inRun)
+{
+    member_access_base const &acc = (*ptr).access();
+    return inRun && acc.bitwise() && !acc.collection() && acc.offset() == runEnd;
+}
+
+static void write_run(member_t::iterator first, member_t::iterator last, size_t bytes,
+    char const *single, char const *bulk, std::string &oSrc)
+{
+    if (first + 1 == last)
+    {
+        oSrc += std::string("    ") + single + "(p." + (*first).name() + ", s);\n";
+        return;
+    }
+    //  the bytes in memory are the bytes on the wire only in the host's order
+    oSrc += "#if !INTROSPECTION_WIRE_SWAPS\n";
+    oSrc += std::string("    s.") + bulk + "(" + num(bytes) + ", &p." + (*first).name() + ");  //";
+    for (member_t::iterator ptr(first); ptr != last; ++ptr)
+    {
+        oSrc += std::string(" ") + (*ptr).name();
+    }
+    oSrc += "\n#else\n";
+    for (member_t::iterator ptr(first); ptr != last; ++ptr)
+    {
+        oSrc += std::string("    ") + single + "(p." + (*ptr).name() + ", s);\n";
+    }
+    oSrc += "#endif\n";
+}
+
+//  the body of encode() or decode(); single is the per-member call for
+//  members that aren't compound, bulk the stream function for runs
+static void write_marshal_body(type_info_base const &t, char const *single, char const *bulk,
+    char const *compound, std::string &oSrc)
+{
+    member_t::iterator first(t.begin());
+    size_t runEnd = 0;
+    bool inRun = false;
+    for (member_t::iterator ptr(t.begin()), end(t.end()); ptr != end; ++ptr)
+    {
+        member_access_base const &acc = (*ptr).access();
+        if (!continues_run(ptr, runEnd, inRun))
+        {
+            if (inRun)
+            {
+                write_run(first, ptr, runEnd - (*first).access().offset(), single, bulk, oSrc);
+                inRun = false;
+            }
+            if (acc.bitwise() && !acc.collection())
+            {
+                first = ptr;
+                inRun = true;
+            }
+            else if (acc.compound() && !acc.collection())
+            {
+                oSrc += std::string("    ") + compound + "(p." + (*ptr).name() + ", s);\n";
+            }
+            else
+            {
+                oSrc += std::string("    ") + single + "(p." + (*ptr).name() + ", s);\n";
+            }
+        }
+        runEnd = acc.offset() + acc.size();
+    }
+    if (inRun)
+    {
+        write_run(first, t.end(), runEnd - (*first).access().offset(), single, bulk, oSrc);
+    }
+}
+
+static void write_type(type_info_base const &t, std::string &oSrc)
+{
+    std::string n(t.name());
+    oSrc += "void encode(" + n + " const &p, introspection::stream &s)\n{\n";
+    write_marshal_body(t, "introspection::gen::put", "write_bytes", "encode", oSrc);
+    oSrc += "}\n\n";
+
+    oSrc += "void decode(" + n + " &p, introspection::stream &s)\n{\n";
+    write_marshal_body(t, "introspection::gen::get", "read_bytes", "decode", oSrc);
+    oSrc += "}\n\n";
+
+    oSrc += "void to_text(" + n + " const &p, std::string &oStr)\n{\n";
+    oSrc += "    oStr = \"[ \";\n";
+    for (member_t::iterator ptr(t.begin()), end(t.end()); ptr != end; ++ptr)
+    {
+        member_access_base const &acc = (*ptr).access();
+        if (acc.compound() && !acc.collection())
+        {
+            oSrc += std::string("    {\n        std::string tmp;\n        to_text(p.") + (*ptr).name() +
+                ", tmp);\n        oStr += tmp;\n    }\n";
+        }
+        else
+        {
+            oSrc += std::string("    introspection::gen::text(p.") + (*ptr).name() + ", oStr);\n";
+        }
+    }
+    oSrc += "    oStr += \"] \";\n}\n\n";
+
+    //  type-erased entry points, and the registration
+    oSrc += "void encode_" + n + "(void const *p, introspection::stream &s)\n{\n" +
+        "    encode(*(" + n + " const *)p, s);\n}\n\n";
+    oSrc += "void decode_" + n + "(void *p, introspection::stream &s)\n{\n" +
+        "    decode(*(" + n + " *)p, s);\n}\n\n";
+    oSrc += "void to_text_" + n + "(void const *p, std::string &oStr)\n{\n" +
+        "    to_text(*(" + n + " const *)p, oStr);\n}\n\n";
+    oSrc += "introspection::generated_codec_t const codec_" + n + " = {\n" +
+        "    &encode_" + n + ", &decode_" + n + ", &to_text_" + n + "\n};\n\n";
+    oSrc += "introspection::generated_member_t const layout_" + n + "[] = {\n";
+    for (member_t::iterator ptr(t.begin()), end(t.end()); ptr != end; ++ptr)
+    {
+        oSrc += std::string("    { \"") + (*ptr).name() + "\", " + num((*ptr).access().offset()) + ", " +
+            num((*ptr).access().size()) + " },\n";
+    }
+    oSrc += "};\n\n";
+    oSrc += "bool const registered_" + n + " = introspection::register_generated_codec(\n" +
+        "    " + n + "::member_info(), codec_" + n + ", layout_" + n + ", " + num(t.end() - t.begin()) + ");\n\n";
+}
+
+void generate_codecs(protocol_t &proto, char const *preamble, std::string &oSrc)
+{
+    std::vector<type_info_base const *> types;
+    for (int code = 1; code <= proto.pdu_count(); ++code)
+    {
+        collect_type(proto.type(code), types);
+    }
+
+    std::string pn(proto.name());
+    oSrc += "\n/* Generated by the introspection codegen tool for protocol " + pn + ". Do not edit. */\n\n";
+    oSrc += preamble;
+    oSrc += "\n#include <introspection/codegen.h>\n\n";
+    oSrc += "namespace\n{\n\n";
+    for (size_t i = 0; i != types.size(); ++i)
+    {
+        write_type(*types[i], oSrc);
+    }
+
+    oSrc += "void decode_body_" + pn + "(int code, void *pdu, introspection::stream &s)\n{\n";
+    oSrc += "    switch (code)\n    {\n";
+    for (int code = 1; code <= proto.pdu_count(); ++code)
+    {
+        std::string n(proto.type(code).name());
+        oSrc += "        case " + num(code) + ":\n";
+        oSrc += "            decode(*(" + n + " *)pdu, s);\n";
+        oSrc += "            break;\n";
+    }
+    oSrc += "        default:\n";
+    oSrc += "            throw std::runtime_error(\"could not find type for code - is it registered?\");\n";
+    oSrc += "    }\n}\n\n";
+
+    oSrc += "char const *const names_" + pn + "[] = {\n";
+    for (int code = 1; code <= proto.pdu_count(); ++code)
+    {
+        oSrc += std::string("    \"") + proto.type(code).name() + "\",\n";
+    }
+    oSrc += "};\n\n";
+    oSrc += "bool const registered_" + pn + " = introspection::register_generated_protocol(\n" +
+        "    " + pn + ", &decode_body_" + pn + ", names_" + pn + ", " + num(proto.pdu_count()) + ");\n\n";
+    oSrc += "}\n";
+}
+
+bool register_generated_codec(type_info_base const &type, generated_codec_t const &codec,
+    generated_member_t const *layout, size_t count)
+{
+    if ((size_t)(type.end() - type.begin()) != count)
+    {
+        fprintf(stderr, "%s: members added or removed since the code was generated; using the interpreted codec\n",
+            type.name());
+        return false;
+    }
+    for (member_t::iterator ptr(type.begin()), end(type.end()); ptr != end; ++ptr, ++layout)
+    {
+        if (strcmp((*ptr).name(), layout->name) ||
+            (*ptr).access().offset() != layout->offset ||
+            (*ptr).access().size() != layout->size)
+        {
+            fprintf(stderr, "%s: layout changed since the code was generated; using the interpreted codec\n",
+                type.name());
+            return false;
+        }
+    }
+    type.set_generated(&codec);
+    return true;
+}
+
+bool register_generated_protocol(protocol_t &proto, generated_decode_fn decode_body,
+    char const *const *names, int count)
+{
+    if (proto.pdu_count() != count)
+    {
+        fprintf(stderr, "%s: PDUs added or removed since the code was generated; using the interpreted codec\n",
+            proto.name());
+        return false;
+    }
+    for (int code = 1; code <= count; ++code)
+    {
+        type_info_base const &t = proto.type(code);
+        if (strcmp(t.name(), names[code - 1]) || !t.generated())
+        {
+            fprintf(stderr, "%s: PDU %d changed since the code was generated; using the interpreted codec\n",
+                proto.name(), code);
+            return false;
+        }
+    }
+    proto.use_generated(decode_body);
+    return true;
+}
+
+}
@@ -0,0 +1,47 @@
+
+#if !defined(introspection_codegen_h)
+#define introspection_codegen_h
+
+#include <introspection/introspection.h>
+
+/* The codegen tool walks the member_info() tables of the PDUs in a protocol
+   and writes C++ source with straight-line encode, decode and to_text
+   functions for each of them, and for every compound type they contain.
+   Consecutive bitwise members with no padding between them are copied with
+   a single read_bytes()/write_bytes(), when the wire byte order is the
+   host's (the generated code checks INTROSPECTION_WIRE_SWAPS). The output is a .cpp that registers
+   its codecs at static initialization time; compile it into the program
+   (the Makefile does this for the sample with "make GENERATED=1"), and
+   marshal<>, convert<> and protocol_t pick up the generated code.
+   */
+
+namespace introspection
+{
+    /* where a member was when the code was generated */
+    struct generated_member_t
+    {
+        char const *name;
+        size_t offset;
+        size_t size;
+    };
+
+    /* Write the codecs for the PDUs in proto. preamble goes at the top of
+     * the file, and must make the types nameable (#include lines, usings).
+     */
+    void generate_codecs(protocol_t &proto, char const *preamble, std::string &oSrc);
+
+    /* Called by the generated code. Installs the codec on the type, unless
+     * the layout of the type no longer matches what the code was generated
+     * for, in which case the type stays interpreted and this returns false.
+     */
+    bool register_generated_codec(type_info_base const &type, generated_codec_t const &codec,
+        generated_member_t const *layout, size_t count);
+
+    /* Called by the generated code. Installs the protocol's decode switch if
+     * the codes still map to the same types, and they all got their codecs.
+     */
+    bool register_generated_protocol(protocol_t &proto, generated_decode_fn decode_body,
+        char const *const *names, int count);
+}
+
+#endif  //  introspection_codegen_h
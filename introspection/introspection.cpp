@@ -3,11 +3,200 @@
 
 #include <assert.h>
 #include <new>
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 
 namespace introspection
 {
 
+void type_info_base::build_index()
+{
+    size_t size = 4;
+    while (size < count_ * 2)
+    {
+        size <<= 1;
+    }
+    index_.assign(size, 0);
+    offsets_.assign(size, 0);
+    for (size_t i = 0; i != count_; ++i)
+    {
+        char const *name = members_[i].name();
+        size_t slot = hash_name(name, strlen(name)) & (size - 1);
+        while (index_[slot] != 0)
+        {
+            slot = (slot + 1) & (size - 1);
+        }
+        index_[slot] = (unsigned short)(i + 1);
+        slot = hash_offset(members_[i].access().offset()) & (size - 1);
+        while (offsets_[slot] != 0)
+        {
+            slot = (slot + 1) & (size - 1);
+        }
+        offsets_[slot] = (unsigned short)(i + 1);
+    }
+}
+
+//  bitwise members with nothing between them are hashed and compared as one
+//  block of bytes
+void type_info_base::build_runs()
+{
+    runs_.clear();
+    bool inRun = false;
+    for (size_t i = 0; i != count_; ++i)
+    {
+        member_access_base const &acc = members_[i].access();
+        bool bitwise = acc.bitwise() && !acc.collection();
+        if (bitwise && inRun && runs_.back().offset + runs_.back().size == acc.offset())
+        {
+            runs_.back().size += acc.size();
+            continue;
+        }
+        member_run run;
+        run.offset = acc.offset();
+        run.size = acc.size();
+        run.member = bitwise ? 0 : &members_[i];
+        runs_.push_back(run);
+        inRun = bitwise;
+    }
+}
+
+//  MurmurHash64A, by Austin Appleby (public domain)
+unsigned long long hash_bytes(void const *data, size_t size, unsigned long long seed)
+{
+    unsigned long long const m = 0xc6a4a7935bd1e995ULL;
+    int const r = 47;
+    unsigned long long h = seed ^ (size * m);
+    unsigned char const *ptr = (unsigned char const *)data;
+    unsigned char const *end = ptr + (size & ~(size_t)7);
+    for (; ptr != end; ptr += 8)
+    {
+        unsigned long long k;
+        memcpy(&k, ptr, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    switch (size & 7)
+    {
+        case 7: h ^= (unsigned long long)ptr[6] << 48;
+            //  fall through
+        case 6: h ^= (unsigned long long)ptr[5] << 40;
+            //  fall through
+        case 5: h ^= (unsigned long long)ptr[4] << 32;
+            //  fall through
+        case 4: h ^= (unsigned long long)ptr[3] << 24;
+            //  fall through
+        case 3: h ^= (unsigned long long)ptr[2] << 16;
+            //  fall through
+        case 2: h ^= (unsigned long long)ptr[1] << 8;
+            //  fall through
+        case 1: h ^= (unsigned long long)ptr[0];
+            h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+//  byte reversal for 16 bytes at a time: one shuffle with SSSE3 or NEON,
+//  and word shuffles plus shifts with plain SSE2
+#if defined(__SSSE3__) || defined(__AVX__)
+static inline void swap16(unsigned char *dst, unsigned char const *src, size_t size)
+{
+    static unsigned char const masks[3][16] = {
+        { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 },
+        { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+        { 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 },
+    };
+    __m128i mask = _mm_loadu_si128((__m128i const *)masks[size == 2 ? 0 : size == 4 ? 1 : 2]);
+    __m128i v = _mm_loadu_si128((__m128i const *)src);
+    _mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(v, mask));
+}
+#define INTROSPECTION_SWAP16 1
+#elif defined(__SSE2__) || defined(_M_X64)
+static inline void swap16(unsigned char *dst, unsigned char const *src, size_t size)
+{
+    __m128i v = _mm_loadu_si128((__m128i const *)src);
+    if (size == 4)
+    {
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+    }
+    else if (size == 8)
+    {
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+    }
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    _mm_storeu_si128((__m128i *)dst, v);
+}
+#define INTROSPECTION_SWAP16 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline void swap16(unsigned char *dst, unsigned char const *src, size_t size)
+{
+    uint8x16_t v = vld1q_u8(src);
+    v = (size == 2) ? vrev16q_u8(v) : (size == 4) ? vrev32q_u8(v) : vrev64q_u8(v);
+    vst1q_u8(dst, v);
+}
+#define INTROSPECTION_SWAP16 1
+#endif
+
+void swap_bytes(void *dst, void const *src, size_t cnt, size_t size)
+{
+    if (size != 2 && size != 4 && size != 8)
+    {
+        throw std::logic_error("swap_bytes() of an unsupported size");
+    }
+    unsigned char *d = (unsigned char *)dst;
+    unsigned char const *s = (unsigned char const *)src;
+    size_t bytes = cnt * size;
+    size_t i = 0;
+#if defined(INTROSPECTION_SWAP16)
+    for (; i + 16 <= bytes; i += 16)
+    {
+        swap16(d + i, s + i, size);
+    }
+#endif
+    //  the tail, a whole element at a time so dst == src works
+    for (; i != bytes; i += size)
+    {
+        unsigned char tmp[8];
+        for (size_t j = 0; j != size; ++j)
+        {
+            tmp[j] = s[i + size - 1 - j];
+        }
+        memcpy(d + i, tmp, size);
+    }
+}
+
+void write_swapped(void const *src, size_t cnt, size_t size, stream &oStr)
+{
+    unsigned char buf[1024];
+    size_t per = sizeof(buf) / size;
+    unsigned char const *s = (unsigned char const *)src;
+    while (cnt > 0)
+    {
+        size_t n = cnt < per ? cnt : per;
+        swap_bytes(buf, s, n, size);
+        oStr.write_bytes(n * size, buf);
+        s += n * size;
+        cnt -= n;
+    }
+}
+
+void read_swapped(void *dst, size_t cnt, size_t size, stream &iStr)
+{
+    iStr.read_bytes(cnt * size, dst);
+    swap_bytes(dst, dst, cnt, size);
+}
+
 //  size_t may be 4 or 8 bytes, but we don't support blocks with sizes bigger 
 //  than what fits in 4 bytes, so use that for storage.
 void write_block(size_t size, void const *data, stream &oStr)
@@ -18,14 +207,14 @@ void write_block(size_t size, void const *data, stream &oStr)
     }
     unsigned int ui = (unsigned int)size;
     assert(sizeof(ui) == 4);
-    oStr.write_bytes(sizeof(ui), &ui);
+    marshal<unsigned int, false>::output(ui, oStr);
     oStr.write_bytes(ui, data);
 }
 
 void read_block_length(size_t &oLen, stream &oStr)
 {
     unsigned int ui = 0;
-    oStr.read_bytes(sizeof(ui), &ui);
+    marshal<unsigned int, false>::input(ui, oStr);
     oLen = ui;
 }
 
@@ -96,7 +285,11 @@ void simple_stream::write_bytes(size_t cnt, void const *src)
     {
         size_t nPhys = phys_ + 64;      //  some linear growth, useful at the beginning
         nPhys = nPhys + (nPhys >> 1);   //  some exponential growth, without the waste of doubling
-        nPhys = nPhys & ~31;            //  round the size to something nice and, uh, round.
+        if (nPhys < pos_ + cnt)
+        {
+            nPhys = pos_ + cnt;         //  a single big write can outgrow that
+        }
+        nPhys = (nPhys + 31) & ~31;     //  round the size to something nice and, uh, round.
         char *nu = new char[nPhys];
         memcpy(nu, ptr_, log_);
         phys_ = nPhys;
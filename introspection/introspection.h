@@ -4,8 +4,13 @@
 
 #include <vector>
 #include <list>
+#include <deque>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <array>
+#include <algorithm>
+#include <type_traits>
 #include <string>
 #include <sstream>
 #include <ctype.h>
@@ -25,11 +30,12 @@ namespace introspection
     #define INTROSPECTION(type, members) \
         typedef type self_t; \
         static inline introspection::type_info_base const &member_info() { \
+            (void)introspection::type_registrar<type>::registered_; \
             static introspection::member_t data[] = { \
                 members \
             }; \
             static introspection::type_info_t<type> info( \
-                data, sizeof(data)/sizeof(data[0]), \
+                #type, data, sizeof(data)/sizeof(data[0]), \
                 introspection::struct_access_t<type>::instance()); \
             return info; \
         }
@@ -64,8 +70,170 @@ namespace introspection
     void read_block_length(size_t &len, stream &iStr);
     void read_block_data(size_t len, void *data, stream &iStr);
 
+    /* Byte order on the wire is little-endian, unless the build defines 
+       INTROSPECTION_WIRE_BIG_ENDIAN to 1. Arithmetic scalars, and the block 
+       lengths and collection counts, are swapped when the host differs; on 
+       a matching host marshaling is the plain copy it always was. Structs 
+       marshaled with marshal<T, false> are copied as they are in memory; 
+       give them member_info() if they need to cross architectures. */
+#if !defined(INTROSPECTION_WIRE_BIG_ENDIAN)
+#define INTROSPECTION_WIRE_BIG_ENDIAN 0
+#endif
+#if !defined(INTROSPECTION_HOST_BIG_ENDIAN)
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define INTROSPECTION_HOST_BIG_ENDIAN 1
+#else
+#define INTROSPECTION_HOST_BIG_ENDIAN 0
+#endif
+#endif
+#define INTROSPECTION_WIRE_SWAPS (INTROSPECTION_WIRE_BIG_ENDIAN != INTROSPECTION_HOST_BIG_ENDIAN)
+
+    /* reverse the bytes of each of cnt elements of size 2, 4 or 8, from src 
+       to dst (which may be the same); vectorized where the target allows */
+    void swap_bytes(void *dst, void const *src, size_t cnt, size_t size);
+    /* write or read cnt elements, swapping them on the way */
+    void write_swapped(void const *src, size_t cnt, size_t size, stream &oStr);
+    void read_swapped(void *dst, size_t cnt, size_t size, stream &iStr);
+
+    /* does a T change on its way to the wire? */
+    template<typename T> struct wire_swaps
+    {
+        enum { value = INTROSPECTION_WIRE_SWAPS && std::is_arithmetic<T>::value &&
+            (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8) };
+    };
+    template<size_t Size> struct swap_word;
+    template<> struct swap_word<2>
+    {
+        typedef unsigned short type;
+        static inline type swap(type v) { return (type)((v >> 8) | (v << 8)); }
+    };
+    template<> struct swap_word<4>
+    {
+        typedef unsigned int type;
+        static inline type swap(type v)
+        {
+            return (v >> 24) | ((v >> 8) & 0xff00) | ((v & 0xff00) << 8) | (v << 24);
+        }
+    };
+    template<> struct swap_word<8>
+    {
+        typedef unsigned long long type;
+        static inline type swap(type v)
+        {
+            return ((unsigned long long)swap_word<4>::swap((unsigned int)v) << 32) |
+                swap_word<4>::swap((unsigned int)(v >> 32));
+        }
+    };
+    /* between host and wire order, in place (so floats never travel as 
+       values with their bytes scrambled) */
+    template<typename T, bool Swap = wire_swaps<T>::value != 0>
+    struct wire_order
+    {
+        static inline void swap(T &) {}
+        static inline void write(T const &item, stream &oStr) { oStr.write_bytes(sizeof(T), &item); }
+        static inline void read(T &item, stream &iStr) { iStr.read_bytes(sizeof(T), &item); }
+    };
+    template<typename T>
+    struct wire_order<T, true>
+    {
+        static inline void swap(T &item)
+        {
+            typename swap_word<sizeof(T)>::type w;
+            memcpy(&w, &item, sizeof(T));
+            w = swap_word<sizeof(T)>::swap(w);
+            memcpy(&item, &w, sizeof(T));
+        }
+        static inline void write(T const &item, stream &oStr)
+        {
+            T tmp(item);
+            swap(tmp);
+            oStr.write_bytes(sizeof(T), &tmp);
+        }
+        static inline void read(T &item, stream &iStr)
+        {
+            iStr.read_bytes(sizeof(T), &item);
+            swap(item);
+        }
+    };
+    /* the scalar a bitwise T is made of (itself, or what its arrays, 
+       however nested, hold in the end), and how many of them are in a T */
+    template<typename T> struct wire_element
+    {
+        typedef T type;
+        enum { count = 1 };
+    };
+    template<typename T, size_t N> struct wire_element<T[N]>
+    {
+        typedef typename wire_element<T>::type type;
+        enum { count = N * wire_element<T>::count };
+    };
+    template<typename T, size_t N> struct wire_element<std::array<T, N> >
+    {
+        typedef typename wire_element<T>::type type;
+        enum { count = N * wire_element<T>::count };
+    };
+    /* cnt bitwise elements as one block; arrays are swapped scalar by 
+       scalar */
+    template<typename T>
+    inline void write_scalars(T const *items, size_t cnt, stream &oStr)
+    {
+        typedef typename wire_element<T>::type scalar;
+        if (wire_swaps<scalar>::value)
+        {
+            write_swapped(items, cnt * wire_element<T>::count, sizeof(scalar), oStr);
+        }
+        else
+        {
+            oStr.write_bytes(cnt * sizeof(T), items);
+        }
+    }
+    template<typename T>
+    inline void read_scalars(T *items, size_t cnt, stream &iStr)
+    {
+        typedef typename wire_element<T>::type scalar;
+        if (wire_swaps<scalar>::value)
+        {
+            read_swapped(items, cnt * wire_element<T>::count, sizeof(scalar), iStr);
+        }
+        else
+        {
+            iStr.read_bytes(cnt * sizeof(T), items);
+        }
+    }
+
     template<typename T, bool HasMemberInfo> struct marshal;
     template<typename T, bool HasMemberInfo> struct convert;
+    template<typename T, bool HasMemberInfo> struct json_convert;
+    class json_writer;
+    class json_reader;
+    template<typename T, bool NotScalar> struct wire_scalar;
+    template<typename T, bool HasMemberInfo> struct value_ops;
+
+    /* is_bitwise<T> says that a T is marshaled as its own bytes (byte 
+       swapped, if the wire order isn't the host's), so runs of such members 
+       can be copied in one go. Specialize it for your own plain structs if 
+       they are marshaled with marshal<T, false>. */
+    template<typename T> struct is_bitwise { enum { value = 0 }; };
+    template<> struct is_bitwise<bool> { enum { value = 1 }; };
+    template<> struct is_bitwise<char> { enum { value = 1 }; };
+    template<> struct is_bitwise<signed char> { enum { value = 1 }; };
+    template<> struct is_bitwise<unsigned char> { enum { value = 1 }; };
+    template<> struct is_bitwise<short> { enum { value = 1 }; };
+    template<> struct is_bitwise<unsigned short> { enum { value = 1 }; };
+    template<> struct is_bitwise<int> { enum { value = 1 }; };
+    template<> struct is_bitwise<unsigned int> { enum { value = 1 }; };
+    template<> struct is_bitwise<long> { enum { value = 1 }; };
+    template<> struct is_bitwise<unsigned long> { enum { value = 1 }; };
+    template<> struct is_bitwise<long long> { enum { value = 1 }; };
+    template<> struct is_bitwise<unsigned long long> { enum { value = 1 }; };
+    template<> struct is_bitwise<float> { enum { value = 1 }; };
+    template<> struct is_bitwise<double> { enum { value = 1 }; };
+    //  arithmetic element types have no padding between elements
+    template<typename T, size_t N> struct is_bitwise<T[N]> { enum { value = is_bitwise<T>::value }; };
+    template<typename T, size_t N> struct is_bitwise<std::array<T, N> >
+    {
+        enum { value = is_bitwise<T>::value && sizeof(std::array<T, N>) == N * sizeof(T) };
+    };
 
     inline static void quote_str(char const *iStr, std::string &oStr)
     {
@@ -131,46 +299,137 @@ namespace introspection
         virtual void clear(void *coll) const = 0;
         virtual void append_from(void *coll, stream &iStr) const = 0;
         virtual char const *append_from(void *coll, char const *str) const = 0;
+        /* replace the contents with cnt elements from the stream, decoding 
+           over the elements that are already there where possible */
+        virtual void read_from(void *coll, size_t cnt, stream &iStr) const = 0;
+        /* write the elements (the count is already written) */
+        virtual void write_to(void const *coll, stream &oStr) const = 0;
+        /* access for the elements (at offset 0) */
+        virtual member_access_base const &element_access() const = 0;
+    };
+
+    /* Entry points of the straight-line codec the codegen tool wrote for a 
+       type (see codegen.h). */
+    class type_pool;
+    struct generated_codec_t
+    {
+        void (*encode)(void const *strct, stream &oStr);
+        void (*decode)(void *strct, stream &iStr);
+        void (*to_text)(void const *strct, std::string &oStr);
     };
 
     /* basic information about an aggregate type (struct) */
     struct type_info_base
     {
-        type_info_base(member_t const *ptr, size_t cnt, member_access_base const &access) :
+        type_info_base(char const *name, member_t const *ptr, size_t cnt, member_access_base const &access) :
+            name_(name),
             members_(ptr),
             count_(cnt),
-            access_(access)
+            access_(access),
+            generated_(0),
+            pool_(0)
         {
+            build_index();
+            build_runs();
         }
+        inline char const      *name() const { return name_; }
         inline member_t const  *begin() const;
         inline member_t const  *end() const;
         inline member_access_base const &access() const { return access_; }
+        /* find a member by name with a hash lookup; 0 if there is no such member */
+        inline member_t const *find_member(char const *name, size_t len) const;
+        /* the index of the member at an offset in the struct, with a hash 
+           lookup; the member count if no member starts there */
+        inline size_t member_at(size_t offset) const;
+        /* Members in order, with runs of bitwise members that follow each 
+           other without padding merged into one entry with a null member. */
+        struct member_run
+        {
+            size_t offset;
+            size_t size;
+            member_t const *member;
+        };
+        inline std::vector<member_run> const &runs() const { return runs_; }
+        /* approximate heap and static memory used by this type info */
+        size_t metadata_bytes() const;
+        /* the generated codec for this type, if one has been registered */
+        inline generated_codec_t const *generated() const { return generated_; }
+        inline void set_generated(generated_codec_t const *codec) const { generated_ = codec; }
     protected:
+        friend class type_pool;
+        char const             *name_;
         member_t const         *members_;
         size_t                  count_;
         member_access_base const &access_;
+        mutable generated_codec_t const *generated_;
+        //  made by type_pool::of() the first time it's needed
+        mutable type_pool *pool_;
+        //  open addressed, power of two sized; slots hold member index + 1
+        std::vector<unsigned short> index_;
+        //  the same, by offset
+        std::vector<unsigned short> offsets_;
+        static inline size_t hash_offset(size_t offset)
+        {
+            return (size_t)((offset * 0x9e3779b97f4a7c15ULL) >> 40);
+        }
+        void build_index();
+        std::vector<member_run> runs_;
+        void build_runs();
+    };
+
+    /* Compound members refer to their type through a function, because the 
+       type info may still be under construction (a struct's own access, or 
+       a struct that contains a collection of itself). */
+    typedef type_info_base const &(*type_info_getter)();
+
+    /* Every INTROSPECTION type adds its member_info() to the registry at 
+       static initialization time, without building it; see registry.h. */
+    void register_type(type_info_getter getter);
+    template<typename T>
+    struct type_registrar
+    {
+        static bool const registered_;
     };
+    template<typename T>
+    bool const type_registrar<T>::registered_ = (register_type(&T::member_info), true);
 
     /* information about a specific type (creation, destruction, marshaling) */
     struct member_access_base
     {
-        member_access_base(size_t mem_size, size_t offset, type_info_base const *base, collection_info_base const *collection) :
+        member_access_base(size_t mem_size, size_t offset, type_info_getter base, collection_info_base const *collection, bool bitwise) :
             mem_size_(mem_size),
             offset_(offset),
             base_(base),
-            collection_(collection)
+            collection_(collection),
+            bitwise_(bitwise)
         {
         }
         inline void get_from(void const *strct, stream &oStr) const;
         inline void put_to(void *strct, stream &iStr) const;
         inline void to_text(void const *strct, std::string &oStr) const;
         inline char const *from_text(void *strct, char const *str) const;
+        inline void to_json(void const *strct, json_writer &w) const { do_to_json(strct, w); }
+        inline void from_json(void *strct, json_reader &r) const { do_from_json(strct, r); }
+        /* Transcode between the binary form and the text or JSON form 
+           without an instance, walking the member info (see transcode.h). 
+           The text is appended to oStr. Writing a collection seeks back in 
+           oStr to fill in the count. */
+        void wire_to_text(stream &iStr, std::string &oStr) const;
+        void wire_to_json(stream &iStr, json_writer &w) const;
+        char const *text_to_wire(char const *str, stream &oStr) const;
+        void json_to_wire(json_reader &r, stream &oStr) const;
+        /* see hash(), equals() and compare() */
+        inline void hash(void const *strct, unsigned long long &h) const { do_hash(strct, h); }
+        inline bool equals(void const *a, void const *b) const { return do_equals(a, b); }
+        inline int compare(void const *a, void const *b) const { return do_compare(a, b); }
         inline size_t size() const { return mem_size_; }
         inline size_t offset() const { return offset_; }
         inline bool compound() const { return base_ != 0; }
-        inline type_info_base const &member_info() const { return *base_; }
+        inline type_info_base const &member_info() const { return (*base_)(); }
         inline bool collection() const { return collection_ != 0; }
         inline collection_info_base const &collection_info() const { return *collection_; }
+        /* marshaled as its own size() bytes (see is_bitwise) */
+        inline bool bitwise() const { return bitwise_; }
         virtual void create(void *ptr) const = 0;
         virtual void destroy(void *ptr) const = 0;
     private:
@@ -178,10 +437,21 @@ namespace introspection
         virtual void do_put_to(void *strct, stream &iStr) const = 0;
         virtual void do_to_text(void const *strct, std::string &ostr) const = 0;
         virtual char const *do_from_text(void *strct, char const *str) const = 0;
+        virtual void do_to_json(void const *strct, json_writer &w) const = 0;
+        virtual void do_from_json(void *strct, json_reader &r) const = 0;
+        //  only called for members that are neither compound nor collections
+        virtual void do_wire_to_text(stream &iStr, std::string &oStr) const = 0;
+        virtual void do_wire_to_json(stream &iStr, json_writer &w) const = 0;
+        virtual char const *do_text_to_wire(char const *str, stream &oStr) const = 0;
+        virtual void do_json_to_wire(json_reader &r, stream &oStr) const = 0;
+        virtual void do_hash(void const *strct, unsigned long long &h) const = 0;
+        virtual bool do_equals(void const *a, void const *b) const = 0;
+        virtual int do_compare(void const *a, void const *b) const = 0;
         size_t mem_size_;
         size_t offset_;
-        type_info_base const *base_;
+        type_info_getter base_;
         collection_info_base const *collection_;
+        bool bitwise_;
     };
 
     struct member_info_base
@@ -222,8 +492,8 @@ namespace introspection
     template<typename Member>
     struct type_info_t : type_info_base
     {
-        type_info_t(member_t const *ptr, size_t cnt, member_access_base const &mab) :
-            type_info_base(ptr, cnt, mab)
+        type_info_t(char const *name, member_t const *ptr, size_t cnt, member_access_base const &mab) :
+            type_info_base(name, ptr, cnt, mab)
         {
         }
     };
@@ -235,7 +505,7 @@ namespace introspection
             char x[N];
         };
         template<typename Q>
-        static inline char sfinae(Q *t, bar<sizeof(&Q::member_info)> *u) { return sizeof(*u); }
+        static inline char sfinae(Q *t, bar<sizeof(&Q::member_info)> *u = 0) { return sizeof(*u); }
         static inline int sfinae(...) { return 4; }
         enum { value = (1 == sizeof(sfinae((T *)0))) };
     };
@@ -243,11 +513,11 @@ namespace introspection
     template<typename MemT, bool HasMemberInfo> struct get_member_info_base;
     template<typename MemT> struct get_member_info_base<MemT, false>
     {
-        static inline type_info_base const *info() { return 0; }
+        static inline type_info_getter info() { return 0; }
     };
     template<typename MemT> struct get_member_info_base<MemT, true>
     {
-        static inline type_info_base const *info() { return &MemT::member_info(); }
+        static inline type_info_getter info() { return &MemT::member_info; }
     };
     template<typename MemT> struct get_member_info : get_member_info_base<MemT, has_member_info<MemT>::value>
     {
@@ -258,6 +528,22 @@ namespace introspection
         enum { is_collection = 0 };
         static inline collection_info_base const *info() { return 0; }
     };
+    /* the access for a T that isn't a member of anything (offset 0) */
+    template<typename T> member_access_base const &value_access();
+    /* what an element is decoded into before it goes into the collection; 
+       map keys are const in the value_type, so decode to a plain pair */
+    template<typename Coll> struct collection_entry
+    {
+        typedef typename Coll::value_type type;
+    };
+    template<typename K, typename V> struct collection_entry<std::map<K, V> >
+    {
+        typedef std::pair<K, V> type;
+    };
+    template<typename K, typename V> struct collection_entry<std::unordered_map<K, V> >
+    {
+        typedef std::pair<K, V> type;
+    };
     template<typename Coll>
     struct collection_t : collection_info_base
     {
@@ -278,7 +564,8 @@ namespace introspection
                     sizeof(MemT),
                     0, 
                     get_member_info<MemT>::info(),
-                    get_collection_info<MemT>::info())
+                    get_collection_info<MemT>::info(),
+                    is_bitwise<MemT>::value)
             {
             }
             virtual void create(void *ptr) const
@@ -305,6 +592,42 @@ namespace introspection
             {
                 return convert<MemT, has_member_info<MemT>::value>::from_string(*(MemT *)strct, str);
             }
+            virtual void do_to_json(void const *strct, json_writer &w) const
+            {
+                json_convert<MemT, has_member_info<MemT>::value>::write(*(MemT const *)strct, w);
+            }
+            virtual void do_from_json(void *strct, json_reader &r) const
+            {
+                json_convert<MemT, has_member_info<MemT>::value>::read(*(MemT *)strct, r);
+            }
+            virtual void do_wire_to_text(stream &iStr, std::string &oStr) const
+            {
+                wire_scalar<MemT, has_member_info<MemT>::value || get_collection_info<MemT>::is_collection>::to_text(iStr, oStr);
+            }
+            virtual void do_wire_to_json(stream &iStr, json_writer &w) const
+            {
+                wire_scalar<MemT, has_member_info<MemT>::value || get_collection_info<MemT>::is_collection>::to_json(iStr, w);
+            }
+            virtual char const *do_text_to_wire(char const *str, stream &oStr) const
+            {
+                return wire_scalar<MemT, has_member_info<MemT>::value || get_collection_info<MemT>::is_collection>::from_text(str, oStr);
+            }
+            virtual void do_json_to_wire(json_reader &r, stream &oStr) const
+            {
+                wire_scalar<MemT, has_member_info<MemT>::value || get_collection_info<MemT>::is_collection>::from_json(r, oStr);
+            }
+            virtual void do_hash(void const *strct, unsigned long long &h) const
+            {
+                value_ops<MemT, has_member_info<MemT>::value>::hash(*(MemT const *)strct, h);
+            }
+            virtual bool do_equals(void const *a, void const *b) const
+            {
+                return value_ops<MemT, has_member_info<MemT>::value>::equals(*(MemT const *)a, *(MemT const *)b);
+            }
+            virtual int do_compare(void const *a, void const *b) const
+            {
+                return value_ops<MemT, has_member_info<MemT>::value>::compare(*(MemT const *)a, *(MemT const *)b);
+            }
         };
         static inline member_access_base &get_access()
         {
@@ -375,26 +698,173 @@ namespace introspection
             }
         };
         template<typename T>
-        struct insert<std::set<T> >
+        struct insert_entry
         {
-            static inline void func(void *coll, typename T::value_type const &vt)
+            static inline void func(void *coll, typename collection_entry<T>::type const &vt)
+            {
+                (*(T *)coll).insert(vt);
+            }
+        };
+        template<typename T> struct insert<std::set<T> > : insert_entry<std::set<T> > {};
+        template<typename T> struct insert<std::multiset<T> > : insert_entry<std::multiset<T> > {};
+        template<typename K, typename V> struct insert<std::map<K, V> > : insert_entry<std::map<K, V> > {};
+        template<typename K, typename V> struct insert<std::unordered_map<K, V> > : insert_entry<std::unordered_map<K, V> > {};
+        template<typename T>
+        struct reserve_elements
+        {
+            static inline void func(T &c, size_t cnt) {}
+        };
+        template<typename T>
+        struct reserve_elements<std::vector<T> >
+        {
+            static inline void func(std::vector<T> &c, size_t cnt)
+            {
+                c.reserve(cnt);
+            }
+        };
+        template<typename K, typename V>
+        struct reserve_elements<std::unordered_map<K, V> >
+        {
+            static inline void func(std::unordered_map<K, V> &c, size_t cnt)
+            {
+                c.reserve(cnt);
+            }
+        };
+        /* sequences overwrite the elements they have, then grow or shrink */
+        template<typename T>
+        struct read_sequence
+        {
+            static inline void func(void *coll, size_t cnt, stream &iStr)
+            {
+                T &c = *(T *)coll;
+                typename T::iterator ptr(c.begin()), end(c.end());
+                size_t i = 0;
+                for (; i != cnt && ptr != end; ++i, ++ptr)
+                {
+                    get_access().put_to(&*ptr, iStr);
+                }
+                if (ptr != end)
+                {
+                    c.erase(ptr, end);
+                }
+                //  don't trust the count for more memory than the data could fill
+                reserve_elements<T>::func(c, cnt < iStr.bytes_left() ? cnt : iStr.bytes_left());
+                for (; i != cnt; ++i)
+                {
+                    c.push_back(typename T::value_type());
+                    get_access().put_to(&c.back(), iStr);
+                }
+            }
+        };
+        template<typename T>
+        struct read_elements : read_sequence<T>
+        {
+        };
+        /* vectors of bitwise elements are one block on the wire */
+        template<typename T, bool Bitwise>
+        struct read_vector : read_sequence<std::vector<T> >
+        {
+        };
+        template<typename T>
+        struct read_vector<T, true>
+        {
+            static inline void func(void *coll, size_t cnt, stream &iStr)
+            {
+                std::vector<T> &c = *(std::vector<T> *)coll;
+                if (cnt > iStr.bytes_left() / sizeof(T))
+                {
+                    throw std::runtime_error("underflow in vector read_from()");
+                }
+                c.resize(cnt);
+                if (cnt)
+                {
+                    read_scalars(&c[0], cnt, iStr);
+                }
+            }
+        };
+        template<typename T> struct read_elements<std::vector<T> > : read_vector<T, is_bitwise<T>::value != 0> {};
+        /* sets and maps can't be changed in place; decode each entry and 
+           move it in. They are written in order, so ending up at end() is 
+           the usual case, and the hint makes that constant time. */
+        template<typename T>
+        struct read_entries
+        {
+            static inline void func(void *coll, size_t cnt, stream &iStr)
             {
-                (*(std::set<T> *)coll).insert(vt);
+                typedef typename collection_entry<T>::type entry;
+                T &c = *(T *)coll;
+                c.clear();
+                reserve_elements<T>::func(c, cnt < iStr.bytes_left() ? cnt : iStr.bytes_left());
+                member_access_base const &acc = value_access<entry>();
+                for (size_t i = 0; i != cnt; ++i)
+                {
+                    entry tmp;
+                    acc.put_to(&tmp, iStr);
+                    c.emplace_hint(c.end(), std::move(tmp));
+                }
             }
         };
+        template<typename T> struct read_elements<std::set<T> > : read_entries<std::set<T> > {};
+        template<typename T> struct read_elements<std::multiset<T> > : read_entries<std::multiset<T> > {};
+        template<typename K, typename V> struct read_elements<std::map<K, V> > : read_entries<std::map<K, V> > {};
+        template<typename K, typename V> struct read_elements<std::unordered_map<K, V> > : read_entries<std::unordered_map<K, V> > {};
         virtual void append_from(void *coll, stream &iStr) const
         {
-            typename Coll::value_type tmp;
-            get_access().put_to(&tmp, iStr);
+            typename collection_entry<Coll>::type tmp;
+            value_access<typename collection_entry<Coll>::type>().put_to(&tmp, iStr);
             insert<Coll>::func(coll, tmp);
         }
         virtual char const *append_from(void *coll, char const *str) const
         {
-            typename Coll::value_type tmp;
-            str = get_access().from_text(&tmp, str);
+            typename collection_entry<Coll>::type tmp;
+            str = value_access<typename collection_entry<Coll>::type>().from_text(&tmp, str);
             insert<Coll>::func(coll, tmp);
             return str;
         }
+        virtual void read_from(void *coll, size_t cnt, stream &iStr) const
+        {
+            read_elements<Coll>::func(coll, cnt, iStr);
+        }
+        template<typename T>
+        struct write_sequence
+        {
+            static inline void func(T const &c, stream &oStr)
+            {
+                member_access_base const &acc = get_access();
+                for (typename T::const_iterator ptr(c.begin()), end(c.end()); ptr != end; ++ptr)
+                {
+                    acc.get_from(&*ptr, oStr);
+                }
+            }
+        };
+        template<typename T>
+        struct write_elements : write_sequence<T>
+        {
+        };
+        template<typename T, bool Bitwise>
+        struct write_vector : write_sequence<std::vector<T> >
+        {
+        };
+        template<typename T>
+        struct write_vector<T, true>
+        {
+            static inline void func(std::vector<T> const &c, stream &oStr)
+            {
+                if (!c.empty())
+                {
+                    write_scalars(&c[0], c.size(), oStr);
+                }
+            }
+        };
+        template<typename T> struct write_elements<std::vector<T> > : write_vector<T, is_bitwise<T>::value != 0> {};
+        virtual void write_to(void const *coll, stream &oStr) const
+        {
+            write_elements<Coll>::func(*(Coll const *)coll, oStr);
+        }
+        virtual member_access_base const &element_access() const
+        {
+            return get_access();
+        }
     };
     template<typename MemT> struct get_collection_info<std::list<MemT> >
     {
@@ -417,6 +887,98 @@ namespace introspection
             return &collection_t<std::set<MemT> >::instance();
         }
     };
+    template<typename MemT> struct get_collection_info<std::deque<MemT> >
+    {
+        enum { is_collection = 1 };
+        static inline collection_info_base const *info() {
+            return &collection_t<std::deque<MemT> >::instance();
+        }
+    };
+    template<typename MemT> struct get_collection_info<std::multiset<MemT> >
+    {
+        enum { is_collection = 1 };
+        static inline collection_info_base const *info() {
+            return &collection_t<std::multiset<MemT> >::instance();
+        }
+    };
+    /* map elements are key/value pairs, marshaled as the key then the value */
+    template<typename K, typename V> struct get_collection_info<std::map<K, V> >
+    {
+        enum { is_collection = 1 };
+        static inline collection_info_base const *info() {
+            return &collection_t<std::map<K, V> >::instance();
+        }
+    };
+    template<typename K, typename V> struct get_collection_info<std::unordered_map<K, V> >
+    {
+        enum { is_collection = 1 };
+        static inline collection_info_base const *info() {
+            return &collection_t<std::unordered_map<K, V> >::instance();
+        }
+    };
+    //  any collection's element access will do
+    template<typename T> member_access_base const &value_access()
+    {
+        return collection_t<std::list<T> >::get_access();
+    }
+    /* a collection inside a collection (or a map entry) marshals through 
+       its own access, which walks the elements */
+    template<typename Coll>
+    struct collection_marshal
+    {
+        inline static void output(Coll const &item, stream &oStr) { value_access<Coll>().get_from(&item, oStr); }
+        inline static void input(Coll &item, stream &iStr) { value_access<Coll>().put_to(&item, iStr); }
+    };
+    template<typename Coll>
+    struct collection_convert
+    {
+        inline static void to_string(Coll const &item, std::string &oStr) { value_access<Coll>().to_text(&item, oStr); }
+        inline static char const *from_string(Coll &item, char const *str)
+        {
+            item.clear();
+            return value_access<Coll>().from_text(&item, str);
+        }
+    };
+    template<typename T> struct marshal<std::list<T>, false> : collection_marshal<std::list<T> > {};
+    template<typename T> struct marshal<std::vector<T>, false> : collection_marshal<std::vector<T> > {};
+    template<typename T> struct marshal<std::set<T>, false> : collection_marshal<std::set<T> > {};
+    template<typename T> struct marshal<std::deque<T>, false> : collection_marshal<std::deque<T> > {};
+    template<typename T> struct marshal<std::multiset<T>, false> : collection_marshal<std::multiset<T> > {};
+    template<typename K, typename V> struct marshal<std::map<K, V>, false> : collection_marshal<std::map<K, V> > {};
+    template<typename K, typename V> struct marshal<std::unordered_map<K, V>, false> : collection_marshal<std::unordered_map<K, V> > {};
+    template<typename T> struct convert<std::list<T>, false> : collection_convert<std::list<T> > {};
+    template<typename T> struct convert<std::vector<T>, false> : collection_convert<std::vector<T> > {};
+    template<typename T> struct convert<std::set<T>, false> : collection_convert<std::set<T> > {};
+    template<typename T> struct convert<std::deque<T>, false> : collection_convert<std::deque<T> > {};
+    template<typename T> struct convert<std::multiset<T>, false> : collection_convert<std::multiset<T> > {};
+    template<typename K, typename V> struct convert<std::map<K, V>, false> : collection_convert<std::map<K, V> > {};
+    template<typename K, typename V> struct convert<std::unordered_map<K, V>, false> : collection_convert<std::unordered_map<K, V> > {};
+
+    /* constructing and destroying a member in place; arrays need their own */
+    template<typename T>
+    struct object_lifetime
+    {
+        inline static void create(void *ptr) { new (ptr) T; }
+        inline static void destroy(void *ptr) { ((T *)ptr)->~T(); }
+    };
+    template<typename T, size_t N>
+    struct object_lifetime<T[N]>
+    {
+        inline static void create(void *ptr)
+        {
+            for (size_t i = 0; i != N; ++i)
+            {
+                object_lifetime<T>::create((T *)ptr + i);
+            }
+        }
+        inline static void destroy(void *ptr)
+        {
+            for (size_t i = N; i != 0; --i)
+            {
+                object_lifetime<T>::destroy((T *)ptr + i - 1);
+            }
+        }
+    };
 
     template<typename Struct, typename MemT, bool IsCollection> struct member_access_t;
     template<typename Struct, typename MemT>
@@ -427,17 +989,18 @@ namespace introspection
                 sizeof(MemT), 
                 (char *)&(((Struct *)0)->*member) - (char *)0,
                 get_member_info<MemT>::info(),
-                get_collection_info<MemT>::info()),
+                get_collection_info<MemT>::info(),
+                is_bitwise<MemT>::value),
             member_(member)
         {
         }
         virtual void create(void *ptr) const
         {
-            new (ptr) MemT;
+            object_lifetime<MemT>::create(ptr);
         }
         virtual void destroy(void *ptr) const
         {
-            ((MemT *)ptr)->~MemT();
+            object_lifetime<MemT>::destroy(ptr);
         }
         virtual void do_get_from(void const *strct, stream &oStr) const
         {
@@ -455,6 +1018,42 @@ namespace introspection
         {
             return convert<MemT, has_member_info<MemT>::value>::from_string(((Struct *)strct)->*member_, str);
         }
+        virtual void do_to_json(void const *strct, json_writer &w) const
+        {
+            json_convert<MemT, has_member_info<MemT>::value>::write(((Struct const *)strct)->*member_, w);
+        }
+        virtual void do_from_json(void *strct, json_reader &r) const
+        {
+            json_convert<MemT, has_member_info<MemT>::value>::read(((Struct *)strct)->*member_, r);
+        }
+        virtual void do_wire_to_text(stream &iStr, std::string &oStr) const
+        {
+            wire_scalar<MemT, has_member_info<MemT>::value || get_collection_info<MemT>::is_collection>::to_text(iStr, oStr);
+        }
+        virtual void do_wire_to_json(stream &iStr, json_writer &w) const
+        {
+            wire_scalar<MemT, has_member_info<MemT>::value || get_collection_info<MemT>::is_collection>::to_json(iStr, w);
+        }
+        virtual char const *do_text_to_wire(char const *str, stream &oStr) const
+        {
+            return wire_scalar<MemT, has_member_info<MemT>::value || get_collection_info<MemT>::is_collection>::from_text(str, oStr);
+        }
+        virtual void do_json_to_wire(json_reader &r, stream &oStr) const
+        {
+            wire_scalar<MemT, has_member_info<MemT>::value || get_collection_info<MemT>::is_collection>::from_json(r, oStr);
+        }
+        virtual void do_hash(void const *strct, unsigned long long &h) const
+        {
+            value_ops<MemT, has_member_info<MemT>::value>::hash(((Struct const *)strct)->*member_, h);
+        }
+        virtual bool do_equals(void const *a, void const *b) const
+        {
+            return value_ops<MemT, has_member_info<MemT>::value>::equals(((Struct const *)a)->*member_, ((Struct const *)b)->*member_);
+        }
+        virtual int do_compare(void const *a, void const *b) const
+        {
+            return value_ops<MemT, has_member_info<MemT>::value>::compare(((Struct const *)a)->*member_, ((Struct const *)b)->*member_);
+        }
         inline MemT Struct::*member() const { return member_; }
     protected:
         MemT Struct::*member_;
@@ -467,7 +1066,8 @@ namespace introspection
                 sizeof(MemT), 
                 (char *)&(((Struct *)0)->*member) - (char *)0,
                 get_member_info<MemT>::info(),
-                get_collection_info<MemT>::info()),
+                get_collection_info<MemT>::info(),
+                is_bitwise<MemT>::value),
             member_(member)
         {
         }
@@ -495,6 +1095,43 @@ namespace introspection
         {
             throw std::logic_error("do_from_text() on struct");
         }
+        //  JSON arrays map straight onto the collection
+        virtual void do_to_json(void const *strct, json_writer &w) const
+        {
+            json_convert<MemT, false>::write(((Struct const *)strct)->*member_, w);
+        }
+        virtual void do_from_json(void *strct, json_reader &r) const
+        {
+            json_convert<MemT, false>::read(((Struct *)strct)->*member_, r);
+        }
+        virtual void do_wire_to_text(stream &iStr, std::string &oStr) const
+        {
+            wire_scalar<MemT, true>::to_text(iStr, oStr);
+        }
+        virtual void do_wire_to_json(stream &iStr, json_writer &w) const
+        {
+            wire_scalar<MemT, true>::to_json(iStr, w);
+        }
+        virtual char const *do_text_to_wire(char const *str, stream &oStr) const
+        {
+            return wire_scalar<MemT, true>::from_text(str, oStr);
+        }
+        virtual void do_json_to_wire(json_reader &r, stream &oStr) const
+        {
+            wire_scalar<MemT, true>::from_json(r, oStr);
+        }
+        virtual void do_hash(void const *strct, unsigned long long &h) const
+        {
+            value_ops<MemT, false>::hash(((Struct const *)strct)->*member_, h);
+        }
+        virtual bool do_equals(void const *a, void const *b) const
+        {
+            return value_ops<MemT, false>::equals(((Struct const *)a)->*member_, ((Struct const *)b)->*member_);
+        }
+        virtual int do_compare(void const *a, void const *b) const
+        {
+            return value_ops<MemT, false>::compare(((Struct const *)a)->*member_, ((Struct const *)b)->*member_);
+        }
         inline MemT Struct::*member() const { return member_; }
     protected:
         MemT Struct::*member_;
@@ -512,7 +1149,8 @@ namespace introspection
                 sizeof(MemT), 
                 0,
                 get_member_info<MemT>::info(),
-                0)
+                0,
+                false)
         {
         }
         virtual void create(void *ptr) const
@@ -539,20 +1177,56 @@ namespace introspection
         {
             return convert<MemT, true>::from_string(*(MemT *)strct, str);
         }
-    };
-
-    /* raw pointers are not supported, because memory management becomes a problem */
-    template<typename Struct, typename Item> struct member_access_t<Struct, Item const *, false>;
-    template<typename Struct, typename Item> struct member_access_t<Struct, Item *, false>;
-
-    //  Specialize get_desc() on your description if it's custom
-    template<typename Desc> char const *get_desc(Desc const &str) { return Desc::get_desc(str); }
-    //  non-template overrides template
-    inline char const *get_desc(char const *const &str) { return str; }
-    inline char const *get_desc(std::string const &str) { return str.c_str(); }
-
-    template<typename Desc>
-    struct member_info_t : member_info_base
+        virtual void do_to_json(void const *strct, json_writer &w) const
+        {
+            json_convert<MemT, true>::write(*(MemT const *)strct, w);
+        }
+        virtual void do_from_json(void *strct, json_reader &r) const
+        {
+            json_convert<MemT, true>::read(*(MemT *)strct, r);
+        }
+        virtual void do_wire_to_text(stream &iStr, std::string &oStr) const
+        {
+            wire_scalar<MemT, true>::to_text(iStr, oStr);
+        }
+        virtual void do_wire_to_json(stream &iStr, json_writer &w) const
+        {
+            wire_scalar<MemT, true>::to_json(iStr, w);
+        }
+        virtual char const *do_text_to_wire(char const *str, stream &oStr) const
+        {
+            return wire_scalar<MemT, true>::from_text(str, oStr);
+        }
+        virtual void do_json_to_wire(json_reader &r, stream &oStr) const
+        {
+            wire_scalar<MemT, true>::from_json(r, oStr);
+        }
+        virtual void do_hash(void const *strct, unsigned long long &h) const
+        {
+            value_ops<MemT, true>::hash(*(MemT const *)strct, h);
+        }
+        virtual bool do_equals(void const *a, void const *b) const
+        {
+            return value_ops<MemT, true>::equals(*(MemT const *)a, *(MemT const *)b);
+        }
+        virtual int do_compare(void const *a, void const *b) const
+        {
+            return value_ops<MemT, true>::compare(*(MemT const *)a, *(MemT const *)b);
+        }
+    };
+
+    /* raw pointers are not supported, because memory management becomes a problem */
+    template<typename Struct, typename Item> struct member_access_t<Struct, Item const *, false>;
+    template<typename Struct, typename Item> struct member_access_t<Struct, Item *, false>;
+
+    //  Specialize get_desc() on your description if it's custom
+    template<typename Desc> char const *get_desc(Desc const &str) { return Desc::get_desc(str); }
+    //  non-template overrides template
+    inline char const *get_desc(char const *const &str) { return str; }
+    inline char const *get_desc(std::string const &str) { return str.c_str(); }
+
+    template<typename Desc>
+    struct member_info_t : member_info_base
     {
         member_info_t(Desc const &desc)
             : member_info_base(get_desc(desc))
@@ -594,6 +1268,45 @@ namespace introspection
     inline member_t const *type_info_base::begin() const { return members_; }
     inline member_t const *type_info_base::end() const { return members_ + count_; }
 
+    /* FNV-1a, for looking up member names */
+    inline unsigned int hash_name(char const *name, size_t len)
+    {
+        unsigned int h = 2166136261u;
+        for (size_t i = 0; i != len; ++i)
+        {
+            h = (h ^ (unsigned char)name[i]) * 16777619u;
+        }
+        return h;
+    }
+
+    inline member_t const *type_info_base::find_member(char const *name, size_t len) const
+    {
+        size_t mask = index_.size() - 1;
+        for (size_t slot = hash_name(name, len) & mask; index_[slot] != 0; slot = (slot + 1) & mask)
+        {
+            member_t const &m = members_[index_[slot] - 1];
+            if (!strncmp(m.name(), name, len) && m.name()[len] == 0)
+            {
+                return &m;
+            }
+        }
+        return 0;
+    }
+
+    inline size_t type_info_base::member_at(size_t offset) const
+    {
+        size_t mask = offsets_.size() - 1;
+        for (size_t slot = hash_offset(offset) & mask; offsets_[slot] != 0; slot = (slot + 1) & mask)
+        {
+            size_t ix = offsets_[slot] - 1;
+            if (members_[ix].access().offset() == offset)
+            {
+                return ix;
+            }
+        }
+        return count_;
+    }
+
     /* simple_stream will reallocate its chunk of memory to it whatever you try to write 
        into it. It's a good first order approximation for how to set up the output part 
        of a file writer or network stream.
@@ -642,11 +1355,36 @@ namespace introspection
 
     /* A protocol is a collection of marshalable packets, each of which is given 
        an identifier (integer) to make packing/unpacking to/from a stream possible. */
+    class pdu_stats_collector;
+    struct protocol_stats_t;
+
+    /* the offset table and body written by protocol_t::encode_indexed() */
+    void write_indexed(type_info_base const &ti, void const *pdu, stream &oStr);
+
+    /* decodes the body of the PDU with the given code over a constructed instance */
+    typedef void (*generated_decode_fn)(int code, void *pdu, stream &iStr);
+
+    /* Each PDU type remembers its code in the first protocol that registers 
+       it, so encode() doesn't need to search for it. A type registered in 
+       more than one protocol falls back to a map lookup in the others. 
+       Copies of a protocol share its slots, and may add PDUs of their own, 
+       so a slot is only believed if the protocol has that type at that 
+       code. */
+    template<typename Pdu>
+    struct pdu_code_slot
+    {
+        static int protocol_;
+        static int code_;
+    };
+    template<typename Pdu> int pdu_code_slot<Pdu>::protocol_ = 0;
+    template<typename Pdu> int pdu_code_slot<Pdu>::code_ = 0;
+
     struct protocol_t
     {
         protocol_t(char const *name);
         protocol_t(protocol_t const &proto);
         protocol_t &operator=(protocol_t const &proto);
+        ~protocol_t();
 
         /* name of the protocol */
         char const *name() const;
@@ -662,11 +1400,21 @@ namespace introspection
         /* type for a given PDU code */
         inline type_info_base const &type(int code);
 
+        /* number of registered PDUs; their codes are 1 through pdu_count() */
+        inline int pdu_count() const { return (int)by_id_.size() - 1; }
+
         /* Encode a given concrete PDU into a stream for later decoding.
          */
         template<typename Pdu>
         void encode(Pdu const &t, stream &s);
 
+        /* Encode with a table of member offsets between the code and the 
+         * body, so that a lazy_pdu<Pdu> can decode single members without 
+         * parsing the others (see lazy_pdu.h). decode() can't read these.
+         */
+        template<typename Pdu>
+        void encode_indexed(Pdu const &t, stream &s);
+
         /* Decode a PDU in a given stream into the memory given. This 
          * will instantiate the appropriate concrete class, assuming 
          * sizeof(TheClass) is <= max_size.
@@ -676,11 +1424,86 @@ namespace introspection
         /* call the right destructor for the given packet code */
         inline void destroy(int code, void *dst);
 
+        /* Decode a PDU over the instance for its code in live, constructing 
+         * that instance (with operator new) the first time the code is seen. 
+         * Strings and containers keep their capacity from one decode to the 
+         * next, so steady-state decoding doesn't allocate. Returns the code; 
+         * the PDU is live[code]. Free the instances with release_recycled().
+         */
+        int decode_recycled(std::vector<void *> &live, stream &s);
+        void release_recycled(std::vector<void *> &live);
+
+        /* A constructed instance of the PDU with the given code, from the 
+         * pool for its type (see pool.h), and back again. 
+         */
+        void *acquire(int code);
+        void release(int code, void *pdu);
+
+        /* Decode into an instance from the pool for the PDU's type. The PDU 
+         * is the caller's until it goes back with release(code, oPdu), so 
+         * it can be queued or handed on. Returns the code.
+         */
+        int decode_pooled(void *&oPdu, stream &s);
+
+        /* encode a PDU given by its code, such as one from acquire() */
+        void encode(int code, void const *pdu, stream &s);
+
+        /* sizeof() the biggest registered PDU; enough memory to decode any of them */
+        inline size_t max_pdu_size() const { return max_pdu_size_; }
+
+        /* approximate memory used by the code tables */
+        size_t metadata_bytes() const;
+
+        /* Per-PDU traffic counters (encode/decode counts and bytes, decode 
+         * failures, handler time). Off by default; while off, the only cost 
+         * is a null pointer test. Define INTROSPECTION_NO_STATS to compile 
+         * the counting out entirely. Turning stats off discards the counts. 
+         * Either may be done while other threads encode and decode: each 
+         * call looks at the collector once, and one that's turned off is 
+         * kept (and left alone) until the protocol goes away. PDUs can't be 
+         * added while stats are on, since the collector has a fixed number 
+         * of codes.
+         */
+        void enable_stats(bool enable);
+        inline pdu_stats_collector *stats() const { return stats_; }
+        /* merge the per-thread counters into a printable snapshot */
+        void stats_snapshot(protocol_stats_t &oStats) const;
+
+        /* Used by the code the codegen tool writes (see codegen.h): decode 
+         * PDU bodies with a switch over the codes rather than through the 
+         * type info. The switch knows the codes there are now; PDUs added 
+         * after (to a copy, say) are decoded through their type info. */
+        void use_generated(generated_decode_fn decode_body);
+
     private:
-        protocol_t &add_pdu(type_info_base const *pdu);
-        std::map<int, type_info_base const *> by_id_;
+        int add_pdu(type_info_base const *pdu);
+        inline void put_body(type_info_base const &t, int code, void *dst, stream &s)
+        {
+            if (generated_ && code <= generated_codes_)
+            {
+                (*generated_)(code, dst, s);
+            }
+            else
+            {
+                t.access().put_to(dst, s);
+            }
+        }
+        int decode_counted(pdu_stats_collector *st, void *dst, size_t max_size, stream &s);
+        static void count_encode(pdu_stats_collector *st, int code, size_t bytes);
+        //  indexed by code; codes start at 1, so slot 0 is always empty
+        std::vector<type_info_base const *> by_id_;
         std::map<type_info_base const *, int> by_type_;
+        //  copies share the id, because they share the codes (code() checks 
+        //  the slot against by_id_, for what a copy adds)
+        int id_;
+        size_t max_pdu_size_;
         std::string name_;
+        pdu_stats_collector *volatile stats_;
+        //  collectors turned off, which a thread may still be counting in
+        std::vector<pdu_stats_collector *> retired_;
+        generated_decode_fn generated_;
+        //  the highest code the generated switch knows
+        int generated_codes_;
     };
 
     class dispatch_t
@@ -692,21 +1515,53 @@ namespace introspection
             template<typename Pdu, typename Handler>
             void add_handler(protocol_t const &proto, Handler *handler, void (Handler::*func)(Pdu const &))
             {
-                dispatch_[proto.code<Pdu>()] = new dispatch_rec<Pdu, Handler>(handler, func);
+                set_handler(proto.code<Pdu>(), new dispatch_rec<Pdu, Handler>(handler, func));
+                proto_ = &proto;
             }
 
             void dispatch(int c, void const *data);
 
+            /* Decode one PDU from the stream into storage owned by the 
+             * dispatcher, call its handler, and destroy it again (also when 
+             * the handler throws). Returns the code of the PDU.
+             */
+            int decode_and_dispatch(protocol_t &proto, stream &s);
+
+            /* Make decode_and_dispatch() keep one instance of each PDU type 
+             * alive, and decode over it, rather than constructing and 
+             * destroying a PDU per message. Handlers must not hold on to the 
+             * PDU they're handed past the call either way.
+             */
+            void recycle_pdus(bool recycle);
+
         private:
             class dispatch_base
             {
                 public:
+                    virtual ~dispatch_base() {}
                     virtual void dispatch(void const *ptr) = 0;
             };
+            //  the alignment of anything a PDU could contain
+            union pdu_storage
+            {
+                double d_;
+                long double ld_;
+                long long ll_;
+                void *p_;
+            };
  
             dispatch_t(dispatch_t const &);
             dispatch_t &operator=(dispatch_t const &);
-            std::map<int, dispatch_base *> dispatch_;
+            void set_handler(int c, dispatch_base *d);
+            void dispatch_timed(pdu_stats_collector *st, dispatch_base *d, int c, void const *data);
+            //  indexed by code; null where there is no handler
+            std::vector<dispatch_base *> dispatch_;
+            protocol_t const *proto_;
+            std::vector<pdu_storage> storage_;
+            bool decoding_;
+            bool recycle_;
+            protocol_t *live_proto_;
+            std::vector<void *> live_;
  
             template<typename Pdu, typename Handler>
             class dispatch_rec : public dispatch_base
@@ -733,11 +1588,11 @@ namespace introspection
     {
         inline static void output(T const &item, stream &oStr)
         {
-            oStr.write_bytes(sizeof(T), &item);
+            wire_order<T>::write(item, oStr);
         }
         inline static void input(T &item, stream &iStr)
         {
-            iStr.read_bytes(sizeof(T), &item);
+            wire_order<T>::read(item, iStr);
         }
     };
     template<>
@@ -769,6 +1624,25 @@ namespace introspection
     struct marshal<MemT, true>
     {
         inline static void output(MemT const &item, stream &oStr)
+        {
+            if (generated_codec_t const *gc = item.member_info().generated())
+            {
+                (*gc->encode)(&item, oStr);
+                return;
+            }
+            output_members(item, oStr);
+        }
+        inline static void input(MemT &item, stream &iStr)
+        {
+            if (generated_codec_t const *gc = item.member_info().generated())
+            {
+                (*gc->decode)(&item, iStr);
+                return;
+            }
+            input_members(item, iStr);
+        }
+        /* the interpreted path, member by member */
+        inline static void output_members(MemT const &item, stream &oStr)
         {
             for (member_t::iterator ptr(item.member_info().begin()), end(item.member_info().end());
                 ptr != end; ++ptr)
@@ -776,7 +1650,7 @@ namespace introspection
                 (*ptr).access().get_from(&item, oStr);
             }
         }
-        inline static void input(MemT &item, stream &iStr)
+        inline static void input_members(MemT &item, stream &iStr)
         {
             for (member_t::iterator ptr(item.member_info().begin()), end(item.member_info().end());
                 ptr != end; ++ptr)
@@ -850,6 +1724,15 @@ namespace introspection
     struct convert<MemT, true>
     {
         inline static void to_string(MemT const &item, std::string &oStr)
+        {
+            if (generated_codec_t const *gc = item.member_info().generated())
+            {
+                (*gc->to_text)(&item, oStr);
+                return;
+            }
+            to_string_members(item, oStr);
+        }
+        inline static void to_string_members(MemT const &item, std::string &oStr)
         {
             oStr = "[ ";
             for (member_t::iterator ptr(item.member_info().begin()), end(item.member_info().end());
@@ -909,22 +1792,7 @@ namespace introspection
         {
             unsigned int cnt = collection_->size((char const *)strct + offset_);
             marshal<unsigned int, false>::output(cnt, oStr);
-            void *ptr = 0, *end = 0;
-            member_access_base *acc;
-            try
-            {
-                if (collection_->begin_iteration((char const *)strct + offset_, ptr, end, acc)) do
-                {
-                    void *elem;
-                    collection_->get_element(ptr, elem);
-                    acc->get_from(elem, oStr);
-                }
-                while (collection_->increment(ptr, end));
-            }
-            catch (...)
-            {
-                collection_->cleanup(ptr, end);
-            }
+            collection_->write_to((char const *)strct + offset_, oStr);
         }
         else
         {
@@ -937,10 +1805,7 @@ namespace introspection
         {
             unsigned int cnt = 0;
             marshal<unsigned int, false>::input(cnt, iStr);
-            for (unsigned int i = 0; i != cnt; ++i)
-            {
-                collection_->append_from((char *)strct + offset_, iStr);
-            }
+            collection_->read_from((char *)strct + offset_, cnt, iStr);
         }
         else
         {
@@ -1015,55 +1880,1510 @@ namespace introspection
         }
     }
 
-    /* used by macros declaring PDUs for the protocol */
-    template<typename Pdu>
-    inline protocol_t &protocol_t::add_pdu()
+    /* JSON support */
+    /* json_writer produces compact JSON in a single pass, through a small 
+       buffer that is flushed to a string or a stream. json_reader is a pull 
+       parser over a mutable buffer; strings are unescaped in place, so 
+       reading a document doesn't allocate except for the values stored. 
+       Both are driven by member_info(): objects map to introspected 
+       structs by member name, arrays to collections. Unknown keys are 
+       skipped, and members that are missing keep the value they had. */
+    class json_writer
     {
-        return add_pdu(&Pdu::member_info());
-    }
+        public:
+            /* appends to oStr */
+            json_writer(std::string &oStr);
+            json_writer(stream &oStr);
+            ~json_writer();
 
-    /* code for a given PDU */
-    template<typename Pdu>
-    inline int protocol_t::code() const
+            void begin_object();
+            void end_object();
+            void begin_array();
+            void end_array();
+            /* name must not need escaping (member names don't) */
+            void key(char const *name);
+            void value(long long v);
+            void value(unsigned long long v);
+            void value(double v);
+            void value(float v);
+            void value(bool v);
+            void string(char const *str, size_t len);
+            void flush();
+
+        private:
+            inline void separate()
+            {
+                if (!first_)
+                {
+                    put(',');
+                }
+                first_ = false;
+            }
+            inline void put(char ch)
+            {
+                if (pos_ == sizeof(buf_))
+                {
+                    flush();
+                }
+                buf_[pos_++] = ch;
+            }
+            void put(char const *data, size_t size);
+
+            json_writer(json_writer const &);
+            json_writer &operator=(json_writer const &);
+            std::string *str_;
+            stream *strm_;
+            bool first_;
+            size_t pos_;
+            char buf_[4096];
+    };
+
+    class json_reader
     {
-        std::map<type_info_base const *, int>::const_iterator ptr(by_type_.find(&Pdu::member_info()));
-        if (ptr == by_type_.end())
+        public:
+            /* data is modified while reading, and must outlive the strings 
+               read with the pointer/length read_string() */
+            json_reader(char *data, size_t size);
+
+            /* Iterate an object with
+                 bool first = true;
+                 r.begin_object();
+                 while (r.next_key(first, name, len)) { read or skip the value }
+               and an array the same way with begin_array()/next_element(). */
+            void begin_object();
+            bool next_key(bool &first, char const *&name, size_t &len);
+            void begin_array();
+            bool next_element(bool &first);
+
+            long long read_int();
+            unsigned long long read_uint();
+            double read_double();
+            bool read_bool();
+            void read_string(char const *&str, size_t &len);
+            void read_string(std::string &str);
+            /* true (and consumed) if the next value is null */
+            bool read_null();
+            void skip_value();
+            /* throws unless only whitespace is left */
+            void finish();
+
+        private:
+            inline void skip_ws()
+            {
+                while (pos_ != end_ && (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t'))
+                {
+                    ++pos_;
+                }
+            }
+            inline char peek()
+            {
+                skip_ws();
+                return pos_ == end_ ? 0 : *pos_;
+            }
+            void expect(char ch);
+            bool literal(char const *word);
+            void enter();
+            void fail(char const *what);
+
+            char *pos_;
+            char *end_;
+            char *begin_;
+            int depth_;
+    };
+
+    /* the maximum nesting of objects and arrays json_reader accepts */
+    enum { JSON_MAX_DEPTH = 256 };
+
+    /* how a scalar maps to JSON: 1 signed, 2 unsigned, 3 floating, 4 bool, 
+       0 a string holding the convert<> text */
+    template<typename T> struct json_kind { enum { value = 0 }; };
+    template<> struct json_kind<bool> { enum { value = 4 }; };
+    template<> struct json_kind<char> { enum { value = ((char)-1 < 0) ? 1 : 2 }; };
+    template<> struct json_kind<signed char> { enum { value = 1 }; };
+    template<> struct json_kind<unsigned char> { enum { value = 2 }; };
+    template<> struct json_kind<short> { enum { value = 1 }; };
+    template<> struct json_kind<unsigned short> { enum { value = 2 }; };
+    template<> struct json_kind<int> { enum { value = 1 }; };
+    template<> struct json_kind<unsigned int> { enum { value = 2 }; };
+    template<> struct json_kind<long> { enum { value = 1 }; };
+    template<> struct json_kind<unsigned long> { enum { value = 2 }; };
+    template<> struct json_kind<long long> { enum { value = 1 }; };
+    template<> struct json_kind<unsigned long long> { enum { value = 2 }; };
+    template<> struct json_kind<float> { enum { value = 3 }; };
+    template<> struct json_kind<double> { enum { value = 3 }; };
+
+    template<typename T, int Kind> struct json_scalar;
+    template<typename T> struct json_scalar<T, 0>
+    {
+        inline static void write(T const &item, json_writer &w)
         {
-            throw std::runtime_error("could not find code for type - is it registered?");
+            std::string tmp;
+            convert<T, false>::to_string(item, tmp);
+            w.string(tmp.c_str(), tmp.size() ? tmp.size() - 1 : 0);
         }
-        return (*ptr).second;
-    }
+        inline static void read(T &item, json_reader &r)
+        {
+            std::string tmp;
+            r.read_string(tmp);
+            convert<T, false>::from_string(item, tmp.c_str());
+        }
+    };
+    template<typename T> struct json_scalar<T, 1>
+    {
+        inline static void write(T const &item, json_writer &w) { w.value((long long)item); }
+        inline static void read(T &item, json_reader &r)
+        {
+            long long v = r.read_int();
+            item = (T)v;
+            if ((long long)item != v)
+            {
+                throw std::runtime_error("JSON number out of range");
+            }
+        }
+    };
+    template<typename T> struct json_scalar<T, 2>
+    {
+        inline static void write(T const &item, json_writer &w) { w.value((unsigned long long)item); }
+        inline static void read(T &item, json_reader &r)
+        {
+            unsigned long long v = r.read_uint();
+            item = (T)v;
+            if ((unsigned long long)item != v)
+            {
+                throw std::runtime_error("JSON number out of range");
+            }
+        }
+    };
+    template<typename T> struct json_scalar<T, 3>
+    {
+        inline static void write(T const &item, json_writer &w) { w.value(item); }
+        inline static void read(T &item, json_reader &r) { item = (T)r.read_double(); }
+    };
+    template<typename T> struct json_scalar<T, 4>
+    {
+        inline static void write(T const &item, json_writer &w) { w.value(item); }
+        inline static void read(T &item, json_reader &r) { item = r.read_bool(); }
+    };
 
-    /* type for a given PDU code */
-    inline type_info_base const &protocol_t::type(int code)
+    template<typename T>
+    struct json_convert<T, false> : json_scalar<T, json_kind<T>::value>
+    {
+    };
+    template<>
+    struct json_convert<std::string, false>
+    {
+        inline static void write(std::string const &item, json_writer &w) { w.string(item.data(), item.size()); }
+        inline static void read(std::string &item, json_reader &r) { r.read_string(item); }
+    };
+    template<>
+    struct json_convert<char const *, false>
+    {
+        inline static void write(char const *const &item, json_writer &w) { w.string(item, strlen(item)); }
+        //  void read(char const *&item, json_reader &r)    //  no can do
+    };
+
+    /* arrays; elements are appended as they are parsed */
+    template<typename Coll>
+    struct json_sequence
     {
-        std::map<int, type_info_base const *>::iterator ptr(by_id_.find(code));
-        if (ptr == by_id_.end())
+        typedef typename Coll::value_type value_type;
+        typedef json_convert<value_type, has_member_info<value_type>::value> element;
+        inline static void write(Coll const &item, json_writer &w)
         {
-            throw std::runtime_error("could not find type for code - is it registered?");
+            w.begin_array();
+            for (typename Coll::const_iterator ptr(item.begin()), end(item.end()); ptr != end; ++ptr)
+            {
+                element::write(*ptr, w);
+            }
+            w.end_array();
         }
-        return *(*ptr).second;
-    }
+        inline static void read(Coll &item, json_reader &r)
+        {
+            item.clear();
+            r.begin_array();
+            bool first = true;
+            while (r.next_element(first))
+            {
+                item.push_back(value_type());
+                element::read(item.back(), r);
+            }
+        }
+    };
+    template<typename T> struct json_convert<std::list<T>, false> : json_sequence<std::list<T> > {};
+    template<typename T> struct json_convert<std::vector<T>, false> : json_sequence<std::vector<T> > {};
+    template<typename T> struct json_convert<std::deque<T>, false> : json_sequence<std::deque<T> > {};
+    /* sets and maps; each entry is read, then moved in */
+    template<typename Coll>
+    struct json_entries
+    {
+        typedef typename collection_entry<Coll>::type entry;
+        typedef json_convert<entry, has_member_info<entry>::value> element;
+        inline static void write(Coll const &item, json_writer &w)
+        {
+            json_sequence<Coll>::write(item, w);
+        }
+        inline static void read(Coll &item, json_reader &r)
+        {
+            item.clear();
+            r.begin_array();
+            bool first = true;
+            while (r.next_element(first))
+            {
+                entry tmp;
+                element::read(tmp, r);
+                item.emplace_hint(item.end(), std::move(tmp));
+            }
+        }
+    };
+    template<typename T> struct json_convert<std::set<T>, false> : json_entries<std::set<T> > {};
+    template<typename T> struct json_convert<std::multiset<T>, false> : json_entries<std::multiset<T> > {};
+    template<typename K, typename V> struct json_convert<std::map<K, V>, false> : json_entries<std::map<K, V> > {};
+    template<typename K, typename V> struct json_convert<std::unordered_map<K, V>, false> : json_entries<std::unordered_map<K, V> > {};
 
-    template<typename Pdu>
-    void protocol_t::encode(Pdu const &t, stream &s)
+    template<typename MemT>
+    struct json_convert<MemT, true>
     {
-        int c = code<Pdu>();
-        marshal<int, false>::output(c, s);
-        Pdu::member_info().access().get_from(&t, s);
+        inline static void write(MemT const &item, json_writer &w)
+        {
+            w.begin_object();
+            for (member_t::iterator ptr(item.member_info().begin()), end(item.member_info().end());
+                ptr != end; ++ptr)
+            {
+                w.key((*ptr).name());
+                (*ptr).access().to_json(&item, w);
+            }
+            w.end_object();
+        }
+        inline static void read(MemT &item, json_reader &r)
+        {
+            type_info_base const &ti = item.member_info();
+            r.begin_object();
+            bool first = true;
+            char const *name;
+            size_t len;
+            while (r.next_key(first, name, len))
+            {
+                if (member_t const *m = ti.find_member(name, len))
+                {
+                    m->access().from_json(&item, r);
+                }
+                else
+                {
+                    r.skip_value();
+                }
+            }
+        }
+    };
+
+    /* write obj as a JSON object, replacing the contents of oStr */
+    template<typename T>
+    inline void to_json(T const &obj, std::string &oStr)
+    {
+        oStr.clear();
+        json_writer w(oStr);
+        json_convert<T, true>::write(obj, w);
+    }
+    template<typename T>
+    inline void to_json(T const &obj, stream &oStr)
+    {
+        json_writer w(oStr);
+        json_convert<T, true>::write(obj, w);
+    }
+    /* parse a JSON object into obj; data is used as scratch space */
+    template<typename T>
+    inline void from_json(T &obj, char *data, size_t size)
+    {
+        json_reader r(data, size);
+        json_convert<T, true>::read(obj, r);
+        r.finish();
+    }
+    template<typename T>
+    inline void from_json(T &obj, std::string const &str)
+    {
+        std::vector<char> tmp(str.begin(), str.end());
+        from_json(obj, tmp.empty() ? 0 : &tmp[0], tmp.size());
     }
 
-    inline int protocol_t::decode(void *dst, size_t max_size, stream &s)
+    /* Transcoding support: the binary form of a scalar to and from its text 
+       and JSON forms, through a temporary of the scalar type only. Compound 
+       members and collections are walked by member_access_base itself. */
+    void append_decimal(long long v, std::string &oStr);
+    void append_decimal(unsigned long long v, std::string &oStr);
+
+    template<typename T, int Kind>
+    struct scalar_text
     {
-        int c;
-        marshal<int, false>::input(c, s);
-        type_info_base const &t = type(c);
-        if (t.access().size() > max_size)
+        inline static void append(T const &item, std::string &oStr)
         {
-            throw std::runtime_error("not enough space for type in decode()");
+            std::string tmp;
+            convert<T, false>::to_string(item, tmp);
+            oStr += tmp;
+        }
+    };
+    //  integers skip the stringstream; char types print as characters
+    template<typename T>
+    struct scalar_text<T, 1>
+    {
+        inline static void append(T const &item, std::string &oStr)
+        {
+            if (sizeof(T) == 1)
+            {
+                scalar_text<T, 0>::append(item, oStr);
+                return;
+            }
+            append_decimal((long long)item, oStr);
+            oStr += ' ';
+        }
+    };
+    template<typename T>
+    struct scalar_text<T, 2>
+    {
+        inline static void append(T const &item, std::string &oStr)
+        {
+            if (sizeof(T) == 1)
+            {
+                scalar_text<T, 0>::append(item, oStr);
+                return;
+            }
+            append_decimal((unsigned long long)item, oStr);
+            oStr += ' ';
+        }
+    };
+    template<>
+    struct scalar_text<std::string, 0>
+    {
+        inline static void append(std::string const &item, std::string &oStr)
+        {
+            quote_str(item.c_str(), oStr);
+            oStr += ' ';
+        }
+    };
+
+    template<typename T>
+    struct wire_scalar<T, false>
+    {
+        //  value initialized, which works for arrays too
+        struct holder
+        {
+            holder() : item() {}
+            T item;
+        };
+        inline static void to_text(stream &iStr, std::string &oStr)
+        {
+            holder h;
+            marshal<T, false>::input(h.item, iStr);
+            scalar_text<T, json_kind<T>::value>::append(h.item, oStr);
+        }
+        inline static void to_json(stream &iStr, json_writer &w)
+        {
+            holder h;
+            marshal<T, false>::input(h.item, iStr);
+            json_convert<T, false>::write(h.item, w);
+        }
+        inline static char const *from_text(char const *str, stream &oStr)
+        {
+            holder h;
+            str = convert<T, false>::from_string(h.item, str);
+            marshal<T, false>::output(h.item, oStr);
+            return str;
+        }
+        inline static void from_json(json_reader &r, stream &oStr)
+        {
+            holder h;
+            json_convert<T, false>::read(h.item, r);
+            marshal<T, false>::output(h.item, oStr);
+        }
+    };
+    template<typename T>
+    struct wire_scalar<T, true>
+    {
+        inline static void to_text(stream &, std::string &)
+        {
+            throw std::logic_error("do_wire_to_text() on compound or collection");
+        }
+        inline static void to_json(stream &, json_writer &)
+        {
+            throw std::logic_error("do_wire_to_json() on compound or collection");
+        }
+        inline static char const *from_text(char const *, stream &)
+        {
+            throw std::logic_error("do_text_to_wire() on compound or collection");
+        }
+        inline static void from_json(json_reader &, stream &)
+        {
+            throw std::logic_error("do_json_to_wire() on compound or collection");
+        }
+    };
+
+    /* Hashing, equality and ordering */
+    /* Derived from member_info(), so they can't drift from the member list. 
+       Strings and collections compare by content, compound members member 
+       by member. Runs of bitwise members, and vectors of bitwise elements, 
+       are hashed and compared as blocks of bytes, which means floating 
+       point members are equal when their bits are (0.0 and -0.0 differ, a 
+       NaN equals itself). compare() orders numbers by value and breaks ties 
+       by bits, so it agrees with equals(). */
+
+    /* 64 bit non-cryptographic hash of the bytes, chained through seed */
+    unsigned long long hash_bytes(void const *data, size_t size, unsigned long long seed);
+
+    template<typename T> inline int compare_bytes(T const &a, T const &b)
+    {
+        int c = memcmp(&a, &b, sizeof(T));
+        return (c > 0) - (c < 0);
+    }
+
+    template<typename T, int Kind>
+    struct scalar_ops
+    {
+        inline static void hash(T const &item, unsigned long long &h) { h = hash_bytes(&item, sizeof(T), h); }
+        inline static bool equals(T const &a, T const &b) { return !memcmp(&a, &b, sizeof(T)); }
+        inline static int compare(T const &a, T const &b)
+        {
+            if (a < b)
+            {
+                return -1;
+            }
+            if (b < a)
+            {
+                return 1;
+            }
+            return compare_bytes(a, b);
+        }
+    };
+    //  types that aren't numbers are opaque bytes, as in marshal<>
+    template<typename T>
+    struct scalar_ops<T, 0> : scalar_ops<T, 1>
+    {
+        inline static int compare(T const &a, T const &b) { return compare_bytes(a, b); }
+    };
+
+    template<typename T>
+    struct value_ops<T, false> : scalar_ops<T, json_kind<T>::value>
+    {
+    };
+    template<>
+    struct value_ops<std::string, false>
+    {
+        inline static void hash(std::string const &item, unsigned long long &h)
+        {
+            h = hash_bytes(item.data(), item.size(), h);
+        }
+        inline static bool equals(std::string const &a, std::string const &b) { return a == b; }
+        inline static int compare(std::string const &a, std::string const &b)
+        {
+            int c = a.compare(b);
+            return (c > 0) - (c < 0);
+        }
+    };
+
+    template<typename Coll>
+    struct sequence_ops
+    {
+        typedef typename Coll::value_type value_type;
+        typedef value_ops<value_type, has_member_info<value_type>::value> element;
+        inline static void hash(Coll const &item, unsigned long long &h)
+        {
+            size_t size = item.size();
+            h = hash_bytes(&size, sizeof(size), h);
+            for (typename Coll::const_iterator ptr(item.begin()), end(item.end()); ptr != end; ++ptr)
+            {
+                element::hash(*ptr, h);
+            }
+        }
+        inline static bool equals(Coll const &a, Coll const &b)
+        {
+            if (a.size() != b.size())
+            {
+                return false;
+            }
+            for (typename Coll::const_iterator pa(a.begin()), pb(b.begin()), end(a.end()); pa != end; ++pa, ++pb)
+            {
+                if (!element::equals(*pa, *pb))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        /* lexicographic, like the standard containers */
+        inline static int compare(Coll const &a, Coll const &b)
+        {
+            typename Coll::const_iterator pa(a.begin()), ea(a.end()), pb(b.begin()), eb(b.end());
+            for (; pa != ea && pb != eb; ++pa, ++pb)
+            {
+                if (int c = element::compare(*pa, *pb))
+                {
+                    return c;
+                }
+            }
+            return (pa != ea) - (pb != eb);
+        }
+    };
+    template<typename T, bool Bitwise>
+    struct vector_ops : sequence_ops<std::vector<T> >
+    {
+    };
+    template<typename T>
+    struct vector_ops<T, true> : sequence_ops<std::vector<T> >
+    {
+        inline static void hash(std::vector<T> const &item, unsigned long long &h)
+        {
+            size_t size = item.size();
+            h = hash_bytes(&size, sizeof(size), h);
+            if (size)
+            {
+                h = hash_bytes(&item[0], size * sizeof(T), h);
+            }
+        }
+        inline static bool equals(std::vector<T> const &a, std::vector<T> const &b)
+        {
+            return a.size() == b.size() && (a.empty() || !memcmp(&a[0], &b[0], a.size() * sizeof(T)));
+        }
+    };
+    template<typename T> struct value_ops<std::list<T>, false> : sequence_ops<std::list<T> > {};
+    template<typename T> struct value_ops<std::vector<T>, false> : vector_ops<T, is_bitwise<T>::value != 0> {};
+    template<typename T> struct value_ops<std::set<T>, false> : sequence_ops<std::set<T> > {};
+    template<typename T> struct value_ops<std::deque<T>, false> : sequence_ops<std::deque<T> > {};
+    template<typename T> struct value_ops<std::multiset<T>, false> : sequence_ops<std::multiset<T> > {};
+    template<typename K, typename V> struct value_ops<std::map<K, V>, false> : sequence_ops<std::map<K, V> > {};
+    /* iteration order means nothing here: the hash is a sum over the 
+       entries, equality looks keys up, and ordering compares the sorted 
+       entries */
+    template<typename Coll>
+    struct unordered_ops
+    {
+        typedef typename Coll::value_type value_type;
+        typedef value_ops<value_type, false> element;
+        struct entry_less
+        {
+            inline bool operator()(value_type const *a, value_type const *b) const
+            {
+                return element::compare(*a, *b) < 0;
+            }
+        };
+        inline static void hash(Coll const &item, unsigned long long &h)
+        {
+            size_t size = item.size();
+            h = hash_bytes(&size, sizeof(size), h);
+            unsigned long long sum = 0;
+            for (typename Coll::const_iterator ptr(item.begin()), end(item.end()); ptr != end; ++ptr)
+            {
+                unsigned long long eh = 0;
+                element::hash(*ptr, eh);
+                sum += eh;
+            }
+            h = hash_bytes(&sum, sizeof(sum), h);
+        }
+        inline static bool equals(Coll const &a, Coll const &b)
+        {
+            if (a.size() != b.size())
+            {
+                return false;
+            }
+            for (typename Coll::const_iterator pa(a.begin()), end(a.end()); pa != end; ++pa)
+            {
+                typename Coll::const_iterator pb(b.find((*pa).first));
+                if (pb == b.end() || !element::equals(*pa, *pb))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        inline static int compare(Coll const &a, Coll const &b)
+        {
+            std::vector<value_type const *> sa, sb;
+            sorted(a, sa);
+            sorted(b, sb);
+            for (size_t i = 0; i != sa.size() && i != sb.size(); ++i)
+            {
+                if (int c = element::compare(*sa[i], *sb[i]))
+                {
+                    return c;
+                }
+            }
+            return (sa.size() > sb.size()) - (sa.size() < sb.size());
+        }
+        inline static void sorted(Coll const &c, std::vector<value_type const *> &out)
+        {
+            out.reserve(c.size());
+            for (typename Coll::const_iterator ptr(c.begin()), end(c.end()); ptr != end; ++ptr)
+            {
+                out.push_back(&*ptr);
+            }
+            std::sort(out.begin(), out.end(), entry_less());
+        }
+    };
+    template<typename K, typename V> struct value_ops<std::unordered_map<K, V>, false> : unordered_ops<std::unordered_map<K, V> > {};
+
+    template<typename MemT>
+    struct value_ops<MemT, true>
+    {
+        typedef std::vector<type_info_base::member_run> runs_t;
+        inline static void hash(MemT const &item, unsigned long long &h)
+        {
+            runs_t const &runs = item.member_info().runs();
+            for (typename runs_t::const_iterator ptr(runs.begin()), end(runs.end()); ptr != end; ++ptr)
+            {
+                if ((*ptr).member)
+                {
+                    (*ptr).member->access().hash(&item, h);
+                }
+                else
+                {
+                    h = hash_bytes((char const *)&item + (*ptr).offset, (*ptr).size, h);
+                }
+            }
+        }
+        inline static bool equals(MemT const &a, MemT const &b)
+        {
+            runs_t const &runs = a.member_info().runs();
+            for (typename runs_t::const_iterator ptr(runs.begin()), end(runs.end()); ptr != end; ++ptr)
+            {
+                if ((*ptr).member)
+                {
+                    if (!(*ptr).member->access().equals(&a, &b))
+                    {
+                        return false;
+                    }
+                }
+                else if (memcmp((char const *)&a + (*ptr).offset, (char const *)&b + (*ptr).offset, (*ptr).size))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        /* member by member, in declaration order */
+        inline static int compare(MemT const &a, MemT const &b)
+        {
+            for (member_t::iterator ptr(a.member_info().begin()), end(a.member_info().end());
+                ptr != end; ++ptr)
+            {
+                if (int c = (*ptr).access().compare(&a, &b))
+                {
+                    return c;
+                }
+            }
+            return 0;
+        }
+    };
+
+    template<typename T>
+    inline size_t hash(T const &obj)
+    {
+        unsigned long long h = 0;
+        value_ops<T, has_member_info<T>::value>::hash(obj, h);
+        return (size_t)(h ^ (h >> 32));
+    }
+    template<typename T>
+    inline bool equals(T const &a, T const &b)
+    {
+        return value_ops<T, has_member_info<T>::value>::equals(a, b);
+    }
+    /* -1, 0 or 1 */
+    template<typename T>
+    inline int compare(T const &a, T const &b)
+    {
+        return value_ops<T, has_member_info<T>::value>::compare(a, b);
+    }
+
+    /* functors, for std::unordered_map<K, V, introspection::hasher, introspection::equal_to> 
+       and std::map<K, V, introspection::less> */
+    struct hasher
+    {
+        template<typename T> inline size_t operator()(T const &obj) const { return introspection::hash(obj); }
+    };
+    struct equal_to
+    {
+        template<typename T> inline bool operator()(T const &a, T const &b) const { return introspection::equals(a, b); }
+    };
+    struct less
+    {
+        template<typename T> inline bool operator()(T const &a, T const &b) const { return introspection::compare(a, b) < 0; }
+    };
+
+    /* Map entries */
+    /* A std::pair is the key, then the value, each through value_access(), 
+       so either can be a compound or a collection. The text form is 
+       "[ key value ] ", and the JSON form a two element array. Keys inside a 
+       map are const; decoding is into a plain pair (see collection_entry), 
+       so the const_cast in the input paths only ever touches temporaries. */
+    template<typename K, typename V>
+    struct pair_access
+    {
+        typedef typename std::remove_const<K>::type key_type;
+        static inline member_access_base const &key() { return value_access<key_type>(); }
+        static inline member_access_base const &value() { return value_access<V>(); }
+        static inline key_type *key_ptr(std::pair<K, V> &item) { return const_cast<key_type *>(&item.first); }
+    };
+    template<typename K, typename V>
+    struct marshal<std::pair<K, V>, false>
+    {
+        typedef pair_access<K, V> acc;
+        inline static void output(std::pair<K, V> const &item, stream &oStr)
+        {
+            acc::key().get_from(&item.first, oStr);
+            acc::value().get_from(&item.second, oStr);
+        }
+        inline static void input(std::pair<K, V> &item, stream &iStr)
+        {
+            acc::key().put_to(acc::key_ptr(item), iStr);
+            acc::value().put_to(&item.second, iStr);
+        }
+    };
+    template<typename K, typename V>
+    struct convert<std::pair<K, V>, false>
+    {
+        typedef pair_access<K, V> acc;
+        inline static void to_string(std::pair<K, V> const &item, std::string &oStr)
+        {
+            std::string tmp;
+            oStr = "[ ";
+            acc::key().to_text(&item.first, tmp);
+            oStr += tmp;
+            acc::value().to_text(&item.second, tmp);
+            oStr += tmp;
+            oStr += "] ";
+        }
+        inline static char const *from_string(std::pair<K, V> &item, char const *str)
+        {
+            while (*str && isspace(*str))
+            {
+                ++str;
+            }
+            if (*str != '[')
+            {
+                throw std::runtime_error("missing bracket in pair from_string()");
+            }
+            str = acc::key().from_text(acc::key_ptr(item), str + 1);
+            str = acc::value().from_text(&item.second, str);
+            while (*str && isspace(*str))
+            {
+                ++str;
+            }
+            if (*str != ']')
+            {
+                throw std::runtime_error("missing end bracket in pair from_string()");
+            }
+            return str + 1;
+        }
+    };
+    template<typename K, typename V>
+    struct json_convert<std::pair<K, V>, false>
+    {
+        typedef pair_access<K, V> acc;
+        inline static void write(std::pair<K, V> const &item, json_writer &w)
+        {
+            w.begin_array();
+            acc::key().to_json(&item.first, w);
+            acc::value().to_json(&item.second, w);
+            w.end_array();
+        }
+        inline static void read(std::pair<K, V> &item, json_reader &r)
+        {
+            r.begin_array();
+            bool first = true;
+            if (!r.next_element(first))
+            {
+                throw std::runtime_error("JSON: missing key in pair");
+            }
+            acc::key().from_json(acc::key_ptr(item), r);
+            if (!r.next_element(first))
+            {
+                throw std::runtime_error("JSON: missing value in pair");
+            }
+            acc::value().from_json(&item.second, r);
+            if (r.next_element(first))
+            {
+                throw std::runtime_error("JSON: more than two elements in pair");
+            }
+        }
+    };
+    template<typename K, typename V>
+    struct value_ops<std::pair<K, V>, false>
+    {
+        typedef pair_access<K, V> acc;
+        inline static void hash(std::pair<K, V> const &item, unsigned long long &h)
+        {
+            acc::key().hash(&item.first, h);
+            acc::value().hash(&item.second, h);
+        }
+        inline static bool equals(std::pair<K, V> const &a, std::pair<K, V> const &b)
+        {
+            return acc::key().equals(&a.first, &b.first) && acc::value().equals(&a.second, &b.second);
+        }
+        inline static int compare(std::pair<K, V> const &a, std::pair<K, V> const &b)
+        {
+            if (int c = acc::key().compare(&a.first, &b.first))
+            {
+                return c;
+            }
+            return acc::value().compare(&a.second, &b.second);
+        }
+    };
+    //  transcoding decodes into a temporary; make that a plain pair
+    template<typename K, typename V>
+    struct wire_scalar<std::pair<K const, V>, false> : wire_scalar<std::pair<K, V>, false>
+    {
+    };
+
+    /* Inline strings and fixed size arrays */
+    /* fixed_string<N> keeps up to N characters inside the object, so a 
+       member of this type never allocates. It marshals exactly like 
+       std::string (a length-prefixed block), so a member can switch between 
+       the two without changing the wire format. Assigning, or decoding, a 
+       string longer than N throws. */
+    template<size_t N>
+    class fixed_string
+    {
+        public:
+            fixed_string() : size_(0) { data_[0] = 0; }
+            fixed_string(char const *str) { assign(str, strlen(str)); }
+            fixed_string(std::string const &str) { assign(str.data(), str.size()); }
+            fixed_string &operator=(char const *str) { assign(str, strlen(str)); return *this; }
+            fixed_string &operator=(std::string const &str) { assign(str.data(), str.size()); return *this; }
+            void assign(char const *data, size_t size)
+            {
+                resize(size);
+                memmove(data_, data, size);
+            }
+            /* new characters are left as they were */
+            void resize(size_t size)
+            {
+                if (size > N)
+                {
+                    throw std::length_error("fixed_string overflow");
+                }
+                size_ = (unsigned int)size;
+                data_[size] = 0;
+            }
+            inline size_t size() const { return size_; }
+            inline bool empty() const { return size_ == 0; }
+            static inline size_t capacity() { return N; }
+            inline char const *c_str() const { return data_; }
+            inline char const *data() const { return data_; }
+            inline char *data() { return data_; }
+            inline std::string str() const { return std::string(data_, size_); }
+            inline int compare(fixed_string const &o) const
+            {
+                int c = memcmp(data_, o.data_, size_ < o.size_ ? size_ : o.size_);
+                if (c == 0)
+                {
+                    c = (size_ > o.size_) - (size_ < o.size_);
+                }
+                return (c > 0) - (c < 0);
+            }
+            inline bool operator==(fixed_string const &o) const { return size_ == o.size_ && !memcmp(data_, o.data_, size_); }
+            inline bool operator!=(fixed_string const &o) const { return !(*this == o); }
+            inline bool operator<(fixed_string const &o) const { return compare(o) < 0; }
+            inline bool operator==(char const *str) const { return !strncmp(data_, str, size_) && str[size_] == 0; }
+            inline bool operator!=(char const *str) const { return !(*this == str); }
+        private:
+            unsigned int size_;
+            char data_[N + 1];
+    };
+
+    template<size_t N>
+    struct marshal<fixed_string<N>, false>
+    {
+        inline static void output(fixed_string<N> const &item, stream &oStr)
+        {
+            write_block(item.size(), item.data(), oStr);
+        }
+        inline static void input(fixed_string<N> &item, stream &iStr)
+        {
+            size_t len = 0;
+            read_block_length(len, iStr);
+            if (len > N)
+            {
+                throw std::runtime_error("string too long for fixed_string in input()");
+            }
+            item.resize(len);
+            if (len > 0)
+                read_block_data(len, item.data(), iStr);
+        }
+    };
+    template<size_t N>
+    struct convert<fixed_string<N>, false>
+    {
+        inline static void to_string(fixed_string<N> const &item, std::string &oStr)
+        {
+            oStr.clear();
+            quote_str(item.c_str(), oStr);
+            oStr += " ";
+        }
+        inline static char const *from_string(fixed_string<N> &item, char const *iStr)
+        {
+            std::string tmp;
+            iStr = unquote_str(iStr, tmp);
+            if (tmp.size() > N)
+            {
+                throw std::runtime_error("string too long for fixed_string in from_string()");
+            }
+            item = tmp;
+            return iStr;
+        }
+    };
+    template<size_t N>
+    struct json_convert<fixed_string<N>, false>
+    {
+        inline static void write(fixed_string<N> const &item, json_writer &w) { w.string(item.data(), item.size()); }
+        inline static void read(fixed_string<N> &item, json_reader &r)
+        {
+            char const *str;
+            size_t len;
+            r.read_string(str, len);
+            if (len > N)
+            {
+                throw std::runtime_error("JSON: string too long for fixed_string");
+            }
+            item.assign(str, len);
+        }
+    };
+    template<size_t N>
+    struct scalar_text<fixed_string<N>, 0>
+    {
+        inline static void append(fixed_string<N> const &item, std::string &oStr)
+        {
+            quote_str(item.c_str(), oStr);
+            oStr += ' ';
+        }
+    };
+    template<size_t N>
+    struct value_ops<fixed_string<N>, false>
+    {
+        inline static void hash(fixed_string<N> const &item, unsigned long long &h)
+        {
+            h = hash_bytes(item.data(), item.size(), h);
+        }
+        inline static bool equals(fixed_string<N> const &a, fixed_string<N> const &b) { return a == b; }
+        inline static int compare(fixed_string<N> const &a, fixed_string<N> const &b) { return a.compare(b); }
+    };
+
+    /* T[N] and std::array<T, N> members are not collections: the wire has 
+       no count, just the N elements, copied as one block when T is bitwise. 
+       The text form is that of a collection, and JSON an array of exactly N. */
+    template<typename T, size_t N, bool Bitwise>
+    struct array_marshal
+    {
+        typedef marshal<T, has_member_info<T>::value> element;
+        inline static void output(T const *items, stream &oStr)
+        {
+            for (size_t i = 0; i != N; ++i)
+            {
+                element::output(items[i], oStr);
+            }
+        }
+        inline static void input(T *items, stream &iStr)
+        {
+            for (size_t i = 0; i != N; ++i)
+            {
+                element::input(items[i], iStr);
+            }
+        }
+    };
+    template<typename T, size_t N>
+    struct array_marshal<T, N, true>
+    {
+        inline static void output(T const *items, stream &oStr) { write_scalars(items, N, oStr); }
+        inline static void input(T *items, stream &iStr) { read_scalars(items, N, iStr); }
+    };
+
+    template<typename T, size_t N>
+    struct array_convert
+    {
+        typedef convert<T, has_member_info<T>::value> element;
+        inline static void to_string(T const *items, std::string &oStr)
+        {
+            oStr = "{ ";
+            for (size_t i = 0; i != N; ++i)
+            {
+                std::string tmp;
+                element::to_string(items[i], tmp);
+                oStr += tmp;
+            }
+            oStr += "} ";
+        }
+        inline static char const *from_string(T *items, char const *str)
+        {
+            while (*str && isspace(*str))
+            {
+                ++str;
+            }
+            if (*str != '{')
+            {
+                throw std::runtime_error("missing brace in array from_string()");
+            }
+            ++str;
+            for (size_t i = 0; i != N; ++i)
+            {
+                while (*str && isspace(*str))
+                {
+                    ++str;
+                }
+                if (!*str)
+                {
+                    throw std::runtime_error("underflow in array from_string()");
+                }
+                str = element::from_string(items[i], str);
+            }
+            while (*str && isspace(*str))
+            {
+                ++str;
+            }
+            if (*str != '}')
+            {
+                throw std::runtime_error("missing end brace in array from_string()");
+            }
+            return str + 1;
+        }
+    };
+
+    template<typename T, size_t N>
+    struct array_json
+    {
+        typedef json_convert<T, has_member_info<T>::value> element;
+        inline static void write(T const *items, json_writer &w)
+        {
+            w.begin_array();
+            for (size_t i = 0; i != N; ++i)
+            {
+                element::write(items[i], w);
+            }
+            w.end_array();
+        }
+        inline static void read(T *items, json_reader &r)
+        {
+            r.begin_array();
+            bool first = true;
+            for (size_t i = 0; i != N; ++i)
+            {
+                if (!r.next_element(first))
+                {
+                    throw std::runtime_error("JSON: too few elements for array");
+                }
+                element::read(items[i], r);
+            }
+            if (r.next_element(first))
+            {
+                throw std::runtime_error("JSON: too many elements for array");
+            }
+        }
+    };
+
+    template<typename T, size_t N, bool Bitwise>
+    struct array_ops
+    {
+        typedef value_ops<T, has_member_info<T>::value> element;
+        inline static void hash(T const *items, unsigned long long &h)
+        {
+            for (size_t i = 0; i != N; ++i)
+            {
+                element::hash(items[i], h);
+            }
+        }
+        inline static bool equals(T const *a, T const *b)
+        {
+            for (size_t i = 0; i != N; ++i)
+            {
+                if (!element::equals(a[i], b[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        inline static int compare(T const *a, T const *b)
+        {
+            for (size_t i = 0; i != N; ++i)
+            {
+                if (int c = element::compare(a[i], b[i]))
+                {
+                    return c;
+                }
+            }
+            return 0;
+        }
+    };
+    template<typename T, size_t N>
+    struct array_ops<T, N, true> : array_ops<T, N, false>
+    {
+        inline static void hash(T const *items, unsigned long long &h) { h = hash_bytes(items, N * sizeof(T), h); }
+        inline static bool equals(T const *a, T const *b) { return !memcmp(a, b, N * sizeof(T)); }
+    };
+
+    template<typename T, size_t N>
+    struct marshal<T[N], false>
+    {
+        typedef array_marshal<T, N, is_bitwise<T>::value != 0> impl;
+        inline static void output(T const (&item)[N], stream &oStr) { impl::output(item, oStr); }
+        inline static void input(T (&item)[N], stream &iStr) { impl::input(item, iStr); }
+    };
+    template<typename T, size_t N>
+    struct marshal<std::array<T, N>, false>
+    {
+        typedef array_marshal<T, N, is_bitwise<T>::value != 0> impl;
+        inline static void output(std::array<T, N> const &item, stream &oStr) { impl::output(item.data(), oStr); }
+        inline static void input(std::array<T, N> &item, stream &iStr) { impl::input(item.data(), iStr); }
+    };
+    template<typename T, size_t N>
+    struct convert<T[N], false>
+    {
+        inline static void to_string(T const (&item)[N], std::string &oStr) { array_convert<T, N>::to_string(item, oStr); }
+        inline static char const *from_string(T (&item)[N], char const *str) { return array_convert<T, N>::from_string(item, str); }
+    };
+    template<typename T, size_t N>
+    struct convert<std::array<T, N>, false>
+    {
+        inline static void to_string(std::array<T, N> const &item, std::string &oStr)
+        {
+            array_convert<T, N>::to_string(item.data(), oStr);
+        }
+        inline static char const *from_string(std::array<T, N> &item, char const *str)
+        {
+            return array_convert<T, N>::from_string(item.data(), str);
+        }
+    };
+    template<typename T, size_t N>
+    struct json_convert<T[N], false>
+    {
+        inline static void write(T const (&item)[N], json_writer &w) { array_json<T, N>::write(item, w); }
+        inline static void read(T (&item)[N], json_reader &r) { array_json<T, N>::read(item, r); }
+    };
+    template<typename T, size_t N>
+    struct json_convert<std::array<T, N>, false>
+    {
+        inline static void write(std::array<T, N> const &item, json_writer &w) { array_json<T, N>::write(item.data(), w); }
+        inline static void read(std::array<T, N> &item, json_reader &r) { array_json<T, N>::read(item.data(), r); }
+    };
+    template<typename T, size_t N>
+    struct value_ops<T[N], false>
+    {
+        typedef array_ops<T, N, is_bitwise<T>::value != 0> impl;
+        inline static void hash(T const (&item)[N], unsigned long long &h) { impl::hash(item, h); }
+        inline static bool equals(T const (&a)[N], T const (&b)[N]) { return impl::equals(a, b); }
+        inline static int compare(T const (&a)[N], T const (&b)[N]) { return impl::compare(a, b); }
+    };
+    template<typename T, size_t N>
+    struct value_ops<std::array<T, N>, false>
+    {
+        typedef array_ops<T, N, is_bitwise<T>::value != 0> impl;
+        inline static void hash(std::array<T, N> const &item, unsigned long long &h) { impl::hash(item.data(), h); }
+        inline static bool equals(std::array<T, N> const &a, std::array<T, N> const &b)
+        {
+            return impl::equals(a.data(), b.data());
+        }
+        inline static int compare(std::array<T, N> const &a, std::array<T, N> const &b)
+        {
+            return impl::compare(a.data(), b.data());
+        }
+    };
+
+    /* Building blocks for the straight-line codecs written by the codegen 
+       tool. Overloads pick the marshaling for each member by its type, so 
+       the generated code only needs member names. The output is byte for 
+       byte the same as the interpreted path. */
+    namespace gen
+    {
+        template<typename T> inline void put(T const &v, stream &oStr);
+        template<typename T> inline void put(std::list<T> const &v, stream &oStr);
+        template<typename T> inline void put(std::vector<T> const &v, stream &oStr);
+        template<typename T> inline void put(std::set<T> const &v, stream &oStr);
+        template<typename T> inline void put(std::deque<T> const &v, stream &oStr);
+        template<typename T> inline void put(std::multiset<T> const &v, stream &oStr);
+        template<typename K, typename V> inline void put(std::map<K, V> const &v, stream &oStr);
+        template<typename K, typename V> inline void put(std::unordered_map<K, V> const &v, stream &oStr);
+        template<typename K, typename V> inline void put(std::pair<K, V> const &v, stream &oStr);
+        template<typename T> inline void get(T &v, stream &iStr);
+        template<typename T> inline void get(std::list<T> &v, stream &iStr);
+        template<typename T> inline void get(std::vector<T> &v, stream &iStr);
+        template<typename T> inline void get(std::set<T> &v, stream &iStr);
+        template<typename T> inline void get(std::deque<T> &v, stream &iStr);
+        template<typename T> inline void get(std::multiset<T> &v, stream &iStr);
+        template<typename K, typename V> inline void get(std::map<K, V> &v, stream &iStr);
+        template<typename K, typename V> inline void get(std::unordered_map<K, V> &v, stream &iStr);
+        template<typename K, typename V> inline void get(std::pair<K, V> &v, stream &iStr);
+        template<typename T> inline void text(T const &v, std::string &oStr);
+        inline void text(std::string const &v, std::string &oStr);
+        template<typename T> inline void text(std::list<T> const &v, std::string &oStr);
+        template<typename T> inline void text(std::vector<T> const &v, std::string &oStr);
+        template<typename T> inline void text(std::set<T> const &v, std::string &oStr);
+        template<typename T> inline void text(std::deque<T> const &v, std::string &oStr);
+        template<typename T> inline void text(std::multiset<T> const &v, std::string &oStr);
+        template<typename K, typename V> inline void text(std::map<K, V> const &v, std::string &oStr);
+        template<typename K, typename V> inline void text(std::unordered_map<K, V> const &v, std::string &oStr);
+        template<typename K, typename V> inline void text(std::pair<K, V> const &v, std::string &oStr);
+
+        template<typename T> inline void put(T const &v, stream &oStr)
+        {
+            marshal<T, has_member_info<T>::value>::output(v, oStr);
+        }
+        template<typename Coll> inline void put_elements(Coll const &c, stream &oStr)
+        {
+            unsigned int cnt = (unsigned int)c.size();
+            marshal<unsigned int, false>::output(cnt, oStr);
+            for (typename Coll::const_iterator ptr(c.begin()), end(c.end()); ptr != end; ++ptr)
+            {
+                put(*ptr, oStr);
+            }
+        }
+        template<typename T> inline void put(std::list<T> const &v, stream &oStr) { put_elements(v, oStr); }
+        template<typename T> inline void put(std::set<T> const &v, stream &oStr) { put_elements(v, oStr); }
+        template<typename T> inline void put(std::deque<T> const &v, stream &oStr) { put_elements(v, oStr); }
+        template<typename T> inline void put(std::multiset<T> const &v, stream &oStr) { put_elements(v, oStr); }
+        template<typename K, typename V> inline void put(std::map<K, V> const &v, stream &oStr) { put_elements(v, oStr); }
+        template<typename K, typename V> inline void put(std::unordered_map<K, V> const &v, stream &oStr) { put_elements(v, oStr); }
+        template<typename K, typename V> inline void put(std::pair<K, V> const &v, stream &oStr)
+        {
+            put(v.first, oStr);
+            put(v.second, oStr);
+        }
+
+        template<typename T> inline void get(T &v, stream &iStr)
+        {
+            marshal<T, has_member_info<T>::value>::input(v, iStr);
+        }
+        /* like collection_t::read_elements, decode over what's there */
+        template<typename Coll> inline void get_elements(Coll &c, stream &iStr)
+        {
+            unsigned int cnt = 0;
+            marshal<unsigned int, false>::input(cnt, iStr);
+            typename Coll::iterator ptr(c.begin()), end(c.end());
+            unsigned int i = 0;
+            for (; i != cnt && ptr != end; ++i, ++ptr)
+            {
+                get(*ptr, iStr);
+            }
+            if (ptr != end)
+            {
+                c.erase(ptr, end);
+            }
+            for (; i != cnt; ++i)
+            {
+                c.push_back(typename Coll::value_type());
+                get(c.back(), iStr);
+            }
+        }
+        template<typename T> inline void get(std::list<T> &v, stream &iStr) { get_elements(v, iStr); }
+        /* like collection_t::read_vector and write_vector */
+        template<typename T, bool Bitwise>
+        struct vector_codec
+        {
+            static inline void put(std::vector<T> const &v, stream &oStr) { put_elements(v, oStr); }
+            static inline void get(std::vector<T> &v, stream &iStr) { get_elements(v, iStr); }
+        };
+        template<typename T>
+        struct vector_codec<T, true>
+        {
+            static inline void put(std::vector<T> const &v, stream &oStr)
+            {
+                unsigned int cnt = (unsigned int)v.size();
+                marshal<unsigned int, false>::output(cnt, oStr);
+                if (cnt)
+                {
+                    write_scalars(&v[0], cnt, oStr);
+                }
+            }
+            static inline void get(std::vector<T> &v, stream &iStr)
+            {
+                unsigned int cnt = 0;
+                marshal<unsigned int, false>::input(cnt, iStr);
+                if (cnt > iStr.bytes_left() / sizeof(T))
+                {
+                    throw std::runtime_error("underflow in vector get()");
+                }
+                v.resize(cnt);
+                if (cnt)
+                {
+                    read_scalars(&v[0], cnt, iStr);
+                }
+            }
+        };
+        template<typename T> inline void put(std::vector<T> const &v, stream &oStr)
+        {
+            vector_codec<T, is_bitwise<T>::value != 0>::put(v, oStr);
+        }
+        template<typename T> inline void get(std::vector<T> &v, stream &iStr)
+        {
+            vector_codec<T, is_bitwise<T>::value != 0>::get(v, iStr);
+        }
+        template<typename T> inline void get(std::deque<T> &v, stream &iStr) { get_elements(v, iStr); }
+        /* like collection_t::read_entries */
+        template<typename Coll> inline void reserve_entries(Coll &c, size_t cnt) {}
+        template<typename K, typename V> inline void reserve_entries(std::unordered_map<K, V> &c, size_t cnt) { c.reserve(cnt); }
+        template<typename Coll> inline void get_entries(Coll &c, stream &iStr)
+        {
+            unsigned int cnt = 0;
+            marshal<unsigned int, false>::input(cnt, iStr);
+            c.clear();
+            reserve_entries(c, cnt < iStr.bytes_left() ? cnt : iStr.bytes_left());
+            for (unsigned int i = 0; i != cnt; ++i)
+            {
+                typename collection_entry<Coll>::type tmp;
+                get(tmp, iStr);
+                c.emplace_hint(c.end(), std::move(tmp));
+            }
+        }
+        template<typename T> inline void get(std::set<T> &v, stream &iStr) { get_entries(v, iStr); }
+        template<typename T> inline void get(std::multiset<T> &v, stream &iStr) { get_entries(v, iStr); }
+        template<typename K, typename V> inline void get(std::map<K, V> &v, stream &iStr) { get_entries(v, iStr); }
+        template<typename K, typename V> inline void get(std::unordered_map<K, V> &v, stream &iStr) { get_entries(v, iStr); }
+        template<typename K, typename V> inline void get(std::pair<K, V> &v, stream &iStr)
+        {
+            get(v.first, iStr);
+            get(v.second, iStr);
+        }
+
+        template<typename T> inline void text(T const &v, std::string &oStr)
+        {
+            std::string tmp;
+            convert<T, has_member_info<T>::value>::to_string(v, tmp);
+            oStr += tmp;
+        }
+        inline void text(std::string const &v, std::string &oStr)
+        {
+            quote_str(v.c_str(), oStr);
+            oStr += " ";
+        }
+        template<typename Coll> inline void text_elements(Coll const &c, std::string &oStr)
+        {
+            oStr += "{ ";
+            for (typename Coll::const_iterator ptr(c.begin()), end(c.end()); ptr != end; ++ptr)
+            {
+                text(*ptr, oStr);
+            }
+            oStr += "} ";
+        }
+        template<typename T> inline void text(std::list<T> const &v, std::string &oStr) { text_elements(v, oStr); }
+        template<typename T> inline void text(std::vector<T> const &v, std::string &oStr) { text_elements(v, oStr); }
+        template<typename T> inline void text(std::set<T> const &v, std::string &oStr) { text_elements(v, oStr); }
+        template<typename T> inline void text(std::deque<T> const &v, std::string &oStr) { text_elements(v, oStr); }
+        template<typename T> inline void text(std::multiset<T> const &v, std::string &oStr) { text_elements(v, oStr); }
+        template<typename K, typename V> inline void text(std::map<K, V> const &v, std::string &oStr) { text_elements(v, oStr); }
+        template<typename K, typename V> inline void text(std::unordered_map<K, V> const &v, std::string &oStr) { text_elements(v, oStr); }
+        template<typename K, typename V> inline void text(std::pair<K, V> const &v, std::string &oStr)
+        {
+            oStr += "[ ";
+            text(v.first, oStr);
+            text(v.second, oStr);
+            oStr += "] ";
+        }
+    }
+
+    /* used by macros declaring PDUs for the protocol */
+    template<typename Pdu>
+    inline protocol_t &protocol_t::add_pdu()
+    {
+        int c = add_pdu(&Pdu::member_info());
+        if (pdu_code_slot<Pdu>::protocol_ == 0 || pdu_code_slot<Pdu>::protocol_ == id_)
+        {
+            pdu_code_slot<Pdu>::protocol_ = id_;
+            pdu_code_slot<Pdu>::code_ = c;
+        }
+        return *this;
+    }
+
+    /* code for a given PDU */
+    template<typename Pdu>
+    inline int protocol_t::code() const
+    {
+        if (pdu_code_slot<Pdu>::protocol_ == id_)
+        {
+            int c = pdu_code_slot<Pdu>::code_;
+            if ((size_t)c < by_id_.size() && by_id_[c] == &Pdu::member_info())
+            {
+                return c;
+            }
+        }
+        std::map<type_info_base const *, int>::const_iterator ptr(by_type_.find(&Pdu::member_info()));
+        if (ptr == by_type_.end())
+        {
+            throw std::runtime_error("could not find code for type - is it registered?");
+        }
+        return (*ptr).second;
+    }
+
+    /* type for a given PDU code */
+    inline type_info_base const &protocol_t::type(int code)
+    {
+        if (code <= 0 || (size_t)code >= by_id_.size())
+        {
+            throw std::runtime_error("could not find type for code - is it registered?");
+        }
+        return *by_id_[code];
+    }
+
+    template<typename Pdu>
+    void protocol_t::encode(Pdu const &t, stream &s)
+    {
+        int c = code<Pdu>();
+#if !defined(INTROSPECTION_NO_STATS)
+        pdu_stats_collector *st = stats_;
+        size_t start = st ? s.position() : 0;
+#endif
+        marshal<int, false>::output(c, s);
+        type_info_base const &ti = Pdu::member_info();
+        if (generated_codec_t const *gc = ti.generated())
+        {
+            (*gc->encode)(&t, s);
+        }
+        else
+        {
+            ti.access().get_from(&t, s);
+        }
+#if !defined(INTROSPECTION_NO_STATS)
+        if (st)
+        {
+            count_encode(st, c, s.position() - start);
+        }
+#endif
+    }
+
+    template<typename Pdu>
+    void protocol_t::encode_indexed(Pdu const &t, stream &s)
+    {
+        int c = code<Pdu>();
+#if !defined(INTROSPECTION_NO_STATS)
+        pdu_stats_collector *st = stats_;
+        size_t start = st ? s.position() : 0;
+#endif
+        marshal<int, false>::output(c, s);
+        write_indexed(Pdu::member_info(), &t, s);
+#if !defined(INTROSPECTION_NO_STATS)
+        if (st)
+        {
+            count_encode(st, c, s.position() - start);
+        }
+#endif
+    }
+
+    inline int protocol_t::decode(void *dst, size_t max_size, stream &s)
+    {
+#if !defined(INTROSPECTION_NO_STATS)
+        if (pdu_stats_collector *st = stats_)
+        {
+            return decode_counted(st, dst, max_size, s);
+        }
+#endif
+        int c;
+        marshal<int, false>::input(c, s);
+        type_info_base const &t = type(c);
+        if (t.access().size() > max_size)
+        {
+            throw std::runtime_error("not enough space for type in decode()");
+        }
+        t.access().create(dst);
+        try
+        {
+            put_body(t, c, dst, s);
+        }
+        catch (...)
+        {
+            t.access().destroy(dst);
+            throw;
         }
-        t.access().create(dst);
-        t.access().put_to(dst, s);
         return c;
     }
 
@@ -0,0 +1,580 @@
+
+#include <introspection/introspection.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+namespace introspection
+{
+
+json_writer::json_writer(std::string &oStr) :
+    str_(&oStr),
+    strm_(0),
+    first_(true),
+    pos_(0)
+{
+}
+
+json_writer::json_writer(stream &oStr) :
+    str_(0),
+    strm_(&oStr),
+    first_(true),
+    pos_(0)
+{
+}
+
+json_writer::~json_writer()
+{
+    flush();
+}
+
+void json_writer::flush()
+{
+    if (pos_ == 0)
+    {
+        return;
+    }
+    if (str_)
+    {
+        str_->append(buf_, pos_);
+    }
+    else
+    {
+        strm_->write_bytes(pos_, buf_);
+    }
+    pos_ = 0;
+}
+
+void json_writer::put(char const *data, size_t size)
+{
+    if (size > sizeof(buf_) - pos_)
+    {
+        flush();
+        if (size > sizeof(buf_))
+        {
+            if (str_)
+            {
+                str_->append(data, size);
+            }
+            else
+            {
+                strm_->write_bytes(size, data);
+            }
+            return;
+        }
+    }
+    memcpy(&buf_[pos_], data, size);
+    pos_ += size;
+}
+
+void json_writer::begin_object()
+{
+    separate();
+    put('{');
+    first_ = true;
+}
+
+void json_writer::end_object()
+{
+    put('}');
+    first_ = false;
+}
+
+void json_writer::begin_array()
+{
+    separate();
+    put('[');
+    first_ = true;
+}
+
+void json_writer::end_array()
+{
+    put(']');
+    first_ = false;
+}
+
+void json_writer::key(char const *name)
+{
+    separate();
+    put('"');
+    put(name, strlen(name));
+    put('"');
+    put(':');
+    //  the value that follows doesn't get a comma
+    first_ = true;
+}
+
+void json_writer::value(long long v)
+{
+    separate();
+    char tmp[24];
+    char *end = tmp + sizeof(tmp);
+    char *ptr = end;
+    //  negate as unsigned, so the most negative value works
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    do
+    {
+        *--ptr = (char)('0' + u % 10);
+        u /= 10;
+    }
+    while (u);
+    if (v < 0)
+    {
+        *--ptr = '-';
+    }
+    put(ptr, end - ptr);
+}
+
+void json_writer::value(unsigned long long v)
+{
+    separate();
+    char tmp[24];
+    char *end = tmp + sizeof(tmp);
+    char *ptr = end;
+    do
+    {
+        *--ptr = (char)('0' + v % 10);
+        v /= 10;
+    }
+    while (v);
+    put(ptr, end - ptr);
+}
+
+void json_writer::value(double v)
+{
+    separate();
+    //  JSON has no NaN or infinity
+    if (v != v || v - v != 0)
+    {
+        put("null", 4);
+        return;
+    }
+    char tmp[32];
+    int n = sprintf(tmp, "%.17g", v);
+    put(tmp, n);
+}
+
+void json_writer::value(float v)
+{
+    separate();
+    if (v != v || v - v != 0)
+    {
+        put("null", 4);
+        return;
+    }
+    char tmp[32];
+    int n = sprintf(tmp, "%.9g", (double)v);
+    put(tmp, n);
+}
+
+void json_writer::value(bool v)
+{
+    separate();
+    if (v)
+    {
+        put("true", 4);
+    }
+    else
+    {
+        put("false", 5);
+    }
+}
+
+void json_writer::string(char const *str, size_t len)
+{
+    static char const hex[] = "0123456789abcdef";
+    separate();
+    put('"');
+    char const *run = str;
+    char const *end = str + len;
+    for (char const *ptr = str; ptr != end; ++ptr)
+    {
+        unsigned char ch = (unsigned char)*ptr;
+        if (ch >= 0x20 && ch != '"' && ch != '\\')
+        {
+            continue;
+        }
+        put(run, ptr - run);
+        run = ptr + 1;
+        put('\\');
+        switch (ch)
+        {
+            case '"': put('"'); break;
+            case '\\': put('\\'); break;
+            case '\n': put('n'); break;
+            case '\r': put('r'); break;
+            case '\t': put('t'); break;
+            case '\b': put('b'); break;
+            case '\f': put('f'); break;
+            default:
+                put("u00", 3);
+                put(hex[ch >> 4]);
+                put(hex[ch & 15]);
+                break;
+        }
+    }
+    put(run, end - run);
+    put('"');
+}
+
+
+json_reader::json_reader(char *data, size_t size) :
+    pos_(data),
+    end_(data + size),
+    begin_(data),
+    depth_(0)
+{
+}
+
+void json_reader::fail(char const *what)
+{
+    char tmp[64];
+    sprintf(tmp, " at offset %lu", (unsigned long)(pos_ - begin_));
+    throw std::runtime_error(std::string("JSON: ") + what + tmp);
+}
+
+void json_reader::expect(char ch)
+{
+    if (peek() != ch)
+    {
+        char tmp[] = "expected ' '";
+        tmp[10] = ch;
+        fail(tmp);
+    }
+    ++pos_;
+}
+
+bool json_reader::literal(char const *word)
+{
+    size_t len = strlen(word);
+    if ((size_t)(end_ - pos_) < len || memcmp(pos_, word, len))
+    {
+        return false;
+    }
+    pos_ += len;
+    return true;
+}
+
+void json_reader::enter()
+{
+    if (++depth_ > JSON_MAX_DEPTH)
+    {
+        fail("nested too deeply");
+    }
+}
+
+void json_reader::begin_object()
+{
+    expect('{');
+    enter();
+}
+
+bool json_reader::next_key(bool &first, char const *&name, size_t &len)
+{
+    if (peek() == '}')
+    {
+        ++pos_;
+        --depth_;
+        return false;
+    }
+    if (!first)
+    {
+        expect(',');
+    }
+    first = false;
+    read_string(name, len);
+    expect(':');
+    return true;
+}
+
+void json_reader::begin_array()
+{
+    expect('[');
+    enter();
+}
+
+bool json_reader::next_element(bool &first)
+{
+    if (peek() == ']')
+    {
+        ++pos_;
+        --depth_;
+        return false;
+    }
+    if (!first)
+    {
+        expect(',');
+    }
+    first = false;
+    return true;
+}
+
+unsigned long long json_reader::read_uint()
+{
+    skip_ws();
+    if (pos_ == end_ || *pos_ < '0' || *pos_ > '9')
+    {
+        fail("expected an unsigned number");
+    }
+    unsigned long long v = 0;
+    while (pos_ != end_ && *pos_ >= '0' && *pos_ <= '9')
+    {
+        unsigned long long n = v * 10 + (*pos_ - '0');
+        if (n / 10 != v)
+        {
+            fail("number out of range");
+        }
+        v = n;
+        ++pos_;
+    }
+    if (pos_ != end_ && (*pos_ == '.' || *pos_ == 'e' || *pos_ == 'E'))
+    {
+        fail("expected an integer");
+    }
+    return v;
+}
+
+long long json_reader::read_int()
+{
+    bool neg = (peek() == '-');
+    if (neg)
+    {
+        ++pos_;
+    }
+    unsigned long long u = read_uint();
+    if (u > (neg ? 0x8000000000000000ULL : 0x7fffffffffffffffULL))
+    {
+        fail("number out of range");
+    }
+    return neg ? (long long)(0ULL - u) : (long long)u;
+}
+
+double json_reader::read_double()
+{
+    skip_ws();
+    if (literal("null"))
+    {
+        //  what value(double) writes for NaN
+        return strtod("nan", 0);
+    }
+    //  the buffer isn't terminated, so strtod() works on a copy, which 
+    //  is on the stack unless the number is very long
+    char const *start = pos_;
+    while (pos_ != end_ && *pos_ && strchr("0123456789+-.eE", *pos_))
+    {
+        ++pos_;
+    }
+    size_t n = pos_ - start;
+    char tmp[64];
+    std::string big;
+    char *num = tmp;
+    if (n >= sizeof(tmp))
+    {
+        big.assign(start, n);
+        num = &big[0];
+    }
+    else
+    {
+        memcpy(tmp, start, n);
+        tmp[n] = 0;
+    }
+    char *end = 0;
+    double v = strtod(num, &end);
+    if (n == 0 || end != num + n)
+    {
+        fail("expected a number");
+    }
+    return v;
+}
+
+bool json_reader::read_bool()
+{
+    skip_ws();
+    if (literal("true"))
+    {
+        return true;
+    }
+    if (literal("false"))
+    {
+        return false;
+    }
+    fail("expected true or false");
+    return false;
+}
+
+bool json_reader::read_null()
+{
+    skip_ws();
+    return literal("null");
+}
+
+static int json_hex(char ch)
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+void json_reader::read_string(char const *&str, size_t &len)
+{
+    expect('"');
+    str = pos_;
+    //  until the first escape, the string is used where it is
+    while (pos_ != end_ && *pos_ != '"' && *pos_ != '\\')
+    {
+        ++pos_;
+    }
+    char *out = pos_;
+    while (pos_ != end_ && *pos_ != '"')
+    {
+        char ch = *pos_++;
+        if ((unsigned char)ch < 0x20)
+        {
+            fail("control character in string");
+        }
+        if (ch != '\\')
+        {
+            *out++ = ch;
+            continue;
+        }
+        if (pos_ == end_)
+        {
+            break;
+        }
+        switch (*pos_++)
+        {
+            case '"': *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '/': *out++ = '/'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'u':
+            {
+                unsigned int cp = 0;
+                for (int i = 0; i != 4; ++i)
+                {
+                    int h = (pos_ == end_) ? -1 : json_hex(*pos_++);
+                    if (h < 0)
+                    {
+                        fail("bad \\u escape");
+                    }
+                    cp = (cp << 4) | h;
+                }
+                //  a surrogate pair is two escapes
+                if (cp >= 0xd800 && cp < 0xdc00 && end_ - pos_ >= 6 && pos_[0] == '\\' && pos_[1] == 'u')
+                {
+                    unsigned int lo = 0;
+                    for (int i = 2; i != 6; ++i)
+                    {
+                        int h = json_hex(pos_[i]);
+                        if (h < 0)
+                        {
+                            fail("bad \\u escape");
+                        }
+                        lo = (lo << 4) | h;
+                    }
+                    if (lo >= 0xdc00 && lo < 0xe000)
+                    {
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                        pos_ += 6;
+                    }
+                }
+                //  UTF-8 is never longer than the escape it replaces
+                if (cp < 0x80)
+                {
+                    *out++ = (char)cp;
+                }
+                else if (cp < 0x800)
+                {
+                    *out++ = (char)(0xc0 | (cp >> 6));
+                    *out++ = (char)(0x80 | (cp & 0x3f));
+                }
+                else if (cp < 0x10000)
+                {
+                    *out++ = (char)(0xe0 | (cp >> 12));
+                    *out++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+                    *out++ = (char)(0x80 | (cp & 0x3f));
+                }
+                else
+                {
+                    *out++ = (char)(0xf0 | (cp >> 18));
+                    *out++ = (char)(0x80 | ((cp >> 12) & 0x3f));
+                    *out++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+                    *out++ = (char)(0x80 | (cp & 0x3f));
+                }
+                break;
+            }
+            default:
+                fail("bad escape in string");
+        }
+    }
+    if (pos_ == end_)
+    {
+        fail("unterminated string");
+    }
+    ++pos_;
+    len = out - str;
+}
+
+void json_reader::read_string(std::string &str)
+{
+    char const *ptr;
+    size_t len;
+    read_string(ptr, len);
+    str.assign(ptr, len);
+}
+
+void json_reader::skip_value()
+{
+    bool first = true;
+    char const *name;
+    size_t len;
+    switch (peek())
+    {
+        case '{':
+            begin_object();
+            while (next_key(first, name, len))
+            {
+                skip_value();
+            }
+            break;
+        case '[':
+            begin_array();
+            while (next_element(first))
+            {
+                skip_value();
+            }
+            break;
+        case '"':
+            read_string(name, len);
+            break;
+        case 't':
+        case 'f':
+            read_bool();
+            break;
+        case 'n':
+            if (!read_null())
+            {
+                fail("expected null");
+            }
+            break;
+        default:
+            read_double();
+            break;
+    }
+}
+
+void json_reader::finish()
+{
+    if (peek() != 0 || pos_ != end_)
+    {
+        fail("trailing data after the document");
+    }
+}
+
+}
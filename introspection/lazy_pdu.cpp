@@ -0,0 +1,132 @@
+
+#include <introspection/lazy_pdu.h>
+
+
+namespace introspection
+{
+
+//  offsets narrower than this body size fit in an unsigned short
+static size_t const narrow_body_limit = 65536;
+
+void write_indexed(type_info_base const &ti, void const *pdu, stream &oStr)
+{
+    size_t count = ti.end() - ti.begin();
+    std::vector<unsigned int> offsets;
+    offsets.reserve(count);
+    simple_stream body;
+    for (member_t::iterator ptr(ti.begin()), end(ti.end()); ptr != end; ++ptr)
+    {
+        offsets.push_back((unsigned int)body.position());
+        (*ptr).access().get_from(pdu, body);
+    }
+    size_t size = body.position();
+    if (size > INTROSPECTION_MAX_BLOCK_SIZE)
+    {
+        throw std::runtime_error("PDU too large in write_indexed()");
+    }
+    marshal<unsigned int, false>::output((unsigned int)size, oStr);
+    for (size_t i = 1; i < count; ++i)
+    {
+        if (size < narrow_body_limit)
+        {
+            marshal<unsigned short, false>::output((unsigned short)offsets[i], oStr);
+        }
+        else
+        {
+            marshal<unsigned int, false>::output(offsets[i], oStr);
+        }
+    }
+    oStr.write_bytes(size, body.unsafe_data());
+}
+
+indexed_layout::indexed_layout() :
+    body_(0),
+    table_(0),
+    body_size_(0),
+    count_(0),
+    wide_(false)
+{
+}
+
+size_t indexed_layout::offset(size_t index) const
+{
+    if (index == 0)
+    {
+        return 0;
+    }
+    if (index == count_)
+    {
+        return body_size_;
+    }
+    if (wide_)
+    {
+        unsigned int ui;
+        memcpy(&ui, table_ + (index - 1) * sizeof(ui), sizeof(ui));
+        wire_order<unsigned int>::swap(ui);
+        return ui;
+    }
+    unsigned short us;
+    memcpy(&us, table_ + (index - 1) * sizeof(us), sizeof(us));
+    wire_order<unsigned short>::swap(us);
+    return us;
+}
+
+size_t indexed_layout::parse(type_info_base const &ti, void const *data, size_t size)
+{
+    body_ = 0;
+    unsigned int bs = 0;
+    if (size < sizeof(bs))
+    {
+        throw std::runtime_error("underflow in indexed PDU header");
+    }
+    memcpy(&bs, data, sizeof(bs));
+    wire_order<unsigned int>::swap(bs);
+    count_ = ti.end() - ti.begin();
+    body_size_ = bs;
+    wide_ = (body_size_ >= narrow_body_limit);
+    table_ = (unsigned char const *)data + sizeof(bs);
+    size_t tableSize = (count_ ? count_ - 1 : 0) * (wide_ ? sizeof(unsigned int) : sizeof(unsigned short));
+    if (body_size_ > INTROSPECTION_MAX_BLOCK_SIZE || size - sizeof(bs) < tableSize ||
+        size - sizeof(bs) - tableSize < body_size_)
+    {
+        throw std::runtime_error("underflow in indexed PDU");
+    }
+    //  checking the table once lets decode_member() trust it
+    for (size_t i = 0; i != count_; ++i)
+    {
+        if (offset(i) > offset(i + 1))
+        {
+            throw std::runtime_error("bad offset table in indexed PDU");
+        }
+    }
+    body_ = table_ + tableSize;
+    return sizeof(bs) + tableSize + body_size_;
+}
+
+void indexed_layout::decode_member(type_info_base const &ti, size_t index, void *obj) const
+{
+    if (!body_ || index >= count_)
+    {
+        throw std::logic_error("decode_member() without a parsed PDU");
+    }
+    size_t begin = offset(index);
+    size_t end = offset(index + 1);
+    readonly_stream rs(body_ + begin, end - begin);
+    ti.begin()[index].access().put_to(obj, rs);
+    if (rs.bytes_left() != 0)
+    {
+        throw std::runtime_error("member does not fill its slot in indexed PDU");
+    }
+}
+
+size_t indexed_layout::member_index(type_info_base const &ti, size_t offset)
+{
+    size_t ix = ti.member_at(offset);
+    if (ix == (size_t)(ti.end() - ti.begin()))
+    {
+        throw std::logic_error("lazy_pdu::get() of a member that is not introspected");
+    }
+    return ix;
+}
+
+}
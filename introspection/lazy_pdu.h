@@ -0,0 +1,100 @@
+
+#if !defined(introspection_lazy_pdu_h)
+#define introspection_lazy_pdu_h
+
+#include <introspection/introspection.h>
+
+/* The indexed wire layout, written by protocol_t::encode_indexed(), is
+
+     int code
+     unsigned int body size
+     offset of each member but the first, from the start of the body;
+       unsigned short each if the body is smaller than 64 kB, else
+       unsigned int
+     the body, exactly as encode() writes it
+
+   A lazy_pdu<T> is a view of such a message that decodes a member the first
+   time it's asked for, by seeking straight to it, so a server that routes
+   on one field never parses the rest of the message.
+   */
+
+namespace introspection
+{
+    /* the parsed header of an indexed PDU; the type independent half of lazy_pdu */
+    class indexed_layout
+    {
+        public:
+            indexed_layout();
+            /* data is what follows the code. Checks the table, and returns
+               the size of the whole thing (table and body). */
+            size_t parse(type_info_base const &ti, void const *data, size_t size);
+            /* decode member index of ti into obj; it must have been parsed */
+            void decode_member(type_info_base const &ti, size_t index, void *obj) const;
+            /* index of the member at the given offset in the struct, with 
+               the type's hash of offsets */
+            static size_t member_index(type_info_base const &ti, size_t offset);
+
+        private:
+            size_t offset(size_t index) const;
+            unsigned char const *body_;
+            unsigned char const *table_;
+            size_t body_size_;
+            size_t count_;
+            bool wide_;
+    };
+
+    template<typename T>
+    class lazy_pdu
+    {
+        public:
+            lazy_pdu()
+            {
+            }
+            /* Point the view at an indexed PDU, just past its code. The data
+               is not copied, and must stay valid while members are read.
+               Returns the number of bytes the PDU takes after the code. */
+            size_t reset(void const *data, size_t size)
+            {
+                decoded_.clear();
+                size_t used = layout_.parse(T::member_info(), data, size);
+                decoded_.resize(T::member_info().end() - T::member_info().begin(), 0);
+                return used;
+            }
+            /* the member, decoded on first access */
+            template<typename MemT>
+            MemT const &get(MemT T::*member)
+            {
+                size_t ix = indexed_layout::member_index(T::member_info(),
+                    (char const *)&(obj_.*member) - (char const *)&obj_);
+                decode(ix);
+                return obj_.*member;
+            }
+            /* decode whatever hasn't been yet, and return the whole PDU */
+            T const &get_all()
+            {
+                for (size_t i = 0; i != decoded_.size(); ++i)
+                {
+                    decode(i);
+                }
+                return obj_;
+            }
+            inline bool decoded(size_t index) const { return decoded_[index] != 0; }
+
+        private:
+            inline void decode(size_t ix)
+            {
+                if (!decoded_[ix])
+                {
+                    layout_.decode_member(T::member_info(), ix, &obj_);
+                    decoded_[ix] = 1;
+                }
+            }
+            lazy_pdu(lazy_pdu const &);
+            lazy_pdu &operator=(lazy_pdu const &);
+            T obj_;
+            indexed_layout layout_;
+            std::vector<unsigned char> decoded_;
+    };
+}
+
+#endif  //  introspection_lazy_pdu_h
@@ -0,0 +1,133 @@
+
+#if !defined(introspection_lockfree_h)
+#define introspection_lockfree_h
+
+/* Minimal set of atomic operations and thread-local storage, so that the
+   library can keep lock-free counters and lists without requiring a C++11
+   compiler. Visual Studio 2010 gets the Interlocked intrinsics; everyone
+   else gets the GCC __sync/__atomic builtins.
+   */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#pragma intrinsic(_InterlockedIncrement, _InterlockedExchangeAdd, _InterlockedCompareExchange, _ReadWriteBarrier, _mm_pause)
+#define INTROSPECTION_THREAD_LOCAL __declspec(thread)
+#else
+#define INTROSPECTION_THREAD_LOCAL __thread
+#endif
+
+namespace introspection
+{
+#if defined(_MSC_VER)
+    /* returns the new value */
+    inline long atomic_increment(long volatile *p)
+    {
+        return _InterlockedIncrement(p);
+    }
+    /* returns the new value */
+    inline long atomic_add(long volatile *p, long v)
+    {
+        return _InterlockedExchangeAdd(p, v) + v;
+    }
+    inline bool atomic_cas(long volatile *p, long expect, long value)
+    {
+        return _InterlockedCompareExchange(p, value, expect) == expect;
+    }
+    inline bool atomic_cas_ptr(void *volatile *p, void *expect, void *value)
+    {
+        return _InterlockedCompareExchangePointer(p, value, expect) == expect;
+    }
+    /* x86 loads are acquire and stores are release; just keep the compiler honest */
+    inline long atomic_load_acquire(long volatile const *p)
+    {
+        long v = *p;
+        _ReadWriteBarrier();
+        return v;
+    }
+    inline void atomic_store_release(long volatile *p, long v)
+    {
+        _ReadWriteBarrier();
+        *p = v;
+    }
+    inline void *atomic_load_ptr_acquire(void *volatile const *p)
+    {
+        void *v = *p;
+        _ReadWriteBarrier();
+        return v;
+    }
+    inline void atomic_store_ptr_release(void *volatile *p, void *v)
+    {
+        _ReadWriteBarrier();
+        *p = v;
+    }
+#else
+    inline long atomic_increment(long volatile *p)
+    {
+        return __sync_add_and_fetch(p, 1);
+    }
+    inline long atomic_add(long volatile *p, long v)
+    {
+        return __sync_add_and_fetch(p, v);
+    }
+    inline bool atomic_cas(long volatile *p, long expect, long value)
+    {
+        return __sync_bool_compare_and_swap(p, expect, value);
+    }
+    inline bool atomic_cas_ptr(void *volatile *p, void *expect, void *value)
+    {
+        return __sync_bool_compare_and_swap(p, expect, value);
+    }
+    inline long atomic_load_acquire(long volatile const *p)
+    {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+    inline void atomic_store_release(long volatile *p, long v)
+    {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+    inline void *atomic_load_ptr_acquire(void *volatile const *p)
+    {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+    inline void atomic_store_ptr_release(void *volatile *p, void *v)
+    {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+#endif
+
+    /* tell the CPU this is a spin-wait, so it goes easy on the core (and 
+       on a hyperthread sharing it) */
+    inline void cpu_pause()
+    {
+#if defined(_MSC_VER)
+        _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
+    /* A lock for short critical sections on data that's rarely contended: 
+       a word that's 0 when free. */
+    inline void spin_lock(long volatile *lock)
+    {
+        while (!atomic_cas(lock, 0, 1))
+        {
+            while (atomic_load_acquire(lock) != 0)
+            {
+                cpu_pause();
+            }
+        }
+    }
+    inline void spin_unlock(long volatile *lock)
+    {
+        atomic_store_release(lock, 0);
+    }
+
+    /* A small, process-unique number for the calling thread. Threads are
+       numbered from 1 in the order they first ask. */
+    long this_thread_serial();
+}
+
+#endif  //  introspection_lockfree_h
@@ -1,8 +1,23 @@
 
 #include "sample_chat.h"
+#include "protocol_stats.h"
+#include "codegen.h"
+#include "transcode.h"
+#include "lazy_pdu.h"
+#include "registry.h"
+#include "pool.h"
+#include "trace.h"
+#include "lockfree.h"
+#include "message_ring.h"
+#if defined(_MSC_VER)
+#include <process.h>
+#else
+#include "not_win32.h"
+#endif
 #include <assert.h>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 
 void test_basic_marshal()
 {
@@ -142,11 +157,1494 @@ void test_protocol()
     my_proto.destroy(i, buf);
 }
 
+void test_stats()
+{
+    assert(!strcmp(LoginPacket::member_info().name(), "LoginPacket"));
+    my_proto.enable_stats(true);
+
+    simple_stream ss;
+    LoginPacket lp;
+    lp.name = "My Name";
+    lp.password = "123qwe";
+    lp.version = 1;
+    my_proto.encode(lp, ss);
+    my_proto.encode(lp, ss);
+    size_t lpsize = ss.position() / 2;
+    int bogus = 9999;
+    ss.write_bytes(sizeof(bogus), &bogus);
+
+    dispatch_t d;
+    d.add_handler(my_proto, &my_handler, &MyHandler::OnLoginPacket);
+    ss.set_position(0);
+    char buf[1024];
+    for (int n = 0; n != 2; ++n)
+    {
+        int i = my_proto.decode(buf, sizeof(buf), ss);
+        d.dispatch(i, buf);
+        my_proto.destroy(i, buf);
+    }
+    bool threw = false;
+    try
+    {
+        my_proto.decode(buf, sizeof(buf), ss);
+    }
+    catch (std::exception const &)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    protocol_stats_t ps;
+    my_proto.stats_snapshot(ps);
+    assert(ps.protocol == "my_proto");
+    assert(ps.unknown_codes == 1);
+    pdu_stats_t const &lps = ps.pdus[my_proto.code<LoginPacket>() - 1];
+    assert(lps.name == "LoginPacket");
+    assert(lps.encodes == 2);
+    assert(lps.encode_bytes == 2 * lpsize);
+    assert(lps.decodes == 2);
+    assert(lps.decode_bytes == 2 * lpsize);
+    assert(lps.decode_failures == 0);
+    assert(lps.dispatches == 2);
+    unsigned long long timed = 0;
+    for (size_t i = 0; i != lps.handler_ns_log2.size(); ++i)
+    {
+        timed += lps.handler_ns_log2[i];
+    }
+    assert(timed == 2);
+
+    std::string ostr;
+    protocol_stats_t::member_info().access().to_text(&ps, ostr);
+    protocol_stats_t ps2;
+    protocol_stats_t::member_info().access().from_text(&ps2, ostr.c_str());
+    assert(ps2.pdus.size() == ps.pdus.size());
+    assert(ps2.pdus[my_proto.code<LoginPacket>() - 1].encode_bytes == lps.encode_bytes);
+
+    my_proto.enable_stats(false);
+    my_proto.stats_snapshot(ps);
+    assert(ps.pdus[0].encodes == 0);
+
+    //  the collector has room for the codes there were when it was made
+    protocol_t copy(my_proto);
+    copy.enable_stats(true);
+    threw = false;
+    try
+    {
+        copy.add_pdu<CountByReason>();
+    }
+    catch (std::logic_error const &)
+    {
+        threw = true;
+    }
+    assert(threw);
+    copy.enable_stats(false);
+    copy.add_pdu<CountByReason>();
+    assert(copy.pdu_count() == my_proto.pdu_count() + 1);
+}
+void test_decode_and_dispatch()
+{
+    simple_stream ss;
+    LoginPacket lp;
+    lp.name = "My Name";
+    lp.password = "123qwe";
+    lp.version = 1;
+    my_proto.encode(lp, ss);
+    UserLeftPacket ulp;
+    ulp.who = "nobody";
+    my_proto.encode(ulp, ss);
+
+    assert(my_proto.max_pdu_size() >= sizeof(UserInfo));
+    dispatch_t d;
+    d.add_handler(my_proto, &my_handler, &MyHandler::OnLoginPacket);
+    ss.set_position(0);
+    assert(d.decode_and_dispatch(my_proto, ss) == my_proto.code<LoginPacket>());
+    assert(my_handler.called_);
+    my_handler.called_ = false;
+
+    //  no handler for UserLeftPacket
+    bool threw = false;
+    try
+    {
+        d.decode_and_dispatch(my_proto, ss);
+    }
+    catch (std::exception const &)
+    {
+        threw = true;
+    }
+    assert(threw);
+    assert(ss.bytes_left() == 0);
+}
+
+class RecycleHandler
+{
+    public:
+        RecycleHandler() :
+            name_(0),
+            first_(0)
+        {
+        }
+        char const *name_;
+        std::string const *first_;
+        std::list<std::string> users_;
+        void OnLoginPacket(LoginPacket const &lp)
+        {
+            name_ = lp.name.data();
+        }
+        void OnConnectedPacket(ConnectedPacket const &cp)
+        {
+            first_ = &cp.users.front();
+            users_ = cp.users;
+        }
+};
+
+void test_recycle()
+{
+    simple_stream ss;
+    LoginPacket lp;
+    lp.name = "A user name that is too long for the small string buffer";
+    lp.password = "123qwe";
+    lp.version = 1;
+    ConnectedPacket cp;
+    cp.version = 1;
+    cp.result = 0;
+    cp.users.push_back("Administrator");
+    cp.users.push_back("Another User");
+    my_proto.encode(lp, ss);
+    my_proto.encode(cp, ss);
+    lp.name = "A shorter name, but still not a short string";
+    my_proto.encode(lp, ss);
+    cp.users.pop_back();
+    my_proto.encode(cp, ss);
+    cp.users.push_back("Third");
+    cp.users.push_back("Fourth");
+    my_proto.encode(cp, ss);
+
+    RecycleHandler rh;
+    dispatch_t d;
+    d.recycle_pdus(true);
+    d.add_handler(my_proto, &rh, &RecycleHandler::OnLoginPacket);
+    d.add_handler(my_proto, &rh, &RecycleHandler::OnConnectedPacket);
+    ss.set_position(0);
+
+    d.decode_and_dispatch(my_proto, ss);
+    char const *name = rh.name_;
+    d.decode_and_dispatch(my_proto, ss);
+    std::string const *first = rh.first_;
+    assert(rh.users_.size() == 2);
+
+    //  the second round decodes over the same instances and storage
+    d.decode_and_dispatch(my_proto, ss);
+    assert(rh.name_ == name);
+    d.decode_and_dispatch(my_proto, ss);
+    assert(rh.first_ == first);
+    assert(rh.users_.size() == 1);
+    assert(rh.users_.front() == "Administrator");
+    d.decode_and_dispatch(my_proto, ss);
+    assert(rh.first_ == first);
+    assert(rh.users_ == cp.users);
+    assert(ss.bytes_left() == 0);
+}
+
+template<typename T>
+void check_generated(T const &t)
+{
+    simple_stream gen, interp;
+    marshal<T, true>::output(t, gen);
+    marshal<T, true>::output_members(t, interp);
+    assert(gen.position() == interp.position());
+    assert(!memcmp(gen.unsafe_data(), interp.unsafe_data(), gen.position()));
+    std::string gtext, itext;
+    convert<T, true>::to_string(t, gtext);
+    convert<T, true>::to_string_members(t, itext);
+    assert(gtext == itext);
+    T back;
+    gen.set_position(0);
+    marshal<T, true>::input(back, gen);
+    std::string btext;
+    convert<T, true>::to_string_members(back, btext);
+    assert(btext == itext);
+}
+
+void test_codegen()
+{
+    std::string src;
+    generate_codecs(my_proto, "", src);
+    //  result and version are adjacent ints, so they go out in one piece
+    assert(src.find("s.write_bytes(8, &p.result);") != std::string::npos);
+    assert(src.find("case 7:") != std::string::npos);
+
+    //  a PDU added to a copy after the code was generated still decodes
+    {
+        protocol_t copy(my_proto);
+        copy.add_pdu<CountByReason>();
+        CountByReason cbr;
+        cbr.reason = "added later";
+        cbr.count = 17;
+        ConnectedPacket cp;
+        cp.version = 5;
+        simple_stream ss;
+        copy.encode(cbr, ss);
+        copy.encode(cp, ss);
+        ss.set_position(0);
+        char buf[1024];
+        int i = copy.decode(buf, sizeof(buf), ss);
+        assert(i == copy.code<CountByReason>());
+        assert(((CountByReason *)buf)->reason == cbr.reason && ((CountByReason *)buf)->count == 17);
+        copy.destroy(i, buf);
+        i = copy.decode(buf, sizeof(buf), ss);
+        assert(i == copy.code<ConnectedPacket>() && ((ConnectedPacket *)buf)->version == 5);
+        copy.destroy(i, buf);
+    }
+
+#if defined(INTROSPECTION_GENERATED_CODECS)
+    for (int code = 1; code <= my_proto.pdu_count(); ++code)
+    {
+        assert(my_proto.type(code).generated() != 0);
+    }
+    LoginPacket lp;
+    lp.version = 3;
+    lp.name = "Some \"quoted\" name";
+    lp.password = "";
+    check_generated(lp);
+    UserInfo ui;
+    ui.name = "Jon";
+    ui.email = "jon@watte.net";
+    ui.password = "qwerty";
+    ui.shoe_size = 42;
+    check_generated(ui);
+    ConnectedPacket cp;
+    cp.result = -1;
+    cp.version = 0x12345678;
+    check_generated(cp);
+    cp.users.push_back("one");
+    cp.users.push_back("two");
+    check_generated(cp);
+
+    //  and through the protocol, which decodes with the generated switch
+    simple_stream ss;
+    my_proto.encode(cp, ss);
+    ss.set_position(0);
+    char buf[1024];
+    int i = my_proto.decode(buf, sizeof(buf), ss);
+    assert(i == my_proto.code<ConnectedPacket>());
+    assert(((ConnectedPacket *)buf)->users == cp.users);
+    assert(((ConnectedPacket *)buf)->version == cp.version);
+    my_proto.destroy(i, buf);
+#endif
+}
+
+void test_codes()
+{
+    //  codes are assigned in registration order, starting at 1
+    assert(my_proto.code<LoginPacket>() == 1);
+    assert(my_proto.code<ConnectedPacket>() == 3);
+    assert(my_proto.code<UserLeftPacket>() == 7);
+    assert(my_proto.code<ServerStats>() == 9);
+    assert(!strcmp(my_proto.type(4).name(), "SaySomethingPacket"));
+
+    //  a type in a second protocol gets its own code there
+    protocol_t other(protocol_t("other") .add_pdu<UserLeftPacket>() .add_pdu<LoginPacket>());
+    assert(other.code<UserLeftPacket>() == 1);
+    assert(other.code<LoginPacket>() == 2);
+    assert(my_proto.code<LoginPacket>() == 1);
+
+    bool threw = false;
+    try
+    {
+        other.type(3);
+    }
+    catch (std::exception const &)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    //  what a copy adds is its own, though it shares the original's slots
+    {
+        protocol_t copy(my_proto);
+        copy.add_pdu<LoginPacket>();
+        copy.add_pdu<CountByReason>();
+        assert(copy.code<LoginPacket>() == 10);
+        assert(copy.code<CountByReason>() == 11);
+        assert(copy.code<ConnectedPacket>() == 3);
+        assert(my_proto.code<LoginPacket>() == 1);
+        threw = false;
+        try
+        {
+            my_proto.code<CountByReason>();
+        }
+        catch (std::exception const &)
+        {
+            threw = true;
+        }
+        assert(threw);
+    }
+}
+
+
+struct VectorPacket
+{
+    std::vector<int> ints;
+    std::vector<double> doubles;
+
+    INTROSPECTION(VectorPacket, \
+        MEMBER(ints, "ints") \
+        MEMBER(doubles, "doubles") \
+        );
+};
+
+void test_json()
+{
+    UserInfo ui;
+    ui.name = "Jon \"J\" Watte";
+    ui.email = "jon@example.com";
+    ui.password = "a\\b\n";
+    ui.shoe_size = 44;
+    std::string str;
+    to_json(ui, str);
+    assert(str == "{\"name\":\"Jon \\\"J\\\" Watte\",\"email\":\"jon@example.com\","
+        "\"password\":\"a\\\\b\\n\",\"shoe_size\":44}");
+
+    UserInfo ui2;
+    from_json(ui2, str);
+    assert(ui2.name == ui.name);
+    assert(ui2.email == ui.email);
+    assert(ui2.password == ui.password);
+    assert(ui2.shoe_size == 44);
+
+    //  any key order, unknown keys are skipped, missing keys are left alone
+    from_json(ui2, std::string(" { \"shoe_size\" : -3, \"extra\": {\"a\": [1, 2.5e3, null, true]},"
+        " \"name\": \"\\u00e5\\ud83d\\ude00\" } "));
+    assert(ui2.shoe_size == -3);
+    assert(ui2.name == "\xc3\xa5\xf0\x9f\x98\x80");
+    assert(ui2.email == ui.email);
+
+    ConnectedPacket cp;
+    cp.result = 0;
+    cp.version = 2;
+    cp.users.push_back("Administrator");
+    cp.users.push_back("User 1");
+    to_json(cp, str);
+    assert(str == "{\"result\":0,\"version\":2,\"users\":[\"Administrator\",\"User 1\"]}");
+    ConnectedPacket cp2;
+    cp2.users.push_back("stale");
+    from_json(cp2, str);
+    assert(cp2.version == 2);
+    assert(cp2.users == cp.users);
+
+    //  nested structs, and vectors of them
+    protocol_stats_t ps;
+    ps.protocol = "p";
+    ps.unknown_codes = 18446744073709551615ULL;
+    ps.pdus.resize(1);
+    ps.pdus[0].code = 1;
+    ps.pdus[0].name = "LoginPacket";
+    ps.pdus[0].encodes = 2;
+    ps.pdus[0].encode_bytes = 3;
+    ps.pdus[0].decodes = 4;
+    ps.pdus[0].decode_bytes = 5;
+    ps.pdus[0].decode_failures = 6;
+    ps.pdus[0].dispatches = 7;
+    ps.pdus[0].handler_ns_log2.push_back(8);
+    to_json(ps, str);
+    protocol_stats_t ps2;
+    from_json(ps2, str);
+    assert(ps2.unknown_codes == ps.unknown_codes);
+    assert(ps2.pdus.size() == 1);
+    assert(ps2.pdus[0].name == "LoginPacket");
+    assert(ps2.pdus[0].dispatches == 7);
+    assert(ps2.pdus[0].handler_ns_log2 == ps.pdus[0].handler_ns_log2);
+
+    //  numbers of any length, whether they're read or skipped
+    VectorPacket vp;
+    from_json(vp, "{\"doubles\": [1" + std::string(80, '0') + ", 0." + std::string(100, '5') + "]}");
+    assert(vp.doubles.size() == 2 && vp.doubles[0] == 1e80 && vp.doubles[1] == 0.5555555555555556);
+    from_json(ui2, "{\"extra\": -0." + std::string(100, '1') + "e-5, \"shoe_size\": 7}");
+    assert(ui2.shoe_size == 7);
+
+    char const *bad[] = {
+        "{\"shoe_size\": 1.5}",
+        "{\"shoe_size\": 99999999999}",
+        "{\"name\": \"open}",
+        "{\"name\": 1 \"email\": 2}",
+        "{} x",
+        "[]",
+    };
+    for (size_t i = 0; i != sizeof(bad) / sizeof(bad[0]); ++i)
+    {
+        bool threw = false;
+        try
+        {
+            from_json(ui2, std::string(bad[i]));
+        }
+        catch (std::exception const &)
+        {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    //  how fast UserInfo records go each way
+    ui.name = "Jon Watte";
+    ui.email = "jon@example.com";
+    ui.password = "correct horse battery staple";
+    ui.shoe_size = 44;
+    const int RECORDS = 100000;
+    size_t bytes = 0;
+    unsigned long long start = clock_ns();
+    for (int i = 0; i != RECORDS; ++i)
+    {
+        ui.shoe_size = i;
+        to_json(ui, str);
+        bytes += str.size();
+    }
+    unsigned long long written = clock_ns();
+    std::vector<char> scratch(str.size());
+    for (int i = 0; i != RECORDS; ++i)
+    {
+        //  the reader parses in place, so each record starts from a copy
+        memcpy(&scratch[0], str.data(), str.size());
+        from_json(ui2, &scratch[0], scratch.size());
+    }
+    unsigned long long read = clock_ns();
+    assert(ui2.shoe_size == RECORDS - 1 && ui2.password == ui.password);
+    std::cout << "json: " << RECORDS << " UserInfo records, " << bytes << " bytes, written at " <<
+        bytes * 1000.0 / (written - start + 1) << " MB/s, read at " <<
+        bytes * 1000.0 / (read - written + 1) << " MB/s" << std::endl;
+}
+
+void test_transcode()
+{
+    LoginPacket lp;
+    lp.version = 3;
+    lp.name = "Jon";
+    lp.password = "pw \"x\"";
+    ConnectedPacket cp;
+    cp.result = -1;
+    cp.version = 3;
+    cp.users.push_back("Administrator");
+    cp.users.push_back("User 1");
+    simple_stream ss;
+    my_proto.encode(lp, ss);
+    my_proto.encode(cp, ss);
+    size_t size = ss.position();
+    std::string wire((char const *)ss.unsafe_data(), size);
+
+    //  the text is what to_text() of the decoded PDU would be
+    ss.set_position(0);
+    std::string text, tmp;
+    assert(transcode_to_text(my_proto, ss, text) == 1);
+    convert<LoginPacket, true>::to_string(lp, tmp);
+    assert(text == "LoginPacket " + tmp);
+    text.clear();
+    assert(transcode_to_text(my_proto, ss, text) == 3);
+    convert<ConnectedPacket, true>::to_string(cp, tmp);
+    assert(text == "ConnectedPacket " + tmp);
+    assert(ss.bytes_left() == 0);
+
+    //  and back
+    ss.set_position(0);
+    std::string all;
+    transcode_to_text(my_proto, ss, all);
+    transcode_to_text(my_proto, ss, all);
+    simple_stream back;
+    char const *str = all.c_str();
+    assert(transcode_from_text(my_proto, str, back) == 1);
+    assert(transcode_from_text(my_proto, str, back) == 3);
+    assert(back.position() == size);
+    assert(!memcmp(back.unsafe_data(), wire.data(), size));
+
+    //  JSON, both ways
+    ss.set_position(0);
+    std::string json;
+    {
+        json_writer w(json);
+        transcode_to_json(my_proto, ss, w);
+    }
+    to_json(lp, tmp);
+    assert(json == "{\"LoginPacket\":" + tmp + "}");
+    json.clear();
+    {
+        json_writer w(json);
+        transcode_to_json(my_proto, ss, w);
+    }
+    std::vector<char> buf(json.begin(), json.end());
+    json_reader r(&buf[0], buf.size());
+    simple_stream back2;
+    assert(transcode_from_json(my_proto, r, back2) == 3);
+    r.finish();
+    simple_stream cpOnly;
+    my_proto.encode(cp, cpOnly);
+    assert(back2.position() == cpOnly.position());
+    assert(!memcmp(back2.unsafe_data(), cpOnly.unsafe_data(), cpOnly.position()));
+
+    //  keys out of order, unknown and missing keys
+    char doc[] = "{\"LoginPacket\":{\"password\":\"p\",\"junk\":[1],\"version\":7}}";
+    json_reader r2(doc, sizeof(doc) - 1);
+    simple_stream back3;
+    assert(transcode_from_json(my_proto, r2, back3) == 1);
+    back3.set_position(0);
+    char pdu[1024];
+    assert(my_proto.decode(pdu, sizeof(pdu), back3) == 1);
+    LoginPacket const &lp2 = *(LoginPacket const *)pdu;
+    assert(lp2.version == 7);
+    assert(lp2.name == "");
+    assert(lp2.password == "p");
+    my_proto.destroy(1, pdu);
+
+    //  nested structs in collections
+    protocol_stats_t ps;
+    ps.protocol = "p";
+    ps.unknown_codes = 2;
+    ps.pdus.resize(2);
+    ps.pdus[1].name = "x";
+    ps.pdus[1].handler_ns_log2.push_back(5);
+    simple_stream ps_wire;
+    marshal<protocol_stats_t, true>::output(ps, ps_wire);
+    ps_wire.set_position(0);
+    text.clear();
+    protocol_stats_t::member_info().access().wire_to_text(ps_wire, text);
+    convert<protocol_stats_t, true>::to_string(ps, tmp);
+    assert(text == tmp);
+}
+
+void test_hash()
+{
+    UserInfo a;
+    a.name = "Jon";
+    a.email = "jon@example.com";
+    a.password = "pw";
+    a.shoe_size = 44;
+    UserInfo b(a);
+    assert(equals(a, b));
+    assert(compare(a, b) == 0);
+    assert(hash(a) == hash(b));
+    b.shoe_size = 45;
+    assert(!equals(a, b));
+    assert(compare(a, b) < 0);
+    assert(compare(b, a) > 0);
+    assert(hash(a) != hash(b));
+    b.shoe_size = 44;
+    b.email = "a";
+    assert(compare(a, b) > 0);
+
+    //  string boundaries are part of the hash
+    b = a;
+    b.name = "Jo";
+    b.email = "njon@example.com";
+    assert(!equals(a, b));
+    assert(hash(a) != hash(b));
+
+    //  the six counters in the middle of pdu_stats_t are one run
+    type_info_base const &ti = pdu_stats_t::member_info();
+    assert(ti.runs().size() == 4);
+    assert(ti.runs()[2].member == 0);
+    assert(ti.runs()[2].size == 6 * sizeof(unsigned long long));
+
+    //  nested compounds and collections
+    protocol_stats_t ps;
+    ps.protocol = "p";
+    ps.unknown_codes = 1;
+    ps.pdus.resize(2);
+    ps.pdus[1].name = "x";
+    ps.pdus[1].handler_ns_log2.push_back(5);
+    protocol_stats_t ps2(ps);
+    assert(equals(ps, ps2));
+    assert(hash(ps) == hash(ps2));
+    ps2.pdus[1].handler_ns_log2.push_back(0);
+    assert(!equals(ps, ps2));
+    assert(compare(ps, ps2) < 0);
+    assert(hash(ps) != hash(ps2));
+
+    ConnectedPacket c1, c2;
+    c1.result = c2.result = 0;
+    c1.version = c2.version = 1;
+    c1.users.push_back("a");
+    c2.users.push_back("b");
+    assert(compare(c1, c2) < 0);
+    c2.users.front() = "a";
+    assert(equals(c1, c2));
+
+    //  as container functors
+    std::unordered_map<UserInfo, int, hasher, equal_to> um;
+    um[a] = 1;
+    um[b] = 2;
+    assert(um.size() == 2);
+    UserInfo a2(a);
+    assert(um[a2] == 1);
+    std::map<UserInfo, int, introspection::less> om;
+    om[b] = 2;
+    om[a] = 1;
+    assert(om.begin()->second == 2);
+}
+
+void test_lazy_pdu()
+{
+    ConnectedPacket cp;
+    cp.result = 2;
+    cp.version = 3;
+    cp.users.push_back("Administrator");
+    cp.users.push_back("User 1");
+    simple_stream ss;
+    my_proto.encode_indexed(cp, ss);
+    size_t size = ss.position();
+    //  code, body size, two 16 bit offsets, then the body as encode() writes it
+    simple_stream plain;
+    my_proto.encode(cp, plain);
+    assert(size == plain.position() + 4 + 2 * 2);
+    assert(!memcmp((char *)ss.unsafe_data() + 12, (char *)plain.unsafe_data() + 4, plain.position() - 4));
+
+    char const *data = (char const *)ss.unsafe_data();
+    int code;
+    readonly_stream head(data, sizeof(code));
+    marshal<int, false>::input(code, head);
+    assert(code == my_proto.code<ConnectedPacket>());
+    lazy_pdu<ConnectedPacket> lp;
+    assert(lp.reset(data + 4, size - 4) == size - 4);
+    assert(!lp.decoded(0) && !lp.decoded(1) && !lp.decoded(2));
+    assert(lp.get(&ConnectedPacket::users).size() == 2);
+    assert(lp.decoded(2) && !lp.decoded(0));
+    assert(lp.get(&ConnectedPacket::version) == 3);
+    assert(!lp.decoded(0));
+    assert(lp.get_all().result == 2);
+    assert(lp.get_all().users.back() == "User 1");
+
+    //  bodies of 64 kB and up use 32 bit offsets
+    cp.users.push_back(std::string(70000, 'x'));
+    cp.version = 4;
+    simple_stream big;
+    my_proto.encode_indexed(cp, big);
+    lp.reset((char const *)big.unsafe_data() + 4, big.position() - 4);
+    assert(lp.get(&ConnectedPacket::version) == 4);
+    assert(lp.get(&ConnectedPacket::users).back().size() == 70000);
+
+    //  truncated data, and offsets that don't match the members, are caught
+    bool threw = false;
+    try
+    {
+        lp.reset(data + 4, size - 5);
+    }
+    catch (std::exception const &)
+    {
+        threw = true;
+    }
+    assert(threw);
+    std::string bad(data + 4, size - 4);
+    simple_stream patch;
+    marshal<unsigned short, false>::output(5, patch);
+    memcpy(&bad[4], patch.unsafe_data(), 2);    //  version now starts at 5, inside result
+    lp.reset(bad.data(), bad.size());
+    threw = false;
+    try
+    {
+        lp.get(&ConnectedPacket::result);
+    }
+    catch (std::exception const &)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    //  get() finds a member's index by its offset with a hash lookup
+    type_info_base const &ti = ServerStats::member_info();
+    size_t count = ti.end() - ti.begin();
+    for (size_t i = 0; i != count; ++i)
+    {
+        assert(ti.member_at(ti.begin()[i].access().offset()) == i);
+    }
+    assert(UserInfo::member_info().member_at(1) == 4);
+}
+
+//  only ever found through the registry
+struct RegistryOnly
+{
+    int a;
+    std::vector<UserInfo> users;
+
+    INTROSPECTION(RegistryOnly, \
+        MEMBER(a, "a number") \
+        MEMBER(users, "some users") \
+        );
+};
+
+void test_registry()
+{
+    warm_up_report_t report;
+    warm_up(&report);
+    assert(report.protocols >= 1);
+    assert(report.pdus >= 7);
+    //  at least the sample types, the stats and report types, and RegistryOnly
+    assert(report.types >= 11);
+    assert(report.members > report.types);
+    assert(report.metadata_bytes > report.members * sizeof(member_t));
+
+    type_info_base const *ti = find_type("RegistryOnly");
+    assert(ti != 0);
+    assert(ti == &RegistryOnly::member_info());
+    assert(find_type("NoSuchType") == 0);
+
+    //  protocols come and go from the registry
+    unsigned int protocols = report.protocols;
+    {
+        protocol_t other(protocol_t("other") .add_pdu<UserLeftPacket>());
+        warm_up(&report);
+        assert(report.protocols == protocols + 1);
+    }
+    warm_up(&report);
+    assert(report.protocols == protocols);
+}
+
+struct FixedPacket
+{
+    int code;
+    int counts[4];
+    std::array<double, 3> pos;
+    fixed_string<16> name;
+    std::array<std::string, 2> tags;
+
+    INTROSPECTION(FixedPacket, \
+        MEMBER(code, "code") \
+        MEMBER(counts, "counts") \
+        MEMBER(pos, "position") \
+        MEMBER(name, "name") \
+        MEMBER(tags, "tags") \
+        );
+};
+
+void test_fixed()
+{
+    FixedPacket fp;
+    fp.code = 7;
+    for (int i = 0; i != 4; ++i)
+    {
+        fp.counts[i] = i * 10;
+    }
+    fp.pos[0] = 1.5;
+    fp.pos[1] = -2;
+    fp.pos[2] = 0.25;
+    fp.name = "Jon Watte";
+    fp.tags[0] = "admin";
+    fp.tags[1] = "ops";
+    assert(fp.name.size() == 9 && fp.name == "Jon Watte");
+
+    //  code and counts are one bitwise run (pos is past padding, so starts
+    //  another); arrays carry no count on the wire
+    type_info_base const &ti = FixedPacket::member_info();
+    assert(ti.runs().size() == 4);
+    assert(ti.runs()[0].member == 0 && ti.runs()[0].size == sizeof(int) * 5);
+    assert(ti.runs()[1].member == 0 && ti.runs()[1].size == sizeof(double) * 3);
+    simple_stream ss;
+    ti.access().get_from(&fp, ss);
+    simple_stream expect;
+    marshal<int, false>::output(fp.code, expect);
+    for (int i = 0; i != 4; ++i)
+    {
+        marshal<int, false>::output(fp.counts[i], expect);
+    }
+    for (int i = 0; i != 3; ++i)
+    {
+        marshal<double, false>::output(fp.pos[i], expect);
+    }
+    marshal<std::string, false>::output(std::string("Jon Watte"), expect);
+    marshal<std::string, false>::output(fp.tags[0], expect);
+    marshal<std::string, false>::output(fp.tags[1], expect);
+    assert(ss.position() == expect.position());
+    assert(!memcmp(ss.unsafe_data(), expect.unsafe_data(), ss.position()));
+
+    FixedPacket fp2;
+    ss.set_position(0);
+    ti.access().put_to(&fp2, ss);
+    assert(equals(fp, fp2));
+    assert(hash(fp) == hash(fp2));
+    fp2.counts[3] = 31;
+    assert(!equals(fp, fp2));
+    assert(compare(fp, fp2) < 0);
+
+    std::string text;
+    ti.access().to_text(&fp, text);
+    assert(text == "[ 7 { 0 10 20 30 } { 1.5 -2 0.25 } \"Jon Watte\" { \"admin\" \"ops\" } ] ");
+    FixedPacket fp3;
+    ti.access().from_text(&fp3, text.c_str());
+    assert(equals(fp, fp3));
+
+    std::string json;
+    to_json(fp, json);
+    assert(json == "{\"code\":7,\"counts\":[0,10,20,30],\"pos\":[1.5,-2,0.25],\"name\":\"Jon Watte\",\"tags\":[\"admin\",\"ops\"]}");
+    FixedPacket fp4;
+    from_json(fp4, json);
+    assert(equals(fp, fp4));
+
+    //  transcoding goes through the same traits
+    std::string text2;
+    simple_stream wire;
+    ti.access().get_from(&fp, wire);
+    wire.set_position(0);
+    ti.access().wire_to_text(wire, text2);
+    assert(text2 == text);
+    simple_stream wire2;
+    ti.access().text_to_wire(text.c_str(), wire2);
+    assert(wire2.position() == wire.position());
+    assert(!memcmp(wire2.unsafe_data(), wire.unsafe_data(), wire.position()));
+
+    //  too long for the storage, or the wrong number of elements, throws
+    bool threw = false;
+    try
+    {
+        fp.name = "a string that is longer than sixteen";
+    }
+    catch (std::length_error const &)
+    {
+        threw = true;
+    }
+    assert(threw);
+    simple_stream longer;
+    marshal<std::string, false>::output(std::string(17, 'x'), longer);
+    longer.set_position(0);
+    threw = false;
+    try
+    {
+        marshal<fixed_string<16>, false>::input(fp.name, longer);
+    }
+    catch (std::runtime_error const &)
+    {
+        threw = true;
+    }
+    assert(threw);
+    threw = false;
+    try
+    {
+        from_json(fp4, std::string("{\"counts\":[1,2,3]}"));
+    }
+    catch (std::runtime_error const &)
+    {
+        threw = true;
+    }
+    assert(threw);
+}
+
+struct TablesPacket
+{
+    std::map<std::string, int> scores;
+    std::unordered_map<int, std::vector<std::string> > groups;
+    std::deque<int> recent;
+    std::multiset<std::string> tags;
+    std::map<int, UserInfo> users;
+
+    INTROSPECTION(TablesPacket, \
+        MEMBER(scores, "score by name") \
+        MEMBER(groups, "names by group") \
+        MEMBER(recent, "recent codes") \
+        MEMBER(tags, "tags") \
+        MEMBER(users, "users by id") \
+        );
+};
+
+void test_containers()
+{
+    TablesPacket tp;
+    tp.scores["bob"] = 3;
+    tp.scores["alice"] = 7;
+    tp.groups[1].push_back("alice");
+    tp.groups[2].push_back("bob");
+    tp.groups[2].push_back("carol");
+    tp.recent.push_back(5);
+    tp.recent.push_front(4);
+    tp.tags.insert("x");
+    tp.tags.insert("x");
+    tp.tags.insert("a");
+    tp.users[10].name = "Jon";
+    tp.users[10].shoe_size = 44;
+
+    //  a map is a count, then key and value of each entry, in order
+    type_info_base const &ti = TablesPacket::member_info();
+    assert(ti.begin()[0].access().collection());
+    simple_stream ss;
+    ti.begin()[0].access().get_from(&tp, ss);
+    simple_stream expect;
+    marshal<unsigned int, false>::output(2, expect);
+    marshal<std::string, false>::output(std::string("alice"), expect);
+    marshal<int, false>::output(7, expect);
+    marshal<std::string, false>::output(std::string("bob"), expect);
+    marshal<int, false>::output(3, expect);
+    assert(ss.position() == expect.position());
+    assert(!memcmp(ss.unsafe_data(), expect.unsafe_data(), ss.position()));
+
+    simple_stream all;
+    ti.access().get_from(&tp, all);
+    TablesPacket tp2;
+    tp2.scores["stale"] = 1;
+    all.set_position(0);
+    ti.access().put_to(&tp2, all);
+    assert(all.bytes_left() == 0);
+    assert(tp2.scores == tp.scores);
+    assert(tp2.groups == tp.groups);
+    assert(tp2.recent == tp.recent);
+    assert(tp2.tags == tp.tags && tp2.tags.count("x") == 2);
+    assert(tp2.users[10].name == "Jon" && tp2.users[10].shoe_size == 44);
+    assert(equals(tp, tp2));
+    assert(hash(tp) == hash(tp2));
+    assert(compare(tp, tp2) == 0);
+
+    //  unordered_map equality and hashing don't depend on bucket order
+    TablesPacket tp3(tp);
+    tp3.groups.rehash(64);
+    assert(equals(tp, tp3) && hash(tp) == hash(tp3) && compare(tp, tp3) == 0);
+    tp3.groups[3];
+    assert(!equals(tp, tp3) && compare(tp, tp3) < 0);
+
+    //  the straight-line building blocks write the same bytes
+    simple_stream gs;
+    gen::put(tp.scores, gs);
+    gen::put(tp.groups, gs);
+    gen::put(tp.recent, gs);
+    gen::put(tp.tags, gs);
+    gen::put(tp.users, gs);
+    assert(gs.position() == all.position());
+    assert(!memcmp(gs.unsafe_data(), all.unsafe_data(), gs.position()));
+    TablesPacket tp4;
+    gs.set_position(0);
+    gen::get(tp4.scores, gs);
+    gen::get(tp4.groups, gs);
+    gen::get(tp4.recent, gs);
+    gen::get(tp4.tags, gs);
+    gen::get(tp4.users, gs);
+    assert(equals(tp, tp4));
+
+    std::string text;
+    ti.begin()[0].access().to_text(&tp, text);
+    assert(text == "{ [ \"alice\" 7 ] [ \"bob\" 3 ] } ");
+    std::string gtext;
+    gen::text(tp.scores, gtext);
+    assert(gtext == text);
+    ti.access().to_text(&tp, text);
+    TablesPacket tp5;
+    ti.access().from_text(&tp5, text.c_str());
+    assert(equals(tp, tp5));
+
+    std::string json;
+    to_json(tp, json);
+    assert(json.find("\"scores\":[[\"alice\",7],[\"bob\",3]]") != std::string::npos);
+    TablesPacket tp6;
+    from_json(tp6, json);
+    assert(equals(tp, tp6));
+
+    //  and transcoding walks the entries through the same accesses
+    std::string wtext;
+    all.set_position(0);
+    ti.access().wire_to_text(all, wtext);
+    assert(wtext == text);
+    simple_stream back;
+    ti.access().text_to_wire(text.c_str(), back);
+    assert(back.position() == all.position());
+    TablesPacket tp7;
+    back.set_position(0);
+    ti.access().put_to(&tp7, back);
+    assert(equals(tp, tp7));
+}
+
+void test_wire_order()
+{
+    //  scalars, and block lengths, are in the wire order whatever the host
+    simple_stream ss;
+    marshal<int, false>::output(0x01020304, ss);
+    write_block(2, "hi", ss);
+    unsigned char const *b = (unsigned char const *)ss.unsafe_data();
+    if (INTROSPECTION_WIRE_BIG_ENDIAN)
+    {
+        assert(b[0] == 1 && b[1] == 2 && b[2] == 3 && b[3] == 4);
+        assert(b[4] == 0 && b[7] == 2);
+    }
+    else
+    {
+        assert(b[0] == 4 && b[1] == 3 && b[2] == 2 && b[3] == 1);
+        assert(b[4] == 2 && b[7] == 0);
+    }
+    ss.set_position(0);
+    int i = 0;
+    marshal<int, false>::input(i, ss);
+    assert(i == 0x01020304);
+
+    //  the vectorized swap agrees with swapping one element at a time, for
+    //  any length and alignment, in place or not
+    unsigned char src[200], dst[200], ref[200];
+    for (size_t n = 0; n != sizeof(src); ++n)
+    {
+        src[n] = (unsigned char)(n * 7 + 1);
+    }
+    for (size_t size = 2; size <= 8; size *= 2)
+    {
+        for (size_t align = 0; align != 4; ++align)
+        {
+            for (size_t cnt = 0; cnt * size + align <= 180; cnt += 3)
+            {
+                for (size_t e = 0; e != cnt; ++e)
+                {
+                    for (size_t j = 0; j != size; ++j)
+                    {
+                        ref[e * size + j] = src[align + e * size + size - 1 - j];
+                    }
+                }
+                swap_bytes(dst, src + align, cnt, size);
+                assert(!memcmp(dst, ref, cnt * size));
+                memcpy(dst + align, src + align, cnt * size);
+                swap_bytes(dst + align, dst + align, cnt, size);
+                assert(!memcmp(dst + align, ref, cnt * size));
+            }
+        }
+    }
+
+    //  vectors of scalars are one block, but the same bytes as one at a time
+    VectorPacket vp;
+    for (int n = 0; n != 100; ++n)
+    {
+        vp.ints.push_back(n * 1000003);
+        vp.doubles.push_back(n * 0.5 - 7);
+    }
+    simple_stream bulk;
+    VectorPacket::member_info().access().get_from(&vp, bulk);
+    simple_stream single;
+    marshal<unsigned int, false>::output(100, single);
+    for (int n = 0; n != 100; ++n)
+    {
+        marshal<int, false>::output(vp.ints[n], single);
+    }
+    marshal<unsigned int, false>::output(100, single);
+    for (int n = 0; n != 100; ++n)
+    {
+        marshal<double, false>::output(vp.doubles[n], single);
+    }
+    assert(bulk.position() == single.position());
+    assert(!memcmp(bulk.unsafe_data(), single.unsafe_data(), bulk.position()));
+    simple_stream gs;
+    gen::put(vp.ints, gs);
+    gen::put(vp.doubles, gs);
+    assert(gs.position() == bulk.position());
+    assert(!memcmp(gs.unsafe_data(), bulk.unsafe_data(), bulk.position()));
+
+    VectorPacket vp2;
+    vp2.ints.resize(3);
+    bulk.set_position(0);
+    VectorPacket::member_info().access().put_to(&vp2, bulk);
+    assert(vp2.ints == vp.ints && vp2.doubles == vp.doubles);
+    VectorPacket vp3;
+    gs.set_position(0);
+    gen::get(vp3.ints, gs);
+    gen::get(vp3.doubles, gs);
+    assert(equals(vp, vp3));
+
+    //  nested arrays are swapped down to their scalars, the same bytes as 
+    //  one scalar at a time
+    int two[2][2] = { { 1, 2 }, { 3, 4 } };
+    std::vector<std::array<int, 2> > pairs(2);
+    pairs[0][0] = 5;
+    pairs[0][1] = 6;
+    pairs[1][0] = 7;
+    pairs[1][1] = 8;
+    std::array<std::array<short, 2>, 2> shorts = { { { { 9, 10 } }, { { 11, 12 } } } };
+    simple_stream nested;
+    marshal<int[2][2], false>::output(two, nested);
+    gen::put(pairs, nested);
+    marshal<std::array<std::array<short, 2>, 2>, false>::output(shorts, nested);
+    simple_stream scalars;
+    for (int n = 1; n <= 4; ++n)
+    {
+        marshal<int, false>::output(n, scalars);
+    }
+    marshal<unsigned int, false>::output(2, scalars);
+    for (int n = 5; n <= 8; ++n)
+    {
+        marshal<int, false>::output(n, scalars);
+    }
+    for (short n = 9; n <= 12; ++n)
+    {
+        marshal<short, false>::output(n, scalars);
+    }
+    assert(nested.position() == scalars.position());
+    assert(!memcmp(nested.unsafe_data(), scalars.unsafe_data(), scalars.position()));
+    int two2[2][2] = { { 0 } };
+    std::vector<std::array<int, 2> > pairs2;
+    std::array<std::array<short, 2>, 2> shorts2 = { { { { 0 } } } };
+    nested.set_position(0);
+    marshal<int[2][2], false>::input(two2, nested);
+    gen::get(pairs2, nested);
+    marshal<std::array<std::array<short, 2>, 2>, false>::input(shorts2, nested);
+    assert(!memcmp(two, two2, sizeof(two)) && pairs2 == pairs && shorts2 == shorts);
+
+    //  a count bigger than the data is caught before anything is allocated
+    simple_stream lying;
+    marshal<unsigned int, false>::output(0x10000000, lying);
+    marshal<int, false>::output(1, lying);
+    lying.set_position(0);
+    bool threw = false;
+    try
+    {
+        VectorPacket::member_info().begin()[0].access().put_to(&vp3, lying);
+    }
+    catch (std::runtime_error const &)
+    {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_pool()
+{
+    //  a released instance is the next one acquired, and keeps its contents
+    type_pool &pool = type_pool::of<SaySomethingPacket>();
+    assert(&pool == &type_pool::of(SaySomethingPacket::member_info()));
+    pool_stats_t before;
+    pool.stats(before);
+    SaySomethingPacket *ssp = acquire_pooled<SaySomethingPacket>();
+    ssp->message = std::string(200, 'x');
+    release_pooled(ssp);
+    SaySomethingPacket *ssp2 = acquire_pooled<SaySomethingPacket>();
+    assert(ssp2 == ssp);
+    assert(ssp2->message.capacity() >= 200);
+    pool_stats_t ps;
+    pool.stats(ps);
+    assert(ps.type == "SaySomethingPacket");
+    assert(ps.acquires == before.acquires + 2);
+    assert(ps.allocations <= before.allocations + 1);
+    assert(ps.live == before.live + 1);
+
+    //  protocol_t hands out the same instances by code
+    int code = my_proto.code<SaySomethingPacket>();
+    my_proto.release(code, ssp2);
+    void *p = my_proto.acquire(code);
+    assert(p == ssp);
+    ssp2 = (SaySomethingPacket *)p;
+    ssp2->message = "pooled";
+    simple_stream byCode, typed;
+    my_proto.encode(code, ssp2, byCode);
+    my_proto.encode(*ssp2, typed);
+    assert(byCode.position() == typed.position());
+    assert(!memcmp(byCode.unsafe_data(), typed.unsafe_data(), typed.position()));
+    my_proto.release(code, ssp2);
+
+    //  decode_pooled() hands over an instance the caller gives back
+    byCode.set_position(0);
+    void *pdu = 0;
+    assert(my_proto.decode_pooled(pdu, byCode) == code);
+    assert(pdu == ssp);
+    assert(((SaySomethingPacket *)pdu)->message == "pooled");
+    my_proto.release(code, pdu);
+
+    //  instances can be made up front, and dropped again
+    pool.reserve(4);
+    pool.stats(ps);
+    assert(ps.cached >= 4);
+    unsigned long long allocations = ps.allocations;
+    std::vector<SaySomethingPacket *> held;
+    for (int i = 0; i != 4; ++i)
+    {
+        held.push_back(acquire_pooled<SaySomethingPacket>());
+    }
+    pool.stats(ps);
+    assert(ps.allocations == allocations);
+    for (int i = 0; i != 4; ++i)
+    {
+        release_pooled(held[i]);
+    }
+    pool.trim();
+    pool.stats(ps);
+    assert(ps.cached == 0 && ps.live == before.live);
+
+    std::vector<pool_stats_t> all;
+    pool_stats(all);
+    bool found = false;
+    for (size_t i = 0; i != all.size(); ++i)
+    {
+        found = found || all[i].type == "SaySomethingPacket";
+    }
+    assert(found);
+}
+
+static trace_point tp_test_a("test_a", TRACE_INFO);
+static trace_point tp_test_b("test_b", TRACE_VERBOSE);
+
+/* the events this thread recorded */
+static trace_thread_t const *my_trace_thread(trace_t const &t)
+{
+    for (size_t i = 0; i != t.threads.size(); ++i)
+    {
+        if (t.threads[i].thread == (unsigned int)this_thread_serial())
+        {
+            return &t.threads[i];
+        }
+    }
+    return 0;
+}
+
+void test_trace()
+{
+    assert(trace_level() == TRACE_OFF);
+    trace_clear();
+    tp_test_a(1, 1);
+    trace_t t;
+    trace_snapshot(t);
+    assert(!my_trace_thread(t) || my_trace_thread(t)->events.empty());
+
+    //  only the points at or below the level are recorded
+    set_trace_level(TRACE_DEBUG);
+    tp_test_a(3, 10);
+    tp_test_b(3, 20);
+    tp_test_a(4, 5);
+    set_trace_level(TRACE_OFF);
+    trace_snapshot(t);
+    trace_thread_t const *tt = my_trace_thread(t);
+    assert(tt && tt->events.size() == 2 && tt->recorded == 2);
+    assert(tt->events[0].point == (unsigned int)tp_test_a.id() && tt->events[0].fd == 3 && tt->events[0].bytes == 10);
+    assert(tt->events[1].fd == 4 && tt->events[1].bytes == 5);
+    assert(tt->events[1].ns >= tt->events[0].ns);
+    bool found = false;
+    for (size_t i = 0; i != t.points.size(); ++i)
+    {
+        if (t.points[i].id == (unsigned int)tp_test_b.id())
+        {
+            assert(t.points[i].name == "test_b" && t.points[i].level == TRACE_VERBOSE);
+            found = true;
+        }
+    }
+    assert(found);
+
+    //  saved and read back
+    simple_stream ss;
+    trace_write(t, ss);
+    ss.set_position(0);
+    trace_t t2;
+    trace_read(ss, t2);
+    assert(t2.points.size() == t.points.size());
+    tt = my_trace_thread(t2);
+    assert(tt && tt->events.size() == 2 && tt->events[1].bytes == 5);
+
+    std::vector<trace_summary_t> summary;
+    trace_summarize(t2, summary);
+    found = false;
+    for (size_t i = 0; i != summary.size(); ++i)
+    {
+        assert(summary[i].name != "test_b");
+        if (summary[i].name == "test_a")
+        {
+            assert(summary[i].count == 2 && summary[i].bytes == 15 && summary[i].count_after == 1);
+            found = true;
+        }
+    }
+    assert(found);
+    std::string text;
+    to_text(summary, text);
+    assert(text.find("test_a") != std::string::npos);
+    text.clear();
+    to_text(t2, text);
+    assert(text.find("test_a") != std::string::npos);
+
+    //  a full ring keeps the newest events
+    trace_clear();
+    set_trace_level(TRACE_INFO);
+    for (int i = 0; i != TRACE_RING_EVENTS + 100; ++i)
+    {
+        tp_test_a(0, i);
+    }
+    set_trace_level(TRACE_OFF);
+    trace_snapshot(t);
+    tt = my_trace_thread(t);
+    assert(tt && tt->recorded == TRACE_RING_EVENTS + 100 && tt->events.size() == TRACE_RING_EVENTS - 1);
+    assert(tt->events[0].bytes == 101 && tt->events.back().bytes == TRACE_RING_EVENTS + 99);
+    trace_clear();
+}
+
+/* what one thread pushes: messages of 8 to 199 bytes, which start with 
+   who pushed them and their number */
+struct ring_producer
+{
+    message_ring *ring;
+    int id;
+    int count;
+    long volatile *done;
+};
+
+static size_t ring_message_size(int id, int n)
+{
+    return 8 + (size_t)(n * 7 + id) % 192;
+}
+
+static void ring_produce(void *arg)
+{
+    ring_producer *p = (ring_producer *)arg;
+    unsigned char buf[200];
+    for (int n = 0; n != p->count; )
+    {
+        size_t size = ring_message_size(p->id, n);
+        memcpy(buf, &p->id, 4);
+        memcpy(buf + 4, &n, 4);
+        for (size_t b = 8; b != size; ++b)
+        {
+            buf[b] = (unsigned char)(n + b);
+        }
+        if (p->ring->push(buf, size, (n & 15) == 0))
+        {
+            ++n;
+        }
+        else
+        {
+            cpu_pause();
+        }
+    }
+    atomic_increment(p->done);
+}
+
+void test_message_ring()
+{
+    message_ring ring;
+    simple_stream ss;
+    size_t size;
+    bool critical;
+    assert(ring.empty() && ring.size() == 0 && !ring.front(size, critical));
+
+    //  too big, or nothing, is refused
+    std::vector<unsigned char> big(message_ring::MAX_MESSAGE_BYTES + 1, 'x');
+    assert(!ring.push(&big[0], big.size(), true));
+    assert(!ring.push(&big[0], 0, true));
+    assert(ring.push(&big[0], message_ring::MAX_MESSAGE_BYTES, true));
+    assert(ring.front(size, critical) && size == message_ring::MAX_MESSAGE_BYTES && critical);
+    ring.pop_to(ss);
+    assert(ss.position() == message_ring::MAX_MESSAGE_BYTES && ring.empty());
+
+    //  the last quarter is kept for critical messages
+    int chat = 0;
+    while (ring.push("chat", 4, false))
+    {
+        ++chat;
+    }
+    assert(chat == message_ring::SLOTS - message_ring::SLOTS / 4);
+    int reserved = 0;
+    while (ring.push("who", 3, true))
+    {
+        ++reserved;
+    }
+    assert(reserved == message_ring::SLOTS / 4);
+    assert(ring.size() == (size_t)(chat + reserved));
+    ss.set_position(0);
+    for (int i = 0; i != chat + reserved; ++i)
+    {
+        assert(ring.front(size, critical) && critical == (i >= chat));
+        ring.pop_to(ss);
+    }
+    assert(ring.empty() && ring.size() == 0);
+    assert(!memcmp(ss.unsafe_data(), "chatchat", 8));
+
+    //  threads pushing at once, while this one takes; each thread's 
+    //  messages come out whole, and in the order it pushed them
+    const int PRODUCERS = 4;
+    const int COUNT = 20000;
+    long volatile done = 0;
+    ring_producer producers[PRODUCERS];
+    for (int i = 0; i != PRODUCERS; ++i)
+    {
+        producers[i].ring = &ring;
+        producers[i].id = i;
+        producers[i].count = COUNT;
+        producers[i].done = &done;
+        uintptr_t thr = _beginthread(&ring_produce, 0, &producers[i]);
+        assert(thr != 0 && thr != (uintptr_t)-1);
+        (void)thr;
+    }
+    int next[PRODUCERS] = { 0 };
+    for (int taken = 0; taken != PRODUCERS * COUNT; )
+    {
+        if (!ring.front(size, critical))
+        {
+            cpu_pause();
+            continue;
+        }
+        ss.set_position(0);
+        ring.pop_to(ss);
+        ++taken;
+        //  the count of what's in it can't go below nothing
+        assert(ring.size() <= message_ring::SLOTS);
+        unsigned char const *data = (unsigned char const *)ss.unsafe_data();
+        int id, n;
+        memcpy(&id, data, 4);
+        memcpy(&n, data + 4, 4);
+        assert(id >= 0 && id < PRODUCERS && n == next[id]);
+        assert(size == ring_message_size(id, n) && ss.position() == size);
+        assert(critical == ((n & 15) == 0));
+        for (size_t b = 8; b != size; ++b)
+        {
+            assert(data[b] == (unsigned char)(n + b));
+        }
+        ++next[id];
+    }
+    while (atomic_load_acquire(&done) != PRODUCERS)
+    {
+        cpu_pause();
+    }
+    assert(ring.empty() && ring.size() == 0);
+}
+
+void test_server_stats()
+{
+    ServerStats st;
+    st.shards = 2;
+    st.uptime_s = 60;
+    st.connections = st.logged_in = 1;
+    st.accepts = 1ULL << 40;
+    st.refused = 0;
+    CountByReason k;
+    k.reason = "too far behind";
+    k.count = 3;
+    st.kicks.push_back(k);
+    st.timeouts = st.disconnects = st.bytes_in = st.bytes_out = 0;
+    st.frames_in = st.frames_out = st.frames_dropped = 0;
+    st.frames_in_per_s = st.frames_out_per_s = st.queue_depth = st.throttled = 0;
+    st.queued_bytes = 100;
+    st.peak_queued_bytes = 4000;
+    st.tick_ns_log2.resize(PDU_HISTOGRAM_BUCKETS);
+    st.tick_ns_log2[12] = 7;
+
+    //  the answer to an admin request, through the protocol
+    simple_stream ss;
+    ServerStatsRequest req;
+    req.version = 1;
+    my_proto.encode(req, ss);
+    my_proto.encode(st, ss);
+    ss.set_position(0);
+    void *pdu = 0;
+    int code = my_proto.decode_pooled(pdu, ss);
+    assert(code == my_proto.code<ServerStatsRequest>() && ((ServerStatsRequest *)pdu)->version == 1);
+    my_proto.release(code, pdu);
+    code = my_proto.decode_pooled(pdu, ss);
+    assert(code == my_proto.code<ServerStats>());
+    ServerStats const &got = *(ServerStats const *)pdu;
+    assert(got.shards == 2 && got.accepts == st.accepts && got.peak_queued_bytes == 4000);
+    assert(got.kicks.size() == 1 && got.kicks[0].reason == "too far behind" && got.kicks[0].count == 3);
+    assert(got.tick_ns_log2 == st.tick_ns_log2);
+    std::string text;
+    ServerStats::member_info().access().to_text(&got, text);
+    assert(text.find("\"too far behind\" 3") != std::string::npos);
+    my_proto.release(code, pdu);
+}
 
 int main(int argc, char const *argv[])
 {
     test_basic_marshal();
     test_introspection();
     test_protocol();
+    test_stats();
+    test_codes();
+    test_decode_and_dispatch();
+    test_recycle();
+    test_codegen();
+    test_json();
+    test_transcode();
+    test_hash();
+    test_lazy_pdu();
+    test_registry();
+    test_fixed();
+    test_containers();
+    test_wire_order();
+    test_pool();
+    test_trace();
+    test_message_ring();
+    test_server_stats();
     return 0;
 }
@@ -0,0 +1,169 @@
+
+#include <introspection/message_ring.h>
+#include <introspection/lockfree.h>
+
+
+namespace introspection
+{
+
+message_ring::message_ring() :
+    heads_(new slot_head[SLOTS]),
+    data_(new unsigned char[SLOTS * SLOT_BYTES]),
+    tail_(0),
+    head_(0),
+    pushed_(0),
+    taken_(0)
+{
+    //  no position plus one is zero until the counters wrap, and by then
+    //  every slot has been written over
+    for (int i = 0; i != SLOTS; ++i)
+    {
+        heads_[i].ready = 0;
+        heads_[i].size = 0;
+        heads_[i].critical = false;
+    }
+}
+
+message_ring::~message_ring()
+{
+    delete[] heads_;
+    delete[] data_;
+}
+
+bool message_ring::push(void const *data, size_t size, bool critical)
+{
+    if (size == 0 || size > MAX_MESSAGE_BYTES)
+    {
+        return false;
+    }
+    unsigned long n = (unsigned long)((size + SLOT_BYTES - 1) / SLOT_BYTES);
+    unsigned long limit = critical ? SLOTS : SLOTS - SLOTS / 4;
+    unsigned long pos;
+    while (true)
+    {
+        pos = (unsigned long)atomic_load_acquire(&tail_);
+        //  the taker moves head_ on once it's done with the slots, so
+        //  whatever is behind it is free
+        if (pos + n - (unsigned long)atomic_load_acquire(&head_) > limit)
+        {
+            return false;
+        }
+        if (atomic_cas(&tail_, (long)pos, (long)(pos + n)))
+        {
+            break;
+        }
+    }
+    //  the bytes may go round the end of the ring
+    size_t at = (size_t)(pos & (SLOTS - 1)) * SLOT_BYTES;
+    size_t first = SLOTS * SLOT_BYTES - at;
+    if (first > size)
+    {
+        first = size;
+    }
+    memcpy(&data_[at], data, first);
+    memcpy(data_, (unsigned char const *)data + first, size - first);
+    slot_head &h = heads_[pos & (SLOTS - 1)];
+    h.size = (unsigned int)size;
+    h.critical = critical;
+    //  counted before the taker can see it, so it's never taken before 
+    //  it's counted
+    atomic_increment(&pushed_);
+    atomic_store_release(&h.ready, (long)(pos + 1));
+    return true;
+}
+
+bool message_ring::front(size_t &oSize, bool &oCritical) const
+{
+    unsigned long pos = (unsigned long)head_;
+    slot_head const &h = heads_[pos & (SLOTS - 1)];
+    if ((unsigned long)atomic_load_acquire(&h.ready) != pos + 1)
+    {
+        return false;
+    }
+    oSize = h.size;
+    oCritical = h.critical;
+    return true;
+}
+
+void message_ring::pop_to(stream &oStr)
+{
+    unsigned long pos = (unsigned long)head_;
+    size_t size = heads_[pos & (SLOTS - 1)].size;
+    size_t at = (size_t)(pos & (SLOTS - 1)) * SLOT_BYTES;
+    size_t first = SLOTS * SLOT_BYTES - at;
+    if (first > size)
+    {
+        first = size;
+    }
+    oStr.write_bytes(first, &data_[at]);
+    if (size > first)
+    {
+        oStr.write_bytes(size - first, data_);
+    }
+    atomic_store_release(&head_, (long)(pos + (size + SLOT_BYTES - 1) / SLOT_BYTES));
+    ++taken_;
+}
+
+bool message_ring::empty() const
+{
+    return atomic_load_acquire(&tail_) == head_;
+}
+
+size_t message_ring::size() const
+{
+    return (size_t)((unsigned long)atomic_load_acquire(&pushed_) - (unsigned long)taken_);
+}
+
+
+fixed_stream::fixed_stream(void *buf, size_t size) :
+    buf_((unsigned char *)buf),
+    size_(size),
+    log_(0),
+    pos_(0)
+{
+}
+
+size_t fixed_stream::bytes_left()
+{
+    return log_ - pos_;
+}
+
+void fixed_stream::read_bytes(size_t cnt, void *dst)
+{
+    if (cnt > bytes_left())
+    {
+        throw std::runtime_error("underflow in fixed_stream::read_bytes()");
+    }
+    memcpy(dst, buf_ + pos_, cnt);
+    pos_ += cnt;
+}
+
+void fixed_stream::write_bytes(size_t cnt, void const *src)
+{
+    if (cnt > size_ - pos_)
+    {
+        throw std::runtime_error("message too big in fixed_stream::write_bytes()");
+    }
+    memcpy(buf_ + pos_, src, cnt);
+    pos_ += cnt;
+    if (pos_ > log_)
+    {
+        log_ = pos_;
+    }
+}
+
+size_t fixed_stream::position()
+{
+    return pos_;
+}
+
+void fixed_stream::set_position(size_t pos)
+{
+    if (pos > log_)
+    {
+        throw std::runtime_error("position out of range in fixed_stream::set_position()");
+    }
+    pos_ = pos;
+}
+
+}
@@ -0,0 +1,85 @@
+
+#if !defined(introspection_message_ring_h)
+#define introspection_message_ring_h
+
+#include <introspection/introspection.h>
+
+/* Messages on their way to being broadcast, already encoded. A bounded
+   ring of fixed size slots; a message takes as many slots in a row as its
+   bytes need, so the bytes are copied in once, when it's made, and copied
+   out once, into the frame it goes in. Any number of threads may push,
+   and one thread takes: a push claims its slots with a compare-and-swap,
+   copies the bytes in, and marks the first slot as ready, and nothing
+   else is locked or allocated. The taker stops at a message that has been
+   claimed but isn't ready yet, and finds it the next time.
+
+   The last quarter of the ring is only for critical messages, so when
+   the ring fills up with chat, who comes and goes still gets through.
+   */
+namespace introspection
+{
+class message_ring
+{
+    public:
+        enum { SLOTS = 4096 };      //  a power of two
+        enum { SLOT_BYTES = 64 };
+        /* the most one message may take */
+        enum { MAX_MESSAGE_BYTES = 1024 };
+
+        message_ring();
+        ~message_ring();
+        /* Any thread. Returns false, and does nothing, if the message is
+           too big, or doesn't fit now. */
+        bool push(void const *data, size_t size, bool critical);
+        /* The taking thread: the next message's size and kind, or false
+           if there's none ready. */
+        bool front(size_t &oSize, bool &oCritical) const;
+        /* the taking thread: append the front message to the stream, and
+           free its slots */
+        void pop_to(stream &oStr);
+        bool empty() const;
+        /* the taking thread: messages pushed and not yet taken */
+        size_t size() const;
+
+    private:
+        message_ring(message_ring const &);
+        message_ring &operator=(message_ring const &);
+        struct slot_head
+        {
+            //  the position of the message that starts here, plus one,
+            //  once its bytes are in
+            long volatile ready;
+            unsigned int size;
+            bool critical;
+        };
+        slot_head *heads_;
+        unsigned char *data_;
+        //  where the next push goes, and where the next take comes from
+        long volatile tail_;
+        long volatile head_;
+        long volatile pushed_;
+        long taken_;
+};
+
+/* A stream that writes into a buffer the caller has, for encoding a
+   message before it goes in the ring; throws if it doesn't fit. */
+class fixed_stream : public stream
+{
+    public:
+        fixed_stream(void *buf, size_t size);
+        virtual size_t bytes_left();
+        virtual void read_bytes(size_t cnt, void *dst);
+        virtual void write_bytes(size_t cnt, void const *src);
+        virtual size_t position();
+        virtual void set_position(size_t pos);
+        inline void const *data() const { return buf_; }
+
+    private:
+        unsigned char *buf_;
+        size_t size_;
+        size_t log_;
+        size_t pos_;
+};
+}
+
+#endif  //  introspection_message_ring_h
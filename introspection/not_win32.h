@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
 
 typedef socklen_t w32_socklen_t;
 typedef int BOOL;
@@ -0,0 +1,177 @@
+
+#include <introspection/pool.h>
+#include <introspection/lockfree.h>
+
+
+namespace introspection
+{
+
+//  pools are found through their type; this list is only for pool_stats()
+static long volatile pools_lock;
+
+static std::vector<type_pool *> &all_pools()
+{
+    static std::vector<type_pool *> pools;
+    return pools;
+}
+
+type_pool &type_pool::of(type_info_base const &ti)
+{
+    type_pool *pool = (type_pool *)atomic_load_ptr_acquire((void *volatile *)&ti.pool_);
+    if (pool)
+    {
+        return *pool;
+    }
+    type_pool *nu = new type_pool(ti);
+    if (!atomic_cas_ptr((void *volatile *)&ti.pool_, 0, nu))
+    {
+        //  another thread got there first
+        delete nu;
+        return *(type_pool *)atomic_load_ptr_acquire((void *volatile *)&ti.pool_);
+    }
+    spin_lock(&pools_lock);
+    all_pools().push_back(nu);
+    spin_unlock(&pools_lock);
+    return *nu;
+}
+
+type_pool::type_pool(type_info_base const &ti) :
+    type_(ti),
+    lock_(0),
+    acquires_(0),
+    releases_(0),
+    allocations_(0),
+    live_(0)
+{
+}
+
+void type_pool::lock() const
+{
+    spin_lock(&lock_);
+}
+
+void type_pool::unlock() const
+{
+    spin_unlock(&lock_);
+}
+
+static void *construct_pooled(type_info_base const &ti)
+{
+    void *mem = ::operator new(ti.access().size());
+    try
+    {
+        ti.access().create(mem);
+    }
+    catch (...)
+    {
+        ::operator delete(mem);
+        throw;
+    }
+    return mem;
+}
+
+void *type_pool::acquire()
+{
+    lock();
+    ++acquires_;
+    ++live_;
+    if (!free_.empty())
+    {
+        void *obj = free_.back();
+        free_.pop_back();
+        unlock();
+        return obj;
+    }
+    ++allocations_;
+    unlock();
+    try
+    {
+        return construct_pooled(type_);
+    }
+    catch (...)
+    {
+        lock();
+        --live_;
+        unlock();
+        throw;
+    }
+}
+
+void type_pool::release(void *obj)
+{
+    if (!obj)
+    {
+        return;
+    }
+    lock();
+    ++releases_;
+    --live_;
+    try
+    {
+        free_.push_back(obj);
+    }
+    catch (...)
+    {
+        unlock();
+        type_.access().destroy(obj);
+        ::operator delete(obj);
+        return;
+    }
+    unlock();
+}
+
+void type_pool::reserve(size_t cnt)
+{
+    lock();
+    size_t have = free_.size();
+    unlock();
+    for (; have < cnt; ++have)
+    {
+        void *obj = construct_pooled(type_);
+        lock();
+        ++allocations_;
+        free_.push_back(obj);
+        unlock();
+    }
+}
+
+void type_pool::trim()
+{
+    std::vector<void *> dead;
+    lock();
+    dead.swap(free_);
+    unlock();
+    for (size_t i = 0; i != dead.size(); ++i)
+    {
+        type_.access().destroy(dead[i]);
+        ::operator delete(dead[i]);
+    }
+}
+
+void type_pool::stats(pool_stats_t &oStats) const
+{
+    oStats.type = type_.name();
+    oStats.object_size = (unsigned int)type_.access().size();
+    lock();
+    oStats.acquires = acquires_;
+    oStats.releases = releases_;
+    oStats.allocations = allocations_;
+    oStats.live = (unsigned int)live_;
+    oStats.cached = (unsigned int)free_.size();
+    unlock();
+}
+
+void pool_stats(std::vector<pool_stats_t> &oStats)
+{
+    std::vector<type_pool *> pools;
+    spin_lock(&pools_lock);
+    pools = all_pools();
+    spin_unlock(&pools_lock);
+    oStats.resize(pools.size());
+    for (size_t i = 0; i != pools.size(); ++i)
+    {
+        pools[i]->stats(oStats[i]);
+    }
+}
+
+}
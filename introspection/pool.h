@@ -0,0 +1,93 @@
+
+#if !defined(introspection_pool_h)
+#define introspection_pool_h
+
+#include <introspection/introspection.h>
+
+/* A type_pool keeps constructed instances of one introspected type on a free 
+   list, so code that needs a PDU to outlive the call that produced it (a 
+   queue of outgoing messages, a PDU handed to another thread) doesn't go to 
+   the global allocator for each one. Every type has at most one pool, made 
+   the first time it's asked for; type_pool::of() and protocol_t::acquire() 
+   find it through the type info. Pools are thread safe, and live until the 
+   program exits.
+
+   An instance that comes back from acquire() holds whatever its last user 
+   left in it (which is what lets its strings and containers keep their 
+   capacity); assign or decode over it.
+   */
+
+namespace introspection
+{
+    struct pool_stats_t
+    {
+        std::string type;
+        unsigned int object_size;
+        unsigned long long acquires;
+        unsigned long long releases;
+        unsigned long long allocations;
+        unsigned int live;
+        unsigned int cached;
+
+        INTROSPECTION(pool_stats_t, \
+            MEMBER(type, "type name") \
+            MEMBER(object_size, "sizeof() the type") \
+            MEMBER(acquires, "acquire() calls") \
+            MEMBER(releases, "release() calls") \
+            MEMBER(allocations, "instances constructed, because the free list was empty") \
+            MEMBER(live, "instances acquired and not yet released") \
+            MEMBER(cached, "constructed instances on the free list") \
+            );
+    };
+
+    class type_pool
+    {
+        public:
+            /* the pool for a type */
+            static type_pool &of(type_info_base const &ti);
+            template<typename T>
+            static inline type_pool &of() { return of(T::member_info()); }
+
+            /* a constructed instance, from the free list if there is one */
+            void *acquire();
+            /* give back an instance that came from acquire() */
+            void release(void *obj);
+            /* construct instances up front, until cnt are cached */
+            void reserve(size_t cnt);
+            /* destroy the cached instances */
+            void trim();
+            void stats(pool_stats_t &oStats) const;
+            inline type_info_base const &type() const { return type_; }
+
+        private:
+            type_pool(type_info_base const &ti);
+            type_pool(type_pool const &);
+            type_pool &operator=(type_pool const &);
+            void lock() const;
+            void unlock() const;
+            type_info_base const &type_;
+            mutable long volatile lock_;
+            std::vector<void *> free_;
+            unsigned long long acquires_;
+            unsigned long long releases_;
+            unsigned long long allocations_;
+            long live_;
+    };
+
+    /* typed shorthands */
+    template<typename T>
+    inline T *acquire_pooled()
+    {
+        return (T *)type_pool::of<T>().acquire();
+    }
+    template<typename T>
+    inline void release_pooled(T *obj)
+    {
+        type_pool::of<T>().release(obj);
+    }
+
+    /* stats for every pool there is, in the order they were made */
+    void pool_stats(std::vector<pool_stats_t> &oStats);
+}
+
+#endif  //  introspection_pool_h
@@ -1,63 +1,464 @@
 
 #include <introspection/introspection.h>
+#include <introspection/protocol_stats.h>
+#include <introspection/registry.h>
+#include <introspection/pool.h>
 
 namespace introspection
 {
 
+static int next_protocol_id;
+
 protocol_t::protocol_t(char const *name) :
-    name_(name)
+    by_id_(1, (type_info_base const *)0),
+    id_(++next_protocol_id),
+    max_pdu_size_(0),
+    name_(name),
+    stats_(0),
+    generated_(0),
+    generated_codes_(0)
 {
+    register_protocol(this);
 }
 
+//  counters belong to the instance that enabled them, so copies start out 
+//  with stats turned off
 protocol_t::protocol_t(protocol_t const &proto) :
     by_id_(proto.by_id_),
     by_type_(proto.by_type_),
-    name_(proto.name_)
+    id_(proto.id_),
+    max_pdu_size_(proto.max_pdu_size_),
+    name_(proto.name_),
+    stats_(0),
+    generated_(proto.generated_),
+    generated_codes_(proto.generated_codes_)
 {
+    register_protocol(this);
 }
 
 protocol_t &protocol_t::operator=(protocol_t const &proto)
 {
     by_id_ = proto.by_id_;
     by_type_ = proto.by_type_;
+    id_ = proto.id_;
+    max_pdu_size_ = proto.max_pdu_size_;
     name_ = proto.name_;
+    generated_ = proto.generated_;
+    generated_codes_ = proto.generated_codes_;
+    enable_stats(false);
     return *this;
 }
 
+protocol_t::~protocol_t()
+{
+    unregister_protocol(this);
+    delete stats_;
+    for (size_t i = 0; i != retired_.size(); ++i)
+    {
+        delete retired_[i];
+    }
+}
+
 char const *protocol_t::name() const
 {
     return name_.c_str();
 }
 
-protocol_t &protocol_t::add_pdu(type_info_base const *pdu)
+int protocol_t::add_pdu(type_info_base const *pdu)
 {
-    int code = by_id_.size() + 1;
-    by_id_[code] = pdu;
+    if (stats_)
+    {
+        throw std::logic_error("can't add a PDU to a protocol while its stats are on");
+    }
+    int code = (int)by_id_.size();
+    by_id_.push_back(pdu);
     by_type_[pdu] = code;
-    return *this;
+    if (pdu->access().size() > max_pdu_size_)
+    {
+        max_pdu_size_ = pdu->access().size();
+    }
+    return code;
+}
+
+void protocol_t::use_generated(generated_decode_fn decode_body)
+{
+    generated_ = decode_body;
+    generated_codes_ = pdu_count();
+}
+
+void protocol_t::enable_stats(bool enable)
+{
+    if (!enable)
+    {
+        if (pdu_stats_collector *st = stats_)
+        {
+            stats_ = 0;
+            retired_.push_back(st);
+        }
+    }
+    else if (!stats_)
+    {
+        stats_ = new pdu_stats_collector(by_id_.size());
+    }
+}
+
+void protocol_t::count_encode(pdu_stats_collector *st, int code, size_t bytes)
+{
+    st->count_encode(code, bytes);
+}
+
+int protocol_t::decode_counted(pdu_stats_collector *st, void *dst, size_t max_size, stream &s)
+{
+    size_t start = s.position();
+    int c = 0;
+    type_info_base const *t = 0;
+    try
+    {
+        marshal<int, false>::input(c, s);
+        t = &type(c);
+    }
+    catch (...)
+    {
+        //  code 0 collects the codes we can't attribute to a PDU
+        st->count_decode_failure(0);
+        throw;
+    }
+    if (t->access().size() > max_size)
+    {
+        st->count_decode_failure(c);
+        throw std::runtime_error("not enough space for type in decode()");
+    }
+    t->access().create(dst);
+    try
+    {
+        put_body(*t, c, dst, s);
+    }
+    catch (...)
+    {
+        t->access().destroy(dst);
+        st->count_decode_failure(c);
+        throw;
+    }
+    st->count_decode(c, s.position() - start);
+    return c;
+}
+
+int protocol_t::decode_recycled(std::vector<void *> &live, stream &s)
+{
+#if !defined(INTROSPECTION_NO_STATS)
+    pdu_stats_collector *st = stats_;
+    size_t start = st ? s.position() : 0;
+#endif
+    int c = 0;
+    type_info_base const *t = 0;
+    try
+    {
+        marshal<int, false>::input(c, s);
+        t = &type(c);
+    }
+    catch (...)
+    {
+#if !defined(INTROSPECTION_NO_STATS)
+        if (st)
+        {
+            st->count_decode_failure(0);
+        }
+#endif
+        throw;
+    }
+    if (live.size() < by_id_.size())
+    {
+        live.resize(by_id_.size(), 0);
+    }
+    void *&pdu = live[c];
+    if (!pdu)
+    {
+        void *mem = ::operator new(t->access().size());
+        try
+        {
+            t->access().create(mem);
+        }
+        catch (...)
+        {
+            ::operator delete(mem);
+            throw;
+        }
+        pdu = mem;
+    }
+    try
+    {
+        put_body(*t, c, pdu, s);
+    }
+    catch (...)
+    {
+        //  the instance is still a valid object, just with garbage contents
+#if !defined(INTROSPECTION_NO_STATS)
+        if (st)
+        {
+            st->count_decode_failure(c);
+        }
+#endif
+        throw;
+    }
+#if !defined(INTROSPECTION_NO_STATS)
+    if (st)
+    {
+        st->count_decode(c, s.position() - start);
+    }
+#endif
+    return c;
+}
+
+void protocol_t::release_recycled(std::vector<void *> &live)
+{
+    for (size_t code = 0; code != live.size(); ++code)
+    {
+        if (live[code])
+        {
+            type(code).access().destroy(live[code]);
+            ::operator delete(live[code]);
+        }
+    }
+    live.clear();
+}
+
+void *protocol_t::acquire(int code)
+{
+    return type_pool::of(type(code)).acquire();
 }
 
-dispatch_t::dispatch_t()
+void protocol_t::release(int code, void *pdu)
+{
+    type_pool::of(type(code)).release(pdu);
+}
+
+int protocol_t::decode_pooled(void *&oPdu, stream &s)
+{
+#if !defined(INTROSPECTION_NO_STATS)
+    pdu_stats_collector *st = stats_;
+    size_t start = st ? s.position() : 0;
+#endif
+    int c = 0;
+    type_info_base const *t = 0;
+    try
+    {
+        marshal<int, false>::input(c, s);
+        t = &type(c);
+    }
+    catch (...)
+    {
+#if !defined(INTROSPECTION_NO_STATS)
+        if (st)
+        {
+            st->count_decode_failure(0);
+        }
+#endif
+        throw;
+    }
+    type_pool &pool = type_pool::of(*t);
+    void *pdu = pool.acquire();
+    try
+    {
+        put_body(*t, c, pdu, s);
+    }
+    catch (...)
+    {
+        //  garbage contents are fine for a pooled instance
+        pool.release(pdu);
+#if !defined(INTROSPECTION_NO_STATS)
+        if (st)
+        {
+            st->count_decode_failure(c);
+        }
+#endif
+        throw;
+    }
+#if !defined(INTROSPECTION_NO_STATS)
+    if (st)
+    {
+        st->count_decode(c, s.position() - start);
+    }
+#endif
+    oPdu = pdu;
+    return c;
+}
+
+void protocol_t::encode(int code, void const *pdu, stream &s)
+{
+    type_info_base const &ti = type(code);
+#if !defined(INTROSPECTION_NO_STATS)
+    pdu_stats_collector *st = stats_;
+    size_t start = st ? s.position() : 0;
+#endif
+    marshal<int, false>::output(code, s);
+    if (generated_codec_t const *gc = ti.generated())
+    {
+        (*gc->encode)(pdu, s);
+    }
+    else
+    {
+        ti.access().get_from(pdu, s);
+    }
+#if !defined(INTROSPECTION_NO_STATS)
+    if (st)
+    {
+        count_encode(st, code, s.position() - start);
+    }
+#endif
+}
+
+void protocol_t::stats_snapshot(protocol_stats_t &oStats) const
+{
+    oStats.protocol = name_;
+    oStats.unknown_codes = 0;
+    oStats.pdus.clear();
+    std::vector<pdu_counters> sum;
+    if (pdu_stats_collector *st = stats_)
+    {
+        st->merge(sum);
+        oStats.unknown_codes = sum[0].decode_failures;
+    }
+    for (size_t code = 1; code < by_id_.size(); ++code)
+    {
+        pdu_stats_t ps;
+        ps.code = (int)code;
+        ps.name = by_id_[code]->name();
+        pdu_counters pc;
+        memset(&pc, 0, sizeof(pc));
+        if ((size_t)ps.code < sum.size())
+        {
+            pc = sum[ps.code];
+        }
+        ps.encodes = pc.encodes;
+        ps.encode_bytes = pc.encode_bytes;
+        ps.decodes = pc.decodes;
+        ps.decode_bytes = pc.decode_bytes;
+        ps.decode_failures = pc.decode_failures;
+        ps.dispatches = pc.dispatches;
+        ps.handler_ns_log2.assign(pc.handler_ns, pc.handler_ns + PDU_HISTOGRAM_BUCKETS);
+        oStats.pdus.push_back(ps);
+    }
+}
+
+dispatch_t::dispatch_t() :
+    proto_(0),
+    decoding_(false),
+    recycle_(false),
+    live_proto_(0)
 {
 }
 
 dispatch_t::~dispatch_t()
 {
-    for (std::map<int, dispatch_base *>::iterator ptr(dispatch_.begin()), end(dispatch_.end());
+    recycle_pdus(false);
+    for (std::vector<dispatch_base *>::iterator ptr(dispatch_.begin()), end(dispatch_.end());
         ptr != end; ++ptr)
     {
-        delete (*ptr).second;
+        delete *ptr;
+    }
+}
+
+void dispatch_t::set_handler(int c, dispatch_base *d)
+{
+    if ((size_t)c >= dispatch_.size())
+    {
+        dispatch_.resize(c + 1, 0);
     }
+    delete dispatch_[c];
+    dispatch_[c] = d;
 }
 
 void dispatch_t::dispatch(int c, void const *data)
 {
-    std::map<int, dispatch_base *>::iterator ptr(dispatch_.find(c));
-    if (ptr == dispatch_.end())
+    dispatch_base *d = 0;
+    if (c >= 0 && (size_t)c < dispatch_.size())
+    {
+        d = dispatch_[c];
+    }
+    if (!d)
     {
         throw std::runtime_error("attempt to dispatch a code that wasn't registered");
     }
-    (*ptr).second->dispatch(data);
+#if !defined(INTROSPECTION_NO_STATS)
+    if (pdu_stats_collector *st = proto_ ? proto_->stats() : 0)
+    {
+        dispatch_timed(st, d, c, data);
+        return;
+    }
+#endif
+    d->dispatch(data);
+}
+
+void dispatch_t::recycle_pdus(bool recycle)
+{
+    if (!recycle && live_proto_)
+    {
+        live_proto_->release_recycled(live_);
+        live_proto_ = 0;
+    }
+    recycle_ = recycle;
+}
+
+int dispatch_t::decode_and_dispatch(protocol_t &proto, stream &s)
+{
+    //  a handler that decodes more PDUs with the same dispatcher gets fresh 
+    //  instances, rather than trampling the PDU it was handed
+    if (recycle_ && !decoding_)
+    {
+        if (live_proto_ && live_proto_ != &proto)
+        {
+            throw std::logic_error("decode_and_dispatch() with a different protocol while recycling PDUs");
+        }
+        live_proto_ = &proto;
+        int c = proto.decode_recycled(live_, s);
+        decoding_ = true;
+        try
+        {
+            dispatch(c, live_[c]);
+        }
+        catch (...)
+        {
+            decoding_ = false;
+            throw;
+        }
+        decoding_ = false;
+        return c;
+    }
+    size_t units = (proto.max_pdu_size() + sizeof(pdu_storage) - 1) / sizeof(pdu_storage);
+    if (units == 0)
+    {
+        units = 1;
+    }
+    std::vector<pdu_storage> nested;
+    std::vector<pdu_storage> &storage = decoding_ ? nested : storage_;
+    if (storage.size() < units)
+    {
+        storage.resize(units);
+    }
+    void *buf = &storage[0];
+    int c = proto.decode(buf, units * sizeof(pdu_storage), s);
+    bool outer = !decoding_;
+    decoding_ = true;
+    try
+    {
+        dispatch(c, buf);
+    }
+    catch (...)
+    {
+        decoding_ = !outer;
+        proto.destroy(c, buf);
+        throw;
+    }
+    decoding_ = !outer;
+    proto.destroy(c, buf);
+    return c;
+}
+
+void dispatch_t::dispatch_timed(pdu_stats_collector *st, dispatch_base *d, int c, void const *data)
+{
+    unsigned long long start = clock_ns();
+    d->dispatch(data);
+    st->count_dispatch(c, clock_ns() - start);
 }
 
 
@@ -0,0 +1,136 @@
+
+#include <introspection/protocol_stats.h>
+#include <introspection/lockfree.h>
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+
+namespace introspection
+{
+
+static long volatile next_thread_serial;
+static long volatile next_collector_serial;
+
+//  cache of the block the current thread used last, so the common case of one
+//  protocol being counted on a thread doesn't walk the block list
+static INTROSPECTION_THREAD_LOCAL long tls_thread;
+static INTROSPECTION_THREAD_LOCAL long tls_collector;
+static INTROSPECTION_THREAD_LOCAL void *tls_block;
+
+long this_thread_serial()
+{
+    if (tls_thread == 0)
+    {
+        tls_thread = atomic_increment(&next_thread_serial);
+    }
+    return tls_thread;
+}
+
+unsigned long long clock_ns()
+{
+#if defined(_MSC_VER)
+    static LARGE_INTEGER freq;
+    if (freq.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&freq);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (unsigned long long)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+pdu_stats_collector::pdu_stats_collector(size_t codes) :
+    serial_(atomic_increment(&next_collector_serial)),
+    codes_(codes),
+    blocks_(0)
+{
+}
+
+pdu_stats_collector::~pdu_stats_collector()
+{
+    block *b = blocks_;
+    while (b)
+    {
+        block *d = b;
+        b = b->next_;
+        delete[] d->counters_;
+        delete d;
+    }
+}
+
+pdu_stats_collector::block *pdu_stats_collector::local()
+{
+    if (tls_collector == serial_)
+    {
+        return (block *)tls_block;
+    }
+    long thread = this_thread_serial();
+    block *b = (block *)atomic_load_ptr_acquire((void *volatile *)&blocks_);
+    while (b && b->thread_ != thread)
+    {
+        b = b->next_;
+    }
+    if (!b)
+    {
+        b = new block();
+        b->thread_ = thread;
+        b->counters_ = new pdu_counters[codes_];
+        memset(b->counters_, 0, sizeof(pdu_counters) * codes_);
+        do
+        {
+            b->next_ = blocks_;
+        }
+        while (!atomic_cas_ptr((void *volatile *)&blocks_, b->next_, b));
+    }
+    tls_collector = serial_;
+    tls_block = b;
+    return b;
+}
+
+void pdu_stats_collector::count_dispatch(int code, unsigned long long ns)
+{
+    pdu_counters *pc = counters(code);
+    ++pc->dispatches;
+    int bucket = 0;
+    while (ns > 1 && bucket < PDU_HISTOGRAM_BUCKETS - 1)
+    {
+        ns >>= 1;
+        ++bucket;
+    }
+    ++pc->handler_ns[bucket];
+}
+
+void pdu_stats_collector::merge(std::vector<pdu_counters> &oSum) const
+{
+    oSum.resize(codes_);
+    memset(&oSum[0], 0, sizeof(pdu_counters) * codes_);
+    for (block *b = (block *)atomic_load_ptr_acquire((void *volatile *)&blocks_); b; b = b->next_)
+    {
+        for (size_t i = 0; i != codes_; ++i)
+        {
+            pdu_counters const &src = b->counters_[i];
+            pdu_counters &dst = oSum[i];
+            dst.encodes += src.encodes;
+            dst.encode_bytes += src.encode_bytes;
+            dst.decodes += src.decodes;
+            dst.decode_bytes += src.decode_bytes;
+            dst.decode_failures += src.decode_failures;
+            dst.dispatches += src.dispatches;
+            for (int j = 0; j != PDU_HISTOGRAM_BUCKETS; ++j)
+            {
+                dst.handler_ns[j] += src.handler_ns[j];
+            }
+        }
+    }
+}
+
+}
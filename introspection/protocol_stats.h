@@ -0,0 +1,126 @@
+
+#if !defined(introspection_protocol_stats_h)
+#define introspection_protocol_stats_h
+
+#include <introspection/introspection.h>
+
+namespace introspection
+{
+    /* number of log2 buckets in the handler time histogram; bucket i counts
+       handler calls that took [2^i, 2^(i+1)) nanoseconds */
+    enum { PDU_HISTOGRAM_BUCKETS = 32 };
+
+    /* Snapshot of the traffic for one PDU code. Get these from
+       protocol_t::stats_snapshot(), and print them with to_text().
+       */
+    struct pdu_stats_t
+    {
+        int code;
+        std::string name;
+        unsigned long long encodes;
+        unsigned long long encode_bytes;
+        unsigned long long decodes;
+        unsigned long long decode_bytes;
+        unsigned long long decode_failures;
+        unsigned long long dispatches;
+        std::vector<unsigned long long> handler_ns_log2;
+
+        INTROSPECTION(pdu_stats_t, \
+            MEMBER(code, "PDU code") \
+            MEMBER(name, "PDU type name") \
+            MEMBER(encodes, "number of encode() calls") \
+            MEMBER(encode_bytes, "bytes written by encode(), including the code") \
+            MEMBER(decodes, "number of successful decode() calls") \
+            MEMBER(decode_bytes, "bytes read by decode(), including the code") \
+            MEMBER(decode_failures, "number of decode() calls that threw") \
+            MEMBER(dispatches, "number of handler calls") \
+            MEMBER(handler_ns_log2, "handler time histogram, bucket i is [2^i, 2^(i+1)) ns") \
+            );
+    };
+
+    struct protocol_stats_t
+    {
+        std::string protocol;
+        unsigned long long unknown_codes;
+        std::vector<pdu_stats_t> pdus;
+
+        INTROSPECTION(protocol_stats_t, \
+            MEMBER(protocol, "protocol name") \
+            MEMBER(unknown_codes, "decodes that failed because the code was not registered") \
+            MEMBER(pdus, "per-PDU counters, in code order") \
+            );
+    };
+
+    /* The raw counters, one set per thread per protocol. Each thread only
+       ever writes its own block, so updates are plain adds; readers sum all
+       the blocks, and may see a slightly stale value while traffic is flowing.
+       */
+    struct pdu_counters
+    {
+        unsigned long long encodes;
+        unsigned long long encode_bytes;
+        unsigned long long decodes;
+        unsigned long long decode_bytes;
+        unsigned long long decode_failures;
+        unsigned long long dispatches;
+        unsigned long long handler_ns[PDU_HISTOGRAM_BUCKETS];
+    };
+
+    class pdu_stats_collector
+    {
+        public:
+            /* codes is one more than the highest PDU code to count; code 0
+               collects decodes of codes that aren't registered */
+            pdu_stats_collector(size_t codes);
+            ~pdu_stats_collector();
+
+            inline void count_encode(int code, size_t bytes)
+            {
+                pdu_counters *pc = counters(code);
+                ++pc->encodes;
+                pc->encode_bytes += bytes;
+            }
+            inline void count_decode(int code, size_t bytes)
+            {
+                pdu_counters *pc = counters(code);
+                ++pc->decodes;
+                pc->decode_bytes += bytes;
+            }
+            inline void count_decode_failure(int code)
+            {
+                ++counters(code)->decode_failures;
+            }
+            void count_dispatch(int code, unsigned long long ns);
+
+            /* sum all the per-thread blocks */
+            void merge(std::vector<pdu_counters> &oSum) const;
+
+        private:
+            struct block
+            {
+                block *next_;
+                long thread_;
+                pdu_counters *counters_;
+            };
+            inline pdu_counters *counters(int code)
+            {
+                if (code < 0 || (size_t)code >= codes_)
+                {
+                    code = 0;
+                }
+                return &local()->counters_[code];
+            }
+            block *local();
+
+            pdu_stats_collector(pdu_stats_collector const &);
+            pdu_stats_collector &operator=(pdu_stats_collector const &);
+            long serial_;
+            size_t codes_;
+            block *volatile blocks_;
+    };
+
+    /* monotonic nanoseconds, for timing handlers */
+    unsigned long long clock_ns();
+}
+
+#endif  //  introspection_protocol_stats_h
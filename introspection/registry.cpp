@@ -0,0 +1,171 @@
+
+#include <introspection/registry.h>
+#include <introspection/protocol_stats.h>
+#include <introspection/lockfree.h>
+
+#include <algorithm>
+
+
+namespace introspection
+{
+
+//  function-local, so they're there for registrations from any static
+//  initializer regardless of the order translation units initialize in.
+//  Every protocol_t registers, copies and temporaries too, on whatever 
+//  thread makes it, so the lists are kept under a lock (which, being 
+//  zero-initialized, works before any constructor has run).
+static long volatile registry_lock;
+
+static std::vector<type_info_getter> &registered_types()
+{
+    static std::vector<type_info_getter> types;
+    return types;
+}
+
+static std::vector<protocol_t *> &registered_protocols()
+{
+    static std::vector<protocol_t *> protocols;
+    return protocols;
+}
+
+void register_type(type_info_getter getter)
+{
+    spin_lock(&registry_lock);
+    registered_types().push_back(getter);
+    spin_unlock(&registry_lock);
+}
+
+void register_protocol(protocol_t *proto)
+{
+    spin_lock(&registry_lock);
+    registered_protocols().push_back(proto);
+    spin_unlock(&registry_lock);
+}
+
+void unregister_protocol(protocol_t *proto)
+{
+    spin_lock(&registry_lock);
+    std::vector<protocol_t *> &protos = registered_protocols();
+    std::vector<protocol_t *>::iterator ptr(std::find(protos.begin(), protos.end(), proto));
+    if (ptr != protos.end())
+    {
+        protos.erase(ptr);
+    }
+    spin_unlock(&registry_lock);
+}
+
+size_t type_info_base::metadata_bytes() const
+{
+    //  the access objects are templates of varying size; member pointers
+    //  are at most two words past the base
+    return sizeof(type_info_base) +
+        count_ * (sizeof(member_t) + sizeof(member_access_base) + 2 * sizeof(void *) + sizeof(member_info_base)) +
+        (index_.capacity() + offsets_.capacity()) * sizeof(unsigned short) +
+        runs_.capacity() * sizeof(member_run);
+}
+
+size_t protocol_t::metadata_bytes() const
+{
+    //  a map node is the value plus three links and a color
+    return sizeof(protocol_t) +
+        by_id_.capacity() * sizeof(type_info_base const *) +
+        by_type_.size() * (sizeof(std::pair<type_info_base const *, int>) + 4 * sizeof(void *)) +
+        name_.capacity();
+}
+
+static void warm_type(type_info_base const &ti, std::set<type_info_base const *> &seen);
+
+static void warm_access(member_access_base const &acc, std::set<type_info_base const *> &seen)
+{
+    if (acc.collection())
+    {
+        warm_access(acc.collection_info().element_access(), seen);
+    }
+    else if (acc.compound())
+    {
+        warm_type(acc.member_info(), seen);
+    }
+}
+
+static void warm_type(type_info_base const &ti, std::set<type_info_base const *> &seen)
+{
+    if (!seen.insert(&ti).second)
+    {
+        return;
+    }
+    for (member_t::iterator ptr(ti.begin()), end(ti.end()); ptr != end; ++ptr)
+    {
+        warm_access((*ptr).access(), seen);
+    }
+}
+
+void warm_up(warm_up_report_t *oReport)
+{
+    unsigned long long start = clock_ns();
+    std::set<type_info_base const *> seen;
+    spin_lock(&registry_lock);
+    std::vector<type_info_getter> types(registered_types());
+    spin_unlock(&registry_lock);
+    for (size_t i = 0; i != types.size(); ++i)
+    {
+        warm_type((*types[i])(), seen);
+    }
+    unsigned int pdus = 0;
+    size_t bytes = 0;
+    //  held while we look at them, so none goes away meanwhile
+    spin_lock(&registry_lock);
+    std::vector<protocol_t *> const &protos = registered_protocols();
+    unsigned int nprotos = (unsigned int)protos.size();
+    try
+    {
+        for (size_t i = 0; i != protos.size(); ++i)
+        {
+            for (int code = 1; code <= protos[i]->pdu_count(); ++code)
+            {
+                warm_type(protos[i]->type(code), seen);
+            }
+            pdus += protos[i]->pdu_count();
+            bytes += protos[i]->metadata_bytes();
+        }
+    }
+    catch (...)
+    {
+        spin_unlock(&registry_lock);
+        throw;
+    }
+    spin_unlock(&registry_lock);
+    if (!oReport)
+    {
+        return;
+    }
+    unsigned int members = 0;
+    for (std::set<type_info_base const *>::iterator ptr(seen.begin()), end(seen.end()); ptr != end; ++ptr)
+    {
+        members += (unsigned int)((*ptr)->end() - (*ptr)->begin());
+        bytes += (*ptr)->metadata_bytes();
+    }
+    oReport->types = (unsigned int)seen.size();
+    oReport->members = members;
+    oReport->protocols = nprotos;
+    oReport->pdus = pdus;
+    oReport->metadata_bytes = bytes;
+    oReport->elapsed_ns = clock_ns() - start;
+}
+
+type_info_base const *find_type(char const *name)
+{
+    spin_lock(&registry_lock);
+    std::vector<type_info_getter> types(registered_types());
+    spin_unlock(&registry_lock);
+    for (size_t i = 0; i != types.size(); ++i)
+    {
+        type_info_base const &ti = (*types[i])();
+        if (!strcmp(ti.name(), name))
+        {
+            return &ti;
+        }
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,51 @@
+
+#if !defined(introspection_registry_h)
+#define introspection_registry_h
+
+#include <introspection/introspection.h>
+
+/* The registry knows every INTROSPECTION type linked into the program, and
+   every protocol_t that exists. Type info is normally built the first time
+   member_info() is called, which puts the cost (and the heap allocations)
+   on the first message of each type a server sees. Call warm_up() before
+   serving to build it all up front; that also keeps the function-local
+   statics from being constructed concurrently on compilers that don't make
+   that thread safe.
+   */
+
+namespace introspection
+{
+    struct warm_up_report_t
+    {
+        unsigned int types;
+        unsigned int members;
+        unsigned int protocols;
+        unsigned int pdus;
+        unsigned long long metadata_bytes;
+        unsigned long long elapsed_ns;
+
+        INTROSPECTION(warm_up_report_t, \
+            MEMBER(types, "introspected types, including ones only reachable as members") \
+            MEMBER(members, "members of those types") \
+            MEMBER(protocols, "protocols") \
+            MEMBER(pdus, "PDU codes in those protocols") \
+            MEMBER(metadata_bytes, "approximate memory used by the type info and code tables") \
+            MEMBER(elapsed_ns, "time warm_up() took") \
+            );
+    };
+
+    /* Build the type info of every registered type, and of every type and
+     * collection those refer to. Cheap to call again; the report is then of
+     * what is already there.
+     */
+    void warm_up(warm_up_report_t *oReport = 0);
+
+    /* the registered type with the given name, or 0 (builds it if needed) */
+    type_info_base const *find_type(char const *name);
+
+    /* called by protocol_t as instances come and go */
+    void register_protocol(protocol_t *proto);
+    void unregister_protocol(protocol_t *proto);
+}
+
+#endif  //  introspection_registry_h
@@ -83,6 +83,79 @@ struct UserLeftPacket
         );
 };
 
+/* An administrator asking the server how it's doing. The server answers
+   with ServerStats, and only to connections from its own host. */
+struct ServerStatsRequest
+{
+    int version;
+
+    INTROSPECTION(ServerStatsRequest, \
+        MEMBER(version, "version of protocol") \
+        );
+};
+
+struct CountByReason
+{
+    std::string reason;
+    unsigned long long count;
+
+    INTROSPECTION(CountByReason, \
+        MEMBER(reason, "what happened") \
+        MEMBER(count, "how many times") \
+        );
+};
+
+/* Counters are since the server started; the rest are as of now, except
+   the rates, which are over the last few seconds. */
+struct ServerStats
+{
+    unsigned int shards;
+    unsigned long long uptime_s;
+    unsigned int connections;
+    unsigned int logged_in;
+    unsigned long long accepts;
+    unsigned long long refused;
+    std::vector<CountByReason> kicks;
+    unsigned long long timeouts;
+    unsigned long long disconnects;
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+    unsigned long long frames_in;
+    unsigned long long frames_out;
+    unsigned long long frames_dropped;
+    unsigned int frames_in_per_s;
+    unsigned int frames_out_per_s;
+    unsigned int queue_depth;
+    unsigned long long queued_bytes;
+    unsigned long long peak_queued_bytes;
+    unsigned int throttled;
+    std::vector<unsigned long long> tick_ns_log2;
+
+    INTROSPECTION(ServerStats, \
+        MEMBER(shards, "server threads") \
+        MEMBER(uptime_s, "seconds since the server started") \
+        MEMBER(connections, "connections open") \
+        MEMBER(logged_in, "connections that have logged in") \
+        MEMBER(accepts, "connections accepted") \
+        MEMBER(refused, "connections closed at once, for want of room") \
+        MEMBER(kicks, "connections closed by the server, by reason") \
+        MEMBER(timeouts, "connections closed for being idle") \
+        MEMBER(disconnects, "connections closed by the other end") \
+        MEMBER(bytes_in, "bytes received") \
+        MEMBER(bytes_out, "bytes sent") \
+        MEMBER(frames_in, "frames received") \
+        MEMBER(frames_out, "frames queued to be sent") \
+        MEMBER(frames_dropped, "chat frames not sent to users who were behind") \
+        MEMBER(frames_in_per_s, "frames received per second, lately") \
+        MEMBER(frames_out_per_s, "frames queued per second, lately") \
+        MEMBER(queue_depth, "messages waiting to be broadcast") \
+        MEMBER(queued_bytes, "bytes waiting to be sent, all users together") \
+        MEMBER(peak_queued_bytes, "the most one user has had waiting to be sent") \
+        MEMBER(throttled, "users who are behind, and only get logins and logouts") \
+        MEMBER(tick_ns_log2, "server loop time, not counting the wait; bucket i is [2^i, 2^(i+1)) ns") \
+        );
+};
+
 using namespace introspection;
 
 
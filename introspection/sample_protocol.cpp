@@ -8,6 +8,12 @@ PROTOCOL(my_proto, \
     PDU(SaySomethingPacket) \
     PDU(SomeoneSaidSomethingPacket) \
     PDU(UserJoinedPacket) \
-    PDU(UserLeftPacket)
+    PDU(UserLeftPacket) \
+    PDU(ServerStatsRequest) \
+    PDU(ServerStats)
     );
 
+#if defined(INTROSPECTION_GENERATED_CODECS)
+/* straight-line codecs for my_proto, written by the codegen tool (make GENERATED=1) */
+#include <my_proto_codecs.cpp>
+#endif
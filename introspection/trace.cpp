@@ -0,0 +1,286 @@
+
+#include <introspection/trace.h>
+#include <introspection/lockfree.h>
+#include <introspection/protocol_stats.h>
+#include <stdio.h>
+
+namespace introspection
+{
+
+long volatile trace_level_;
+
+/* what goes in the ring: the same as trace_event_t, without the strings
+   and vectors that make that one easy to save */
+struct trace_entry
+{
+    unsigned long long ns;
+    int point;
+    int fd;
+    long long bytes;
+};
+
+/* One per thread that has recorded anything, kept until the program exits.
+   Only the owner writes head_ (and the entries); anyone may read them. An
+   entry is good once head_ has moved past it, until head_ has gone round
+   the ring and come back to it. */
+struct trace_ring
+{
+    trace_ring *next;
+    long thread;
+    long volatile head_;
+    long volatile start_;
+    trace_entry entries[TRACE_RING_EVENTS];
+};
+
+static void *volatile rings;
+static INTROSPECTION_THREAD_LOCAL trace_ring *tls_ring;
+
+//  plain arrays, so they're good before any constructors have run
+static char const *point_names[MAX_TRACE_POINTS];
+static int point_levels[MAX_TRACE_POINTS];
+static long volatile point_count;
+
+static int const TRACE_MAGIC = 0x63727469;    //  "itrc"
+
+void set_trace_level(int level)
+{
+    atomic_store_release(&trace_level_, level);
+}
+
+static trace_ring *new_ring()
+{
+    trace_ring *r = new trace_ring();
+    r->thread = this_thread_serial();
+    r->head_ = 0;
+    r->start_ = 0;
+    while (true)
+    {
+        void *head = atomic_load_ptr_acquire(&rings);
+        r->next = (trace_ring *)head;
+        if (atomic_cas_ptr(&rings, head, r))
+        {
+            return r;
+        }
+    }
+}
+
+void trace_record(int point, int fd, long long bytes)
+{
+    trace_ring *r = tls_ring;
+    if (!r)
+    {
+        r = tls_ring = new_ring();
+    }
+    unsigned long h = (unsigned long)r->head_;
+    trace_entry &e = r->entries[h & (TRACE_RING_EVENTS - 1)];
+    e.ns = clock_ns();
+    e.point = point;
+    e.fd = fd;
+    e.bytes = bytes;
+    atomic_store_release(&r->head_, (long)(h + 1));
+}
+
+trace_point::trace_point(char const *name, int level) :
+    id_(atomic_increment(&point_count) - 1),
+    name_(name),
+    level_(level)
+{
+    if (id_ >= MAX_TRACE_POINTS)
+    {
+        throw std::runtime_error("too many trace points");
+    }
+    point_levels[id_] = level;
+    atomic_store_ptr_release((void *volatile *)&point_names[id_], (void *)name);
+}
+
+void trace_snapshot(trace_t &oTrace)
+{
+    oTrace.points.clear();
+    oTrace.threads.clear();
+    long npoints = atomic_load_acquire(&point_count);
+    for (long i = 0; i < npoints && i < MAX_TRACE_POINTS; ++i)
+    {
+        char const *name = (char const *)atomic_load_ptr_acquire((void *volatile *)&point_names[i]);
+        if (name)
+        {
+            trace_point_t tp;
+            tp.id = (unsigned int)i;
+            tp.name = name;
+            tp.level = point_levels[i];
+            oTrace.points.push_back(tp);
+        }
+    }
+    std::vector<trace_entry> copy(TRACE_RING_EVENTS);
+    for (trace_ring *r = (trace_ring *)atomic_load_ptr_acquire(&rings); r; r = r->next)
+    {
+        //  the oldest slot is the one the owner writes next, so it's never
+        //  safe to take
+        unsigned long start = (unsigned long)r->start_;
+        unsigned long before = (unsigned long)atomic_load_acquire(&r->head_);
+        if (before - start >= TRACE_RING_EVENTS)
+        {
+            start = before - TRACE_RING_EVENTS + 1;
+        }
+        for (unsigned long i = start; i != before; ++i)
+        {
+            copy[i & (TRACE_RING_EVENTS - 1)] = r->entries[i & (TRACE_RING_EVENTS - 1)];
+        }
+        //  whatever the owner got to while we copied may be torn
+        unsigned long after = (unsigned long)atomic_load_acquire(&r->head_);
+        if (after - start >= TRACE_RING_EVENTS)
+        {
+            start = after - TRACE_RING_EVENTS + 1;
+        }
+        trace_thread_t tt;
+        tt.thread = (unsigned int)r->thread;
+        tt.recorded = before - (unsigned long)r->start_;
+        //  nothing is left if the owner went round the whole ring meanwhile
+        if ((long)(before - start) > 0)
+        {
+            tt.events.reserve(before - start);
+            for (unsigned long i = start; i != before; ++i)
+            {
+                trace_entry const &e = copy[i & (TRACE_RING_EVENTS - 1)];
+                trace_event_t te;
+                te.ns = e.ns;
+                te.point = (unsigned int)e.point;
+                te.fd = e.fd;
+                te.bytes = e.bytes;
+                tt.events.push_back(te);
+            }
+        }
+        oTrace.threads.push_back(tt);
+    }
+}
+
+void trace_clear()
+{
+    for (trace_ring *r = (trace_ring *)atomic_load_ptr_acquire(&rings); r; r = r->next)
+    {
+        r->start_ = atomic_load_acquire(&r->head_);
+    }
+}
+
+void trace_write(trace_t const &trace, stream &oStr)
+{
+    marshal<int, false>::output(TRACE_MAGIC, oStr);
+    trace_t::member_info().access().get_from(&trace, oStr);
+}
+
+void trace_read(stream &iStr, trace_t &oTrace)
+{
+    int magic = 0;
+    marshal<int, false>::input(magic, iStr);
+    if (magic != TRACE_MAGIC)
+    {
+        throw std::runtime_error("not a trace in trace_read()");
+    }
+    trace_t::member_info().access().put_to(&oTrace, iStr);
+}
+
+void trace_summarize(trace_t const &trace, std::vector<trace_summary_t> &oSummary)
+{
+    oSummary.clear();
+    //  indexed by point; an event may name a point the trace doesn't know
+    std::vector<trace_summary_t> all;
+    for (size_t t = 0; t != trace.threads.size(); ++t)
+    {
+        std::vector<trace_event_t> const &ev = trace.threads[t].events;
+        for (size_t i = 0; i != ev.size(); ++i)
+        {
+            while (ev[i].point >= all.size())
+            {
+                trace_summary_t s;
+                s.count = 0;
+                s.bytes = 0;
+                s.count_after = 0;
+                s.ns_after = 0;
+                s.max_ns_after = 0;
+                all.push_back(s);
+            }
+            trace_summary_t &s = all[ev[i].point];
+            ++s.count;
+            s.bytes += ev[i].bytes;
+            if (i + 1 != ev.size())
+            {
+                unsigned long long d = ev[i + 1].ns - ev[i].ns;
+                ++s.count_after;
+                s.ns_after += d;
+                if (d > s.max_ns_after)
+                {
+                    s.max_ns_after = d;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i != trace.points.size(); ++i)
+    {
+        if (trace.points[i].id < all.size())
+        {
+            all[trace.points[i].id].name = trace.points[i].name;
+        }
+    }
+    for (size_t i = 0; i != all.size(); ++i)
+    {
+        if (all[i].count)
+        {
+            if (all[i].name.empty())
+            {
+                all[i].name = "?";
+            }
+            oSummary.push_back(all[i]);
+        }
+    }
+}
+
+void to_text(trace_t const &trace, std::string &oText)
+{
+    std::vector<std::string> names;
+    for (size_t i = 0; i != trace.points.size(); ++i)
+    {
+        if (trace.points[i].id >= names.size())
+        {
+            names.resize(trace.points[i].id + 1);
+        }
+        names[trace.points[i].id] = trace.points[i].name;
+    }
+    unsigned long long first = 0;
+    for (size_t t = 0; t != trace.threads.size(); ++t)
+    {
+        if (!trace.threads[t].events.empty() && (!first || trace.threads[t].events[0].ns < first))
+        {
+            first = trace.threads[t].events[0].ns;
+        }
+    }
+    char buf[200];
+    for (size_t t = 0; t != trace.threads.size(); ++t)
+    {
+        trace_thread_t const &tt = trace.threads[t];
+        sprintf(buf, "thread %u: %llu events, %u kept\n", tt.thread, tt.recorded, (unsigned int)tt.events.size());
+        oText += buf;
+        for (size_t i = 0; i != tt.events.size(); ++i)
+        {
+            trace_event_t const &e = tt.events[i];
+            sprintf(buf, "%14.3f us  %-16s fd %-5d %lld\n", (e.ns - first) / 1000.0,
+                e.point < names.size() && !names[e.point].empty() ? names[e.point].c_str() : "?",
+                e.fd, e.bytes);
+            oText += buf;
+        }
+    }
+}
+
+void to_text(std::vector<trace_summary_t> const &summary, std::string &oText)
+{
+    char buf[200];
+    sprintf(buf, "%-16s %10s %12s %12s %12s\n", "point", "count", "bytes", "avg us after", "max us after");
+    oText += buf;
+    for (size_t i = 0; i != summary.size(); ++i)
+    {
+        trace_summary_t const &s = summary[i];
+        sprintf(buf, "%-16s %10llu %12llu %12.3f %12.3f\n", s.name.c_str(), s.count, s.bytes,
+            s.count_after ? s.ns_after / 1000.0 / s.count_after : 0.0, s.max_ns_after / 1000.0);
+        oText += buf;
+    }
+}
+
+}
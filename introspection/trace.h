@@ -0,0 +1,163 @@
+
+#if !defined(introspection_trace_h)
+#define introspection_trace_h
+
+#include <introspection/introspection.h>
+
+/* Tracing: where the time goes in a running program, cheaply enough to
+   leave in. A trace_point is a named event with a level; calling it
+   records a 24 byte binary event (the time, the point, a socket or other
+   handle, and a byte count) in a ring buffer of the calling thread, if
+   the point's level is at or below the current trace level. Each ring has
+   one writer, so recording is a few stores and no locks; when the ring is
+   full, the oldest events are overwritten. With tracing off, a trace point
+   costs a load and a compare.
+
+   trace_snapshot() copies every thread's ring, from any thread, while they
+   keep recording; the result is introspected, so it can be written to a
+   file with trace_write(), and read back, printed or summarized elsewhere.
+   */
+
+namespace introspection
+{
+    enum
+    {
+        TRACE_OFF = 0,
+        /* things that happen now and then: connections, timeouts */
+        TRACE_INFO = 1,
+        /* every turn of an event loop, and every socket event */
+        TRACE_DEBUG = 2,
+        /* every message */
+        TRACE_VERBOSE = 3
+    };
+
+    /* the size of each thread's ring (a power of two); a snapshot gets at 
+       most one less, the oldest being the one the thread writes next */
+    enum { TRACE_RING_EVENTS = 16384 };
+    /* how many trace points a program can have */
+    enum { MAX_TRACE_POINTS = 256 };
+
+    extern long volatile trace_level_;
+
+    inline int trace_level()
+    {
+        return (int)trace_level_;
+    }
+    /* may be called at any time, from any thread (or a signal handler) */
+    void set_trace_level(int level);
+    void trace_record(int point, int fd, long long bytes);
+
+    /* Make these at file scope, so they're all known before anything is
+       recorded. */
+    class trace_point
+    {
+        public:
+            trace_point(char const *name, int level);
+            inline void operator()(int fd = -1, long long bytes = 0) const
+            {
+                if (level_ <= trace_level_)
+                {
+                    trace_record(id_, fd, bytes);
+                }
+            }
+            inline int id() const { return id_; }
+            inline char const *name() const { return name_; }
+            inline int level() const { return level_; }
+
+        private:
+            trace_point(trace_point const &);
+            trace_point &operator=(trace_point const &);
+            int id_;
+            char const *name_;
+            int level_;
+    };
+
+    struct trace_point_t
+    {
+        unsigned int id;
+        std::string name;
+        int level;
+
+        INTROSPECTION(trace_point_t, \
+            MEMBER(id, "trace point number, as used in events") \
+            MEMBER(name, "trace point name") \
+            MEMBER(level, "the trace level at which it's recorded") \
+            );
+    };
+
+    struct trace_event_t
+    {
+        unsigned long long ns;
+        unsigned int point;
+        int fd;
+        long long bytes;
+
+        INTROSPECTION(trace_event_t, \
+            MEMBER(ns, "monotonic clock, nanoseconds") \
+            MEMBER(point, "trace point number") \
+            MEMBER(fd, "socket or other handle, -1 for none") \
+            MEMBER(bytes, "byte count, or other quantity") \
+            );
+    };
+
+    struct trace_thread_t
+    {
+        unsigned int thread;
+        unsigned long long recorded;
+        std::vector<trace_event_t> events;
+
+        INTROSPECTION(trace_thread_t, \
+            MEMBER(thread, "thread serial number") \
+            MEMBER(recorded, "events recorded since the ring was cleared, including ones overwritten") \
+            MEMBER(events, "the events still in the ring, oldest first") \
+            );
+    };
+
+    struct trace_t
+    {
+        std::vector<trace_point_t> points;
+        std::vector<trace_thread_t> threads;
+
+        INTROSPECTION(trace_t, \
+            MEMBER(points, "every trace point in the program") \
+            MEMBER(threads, "every thread that recorded something") \
+            );
+    };
+
+    /* what one trace point cost, over all threads */
+    struct trace_summary_t
+    {
+        std::string name;
+        unsigned long long count;
+        unsigned long long bytes;
+        unsigned long long count_after;
+        unsigned long long ns_after;
+        unsigned long long max_ns_after;
+
+        INTROSPECTION(trace_summary_t, \
+            MEMBER(name, "trace point name") \
+            MEMBER(count, "events") \
+            MEMBER(bytes, "sum of the byte counts") \
+            MEMBER(count_after, "events that were followed by another on their thread") \
+            MEMBER(ns_after, "total time from each event to the next one on its thread") \
+            MEMBER(max_ns_after, "the longest time from one event to the next one on its thread") \
+            );
+    };
+
+    /* copy what's in every thread's ring */
+    void trace_snapshot(trace_t &oTrace);
+    /* forget what's been recorded so far */
+    void trace_clear();
+    /* the binary form, for saving */
+    void trace_write(trace_t const &trace, stream &oStr);
+    /* throws if it isn't a trace */
+    void trace_read(stream &iStr, trace_t &oTrace);
+    /* one entry for each point that has events, in point order */
+    void trace_summarize(trace_t const &trace, std::vector<trace_summary_t> &oSummary);
+    /* one line per event, with times relative to the first event */
+    void to_text(trace_t const &trace, std::string &oText);
+    /* one line per point */
+    void to_text(std::vector<trace_summary_t> const &summary, std::string &oText);
+}
+
+#endif  //  introspection_trace_h
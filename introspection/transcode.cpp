@@ -0,0 +1,374 @@
+
+#include <introspection/transcode.h>
+
+
+namespace introspection
+{
+
+void append_decimal(unsigned long long v, std::string &oStr)
+{
+    char tmp[24];
+    char *end = tmp + sizeof(tmp);
+    char *ptr = end;
+    do
+    {
+        *--ptr = (char)('0' + v % 10);
+        v /= 10;
+    }
+    while (v);
+    oStr.append(ptr, end);
+}
+
+void append_decimal(long long v, std::string &oStr)
+{
+    if (v < 0)
+    {
+        oStr += '-';
+        append_decimal(0ULL - (unsigned long long)v, oStr);
+    }
+    else
+    {
+        append_decimal((unsigned long long)v, oStr);
+    }
+}
+
+static char const *skip_space(char const *str)
+{
+    while (*str && isspace(*str))
+    {
+        ++str;
+    }
+    return str;
+}
+
+//  the count goes before the elements, but isn't known until they're written
+static size_t begin_count(stream &oStr)
+{
+    size_t at = oStr.position();
+    unsigned int cnt = 0;
+    marshal<unsigned int, false>::output(cnt, oStr);
+    return at;
+}
+
+static void end_count(stream &oStr, size_t at, unsigned int cnt)
+{
+    size_t end = oStr.position();
+    oStr.set_position(at);
+    marshal<unsigned int, false>::output(cnt, oStr);
+    oStr.set_position(end);
+}
+
+void member_access_base::wire_to_text(stream &iStr, std::string &oStr) const
+{
+    if (collection_)
+    {
+        unsigned int cnt = 0;
+        marshal<unsigned int, false>::input(cnt, iStr);
+        member_access_base const &elem = collection_->element_access();
+        oStr += "{ ";
+        while (cnt-- > 0)
+        {
+            elem.wire_to_text(iStr, oStr);
+        }
+        oStr += "} ";
+    }
+    else if (base_)
+    {
+        type_info_base const &ti = member_info();
+        oStr += "[ ";
+        for (member_t::iterator ptr(ti.begin()), end(ti.end()); ptr != end; ++ptr)
+        {
+            (*ptr).access().wire_to_text(iStr, oStr);
+        }
+        oStr += "] ";
+    }
+    else
+    {
+        do_wire_to_text(iStr, oStr);
+    }
+}
+
+void member_access_base::wire_to_json(stream &iStr, json_writer &w) const
+{
+    if (collection_)
+    {
+        unsigned int cnt = 0;
+        marshal<unsigned int, false>::input(cnt, iStr);
+        member_access_base const &elem = collection_->element_access();
+        w.begin_array();
+        while (cnt-- > 0)
+        {
+            elem.wire_to_json(iStr, w);
+        }
+        w.end_array();
+    }
+    else if (base_)
+    {
+        type_info_base const &ti = member_info();
+        w.begin_object();
+        for (member_t::iterator ptr(ti.begin()), end(ti.end()); ptr != end; ++ptr)
+        {
+            w.key((*ptr).name());
+            (*ptr).access().wire_to_json(iStr, w);
+        }
+        w.end_object();
+    }
+    else
+    {
+        do_wire_to_json(iStr, w);
+    }
+}
+
+char const *member_access_base::text_to_wire(char const *str, stream &oStr) const
+{
+    str = skip_space(str);
+    if (collection_)
+    {
+        if (*str != '{')
+        {
+            throw std::runtime_error("bad format for collection in text_to_wire (no open brace)");
+        }
+        ++str;
+        member_access_base const &elem = collection_->element_access();
+        size_t at = begin_count(oStr);
+        unsigned int cnt = 0;
+        while (true)
+        {
+            str = skip_space(str);
+            if (!*str)
+            {
+                throw std::runtime_error("early input data end in text_to_wire");
+            }
+            if (*str == '}')
+            {
+                ++str;
+                break;
+            }
+            str = elem.text_to_wire(str, oStr);
+            ++cnt;
+        }
+        end_count(oStr, at, cnt);
+        return str;
+    }
+    if (base_)
+    {
+        if (*str != '[')
+        {
+            throw std::runtime_error("missing bracket in structure text_to_wire");
+        }
+        ++str;
+        type_info_base const &ti = member_info();
+        for (member_t::iterator ptr(ti.begin()), end(ti.end()); ptr != end; ++ptr)
+        {
+            str = skip_space(str);
+            if (!*str)
+            {
+                throw std::runtime_error("underflow in structure text_to_wire");
+            }
+            str = (*ptr).access().text_to_wire(str, oStr);
+        }
+        str = skip_space(str);
+        if (*str != ']')
+        {
+            throw std::runtime_error("missing end bracket in structure text_to_wire");
+        }
+        return str + 1;
+    }
+    return do_text_to_wire(str, oStr);
+}
+
+//  JSON keys can come in any order, but the binary form is in member order.
+//  Members are written straight through while the keys are in order (which
+//  is what json_writer produces); a member that arrives early is written to
+//  a side stream until its turn comes. Members that are missing get their
+//  default value, from an instance that is only constructed if needed.
+struct json_struct_state
+{
+    json_struct_state(type_info_base const &ti) :
+        ti_(ti),
+        dflt_(0)
+    {
+    }
+    ~json_struct_state()
+    {
+        if (dflt_)
+        {
+            ti_.access().destroy(dflt_);
+            ::operator delete(dflt_);
+        }
+        for (size_t i = 0; i != early_.size(); ++i)
+        {
+            delete early_[i];
+        }
+    }
+    void const *dflt()
+    {
+        if (!dflt_)
+        {
+            void *ptr = ::operator new(ti_.access().size());
+            try
+            {
+                ti_.access().create(ptr);
+            }
+            catch (...)
+            {
+                ::operator delete(ptr);
+                throw;
+            }
+            dflt_ = ptr;
+        }
+        return dflt_;
+    }
+    type_info_base const &ti_;
+    void *dflt_;
+    std::vector<simple_stream *> early_;
+};
+
+static void json_struct_to_wire(type_info_base const &ti, json_reader &r, stream &oStr)
+{
+    json_struct_state st(ti);
+    std::vector<simple_stream *> &early = st.early_;
+    size_t count = ti.end() - ti.begin();
+    size_t next = 0;
+    r.begin_object();
+    bool first = true;
+    char const *name;
+    size_t len;
+    while (r.next_key(first, name, len))
+    {
+        member_t const *m = ti.find_member(name, len);
+        if (!m)
+        {
+            r.skip_value();
+            continue;
+        }
+        size_t ix = m - ti.begin();
+        if (ix < next || (early.size() && early[ix]))
+        {
+            throw std::runtime_error("JSON: duplicate key in json_to_wire");
+        }
+        if (ix > next)
+        {
+            early.resize(count);
+            early[ix] = new simple_stream();
+            m->access().json_to_wire(r, *early[ix]);
+            continue;
+        }
+        m->access().json_to_wire(r, oStr);
+        ++next;
+        while (next < early.size() && early[next])
+        {
+            oStr.write_bytes(early[next]->position(), early[next]->unsafe_data());
+            ++next;
+        }
+    }
+    for (; next != count; ++next)
+    {
+        if (next < early.size() && early[next])
+        {
+            oStr.write_bytes(early[next]->position(), early[next]->unsafe_data());
+        }
+        else
+        {
+            ti.begin()[next].access().get_from(st.dflt(), oStr);
+        }
+    }
+}
+
+void member_access_base::json_to_wire(json_reader &r, stream &oStr) const
+{
+    if (collection_)
+    {
+        member_access_base const &elem = collection_->element_access();
+        size_t at = begin_count(oStr);
+        unsigned int cnt = 0;
+        r.begin_array();
+        bool first = true;
+        while (r.next_element(first))
+        {
+            elem.json_to_wire(r, oStr);
+            ++cnt;
+        }
+        end_count(oStr, at, cnt);
+    }
+    else if (base_)
+    {
+        json_struct_to_wire(member_info(), r, oStr);
+    }
+    else
+    {
+        do_json_to_wire(r, oStr);
+    }
+}
+
+static int code_for_name(protocol_t &proto, char const *name, size_t len)
+{
+    for (int code = 1; code <= proto.pdu_count(); ++code)
+    {
+        char const *n = proto.type(code).name();
+        if (!strncmp(n, name, len) && n[len] == 0)
+        {
+            return code;
+        }
+    }
+    throw std::runtime_error(std::string("unknown PDU name in transcode: ") + std::string(name, len));
+}
+
+int transcode_to_text(protocol_t &proto, stream &iStr, std::string &oStr)
+{
+    int code = 0;
+    marshal<int, false>::input(code, iStr);
+    type_info_base const &ti = proto.type(code);
+    oStr += ti.name();
+    oStr += ' ';
+    ti.access().wire_to_text(iStr, oStr);
+    return code;
+}
+
+int transcode_to_json(protocol_t &proto, stream &iStr, json_writer &w)
+{
+    int code = 0;
+    marshal<int, false>::input(code, iStr);
+    type_info_base const &ti = proto.type(code);
+    w.begin_object();
+    w.key(ti.name());
+    ti.access().wire_to_json(iStr, w);
+    w.end_object();
+    return code;
+}
+
+int transcode_from_text(protocol_t &proto, char const *&str, stream &oStr)
+{
+    char const *name = skip_space(str);
+    char const *end = name;
+    while (*end && !isspace(*end) && *end != '[')
+    {
+        ++end;
+    }
+    int code = code_for_name(proto, name, end - name);
+    marshal<int, false>::output(code, oStr);
+    str = proto.type(code).access().text_to_wire(end, oStr);
+    return code;
+}
+
+int transcode_from_json(protocol_t &proto, json_reader &r, stream &oStr)
+{
+    r.begin_object();
+    bool first = true;
+    char const *name;
+    size_t len;
+    if (!r.next_key(first, name, len))
+    {
+        throw std::runtime_error("JSON: empty object where a PDU was expected");
+    }
+    int code = code_for_name(proto, name, len);
+    marshal<int, false>::output(code, oStr);
+    proto.type(code).access().json_to_wire(r, oStr);
+    if (r.next_key(first, name, len))
+    {
+        throw std::runtime_error("JSON: more than one key in a PDU object");
+    }
+    return code;
+}
+
+}
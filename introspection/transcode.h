@@ -0,0 +1,33 @@
+
+#if !defined(introspection_transcode_h)
+#define introspection_transcode_h
+
+#include <introspection/introspection.h>
+
+/* The transcoder converts PDUs between the binary form that protocol_t
+   encodes and the text or JSON forms, walking the member info of the PDU
+   type rather than decoding into an instance and printing that. Only one
+   scalar at a time is ever materialized, so dumping a capture costs about
+   what parsing it does.
+
+   The text form of a PDU is its type name followed by what to_text()
+   produces for it; the JSON form is an object with the type name as the
+   only key, and to_json() of the PDU as the value. Going back to binary,
+   the output stream must support set_position(), because the count of a
+   collection is written after its elements have been counted.
+   */
+
+namespace introspection
+{
+    /* Read one PDU from iStr, and append its text to oStr. Returns the code. */
+    int transcode_to_text(protocol_t &proto, stream &iStr, std::string &oStr);
+    int transcode_to_json(protocol_t &proto, stream &iStr, json_writer &w);
+
+    /* Parse one PDU at str, and write its binary form to oStr. Returns the
+     * code; str is moved past the PDU.
+     */
+    int transcode_from_text(protocol_t &proto, char const *&str, stream &oStr);
+    int transcode_from_json(protocol_t &proto, json_reader &r, stream &oStr);
+}
+
+#endif  //  introspection_transcode_h
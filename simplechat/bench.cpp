@@ -0,0 +1,243 @@
+
+#if defined(_MSC_VER)
+#include <WinSock2.h>
+#include <Windows.h>
+typedef int w32_socklen_t;
+#else
+#include <introspection/not_win32.h>
+#endif
+#include <stdio.h>
+#include <algorithm>
+#include <introspection/sample_chat.h>
+#include <introspection/protocol_stats.h>
+#include "userlist.h"
+#include "reactor.h"
+
+EXTERN_PROTOCOL(my_proto);
+
+/* The bench logs in as every user in the user list at once, and has each
+   of them say something as soon as it has heard its last message come
+   back from the server. The time from sending a message to hearing it is
+   one sample; at the end it prints how many there were, and the median
+   and 99th percentile. Run it against a server on each backend to compare
+   them (the server prints its system calls per frame every ten seconds).
+   */
+class BenchClient
+{
+    public:
+        BenchClient() :
+            sock_(-1),
+            qoff_(0),
+            qsize_(0),
+            seq_(0),
+            sentAt_(0),
+            samples_(0)
+        {
+            dispatcher_.recycle_pdus(true);
+            dispatcher_.add_handler(my_proto, this, &BenchClient::OnConnected);
+            dispatcher_.add_handler(my_proto, this, &BenchClient::OnSomeoneSaidSomething);
+            dispatcher_.add_handler(my_proto, this, &BenchClient::OnUserJoined);
+            dispatcher_.add_handler(my_proto, this, &BenchClient::OnUserLeft);
+        }
+
+        bool send_pdu_frame(simple_stream &ss)
+        {
+            unsigned char *p = (unsigned char *)ss.unsafe_data();
+            size_t sz = ss.position() - 2;
+            p[0] = (sz >> 8) & 0xff;
+            p[1] = sz & 0xff;
+            return ::send(sock_, (char const *)p, (int)(sz + 2), 0) == (int)(sz + 2);
+        }
+        bool login()
+        {
+            LoginPacket lp;
+            lp.name = name_;
+            lp.version = 1;
+            simple_stream ss;
+            ss.write_bytes(2, "\0");
+            my_proto.encode(lp, ss);
+            return send_pdu_frame(ss);
+        }
+        bool say_next()
+        {
+            char text[32];
+            sprintf(text, "bench %u", ++seq_);
+            expect_ = text;
+            SaySomethingPacket ssp;
+            ssp.message = expect_;
+            simple_stream ss;
+            ss.write_bytes(2, "\0");
+            my_proto.encode(ssp, ss);
+            sentAt_ = introspection::clock_ns();
+            return send_pdu_frame(ss);
+        }
+        /* read what's there; false if the connection is gone */
+        bool service()
+        {
+            while (true)
+            {
+                int r = recv(sock_, (char *)&buf_[qoff_ + qsize_], (int)(sizeof(buf_) - qoff_ - qsize_), 0);
+                if (r < 0 && would_block())
+                {
+                    return true;
+                }
+                if (r < 1)
+                {
+                    return false;
+                }
+                qsize_ += r;
+                while (qsize_ >= 2)
+                {
+                    int len = (buf_[qoff_] << 8) | buf_[qoff_ + 1];
+                    if (qsize_ < len + 2)
+                    {
+                        break;
+                    }
+                    introspection::readonly_stream rs(&buf_[qoff_ + 2], len);
+                    while (rs.bytes_left() > 0)
+                    {
+                        dispatcher_.decode_and_dispatch(my_proto, rs);
+                    }
+                    qoff_ += 2 + len;
+                    qsize_ -= 2 + len;
+                }
+                memmove(buf_, &buf_[qoff_], qsize_);
+                qoff_ = 0;
+            }
+        }
+
+        void OnConnected(ConnectedPacket const &cp)
+        {
+            say_next();
+        }
+        void OnSomeoneSaidSomething(SomeoneSaidSomethingPacket const &sssp)
+        {
+            if (sssp.who == name_ && sssp.what == expect_)
+            {
+                (*samples_).push_back(introspection::clock_ns() - sentAt_);
+                say_next();
+            }
+        }
+        void OnUserJoined(UserJoinedPacket const &)
+        {
+        }
+        void OnUserLeft(UserLeftPacket const &)
+        {
+        }
+
+        int sock_;
+        std::string name_;
+        unsigned char buf_[4096];
+        int qoff_;
+        int qsize_;
+        unsigned int seq_;
+        std::string expect_;
+        unsigned long long sentAt_;
+        std::vector<unsigned long long> *samples_;
+        introspection::dispatch_t dispatcher_;
+};
+
+static void usage()
+{
+    fprintf(stderr, "usage: bench servername port [seconds]\n");
+}
+
+void do_bench(int argc, char const *argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        usage();
+        return;
+    }
+    int port = atoi(argv[2]);
+    int seconds = argc == 4 ? atoi(argv[3]) : 10;
+    if (port < 1 || port > 65535 || seconds < 1)
+    {
+        usage();
+        return;
+    }
+    if (!load_userlist())
+    {
+        fprintf(stderr, "can't load userlist.txt -- the bench logs in as the users in it\n");
+        return;
+    }
+    WSADATA wsad;
+    memset(&wsad, 0, sizeof(wsad));
+    if (WSAStartup(MAKEWORD(2, 2), &wsad) != 0)
+    {
+        fprintf(stderr, "WSAStartup() failed\n");
+        return;
+    }
+    struct hostent *hent = gethostbyname(argv[1]);
+    if (!hent)
+    {
+        fprintf(stderr, "%s: host not found\n", argv[1]);
+        return;
+    }
+    sockaddr_in sad;
+    memset(&sad, 0, sizeof(sad));
+    sad.sin_family = AF_INET;
+    memcpy(&sad.sin_addr, hent->h_addr_list[0], 4);
+    sad.sin_port = htons(port);
+
+    reactor *poller = reactor::create(0);
+    std::vector<unsigned long long> samples;
+    std::vector<BenchClient *> clients;
+    for (unsigned int i = 0; i != count_users(); ++i)
+    {
+        UserInfo ui;
+        get_user_by_index(i, ui);
+        BenchClient *bc = new BenchClient();
+        bc->name_ = ui.name;
+        bc->samples_ = &samples;
+        bc->sock_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (bc->sock_ < 0 || connect(bc->sock_, (sockaddr *)&sad, sizeof(sad)) < 0 || !bc->login() ||
+            !set_nonblocking(bc->sock_) || !poller->add(bc->sock_))
+        {
+            fprintf(stderr, "could not connect as %s\n", ui.name.c_str());
+            return;
+        }
+        clients.push_back(bc);
+    }
+
+    unsigned long long end = introspection::clock_ns() + (unsigned long long)seconds * 1000000000ULL;
+    while (introspection::clock_ns() < end)
+    {
+        reactor_event events[256];
+        int n = poller->wait(events, 256, 100);
+        for (int i = 0; i != n; ++i)
+        {
+            if (!(events[i].events & REACTOR_READ))
+            {
+                continue;
+            }
+            for (size_t j = 0; j != clients.size(); ++j)
+            {
+                if (clients[j]->sock_ == events[i].sock && !clients[j]->service())
+                {
+                    fprintf(stderr, "%s: lost connection\n", clients[j]->name_.c_str());
+                    return;
+                }
+            }
+        }
+    }
+    for (size_t j = 0; j != clients.size(); ++j)
+    {
+        closesocket(clients[j]->sock_);
+        delete clients[j];
+    }
+    delete poller;
+
+    if (samples.empty())
+    {
+        fprintf(stderr, "no messages made it back\n");
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    printf("%u clients, %u messages in %d s (%.0f/s), round trip p50 %.1f us, p99 %.1f us, max %.1f us\n",
+        (unsigned int)clients.size(), (unsigned int)samples.size(), seconds,
+        (double)samples.size() / seconds,
+        samples[samples.size() / 2] / 1000.0,
+        samples[samples.size() * 99 / 100] / 1000.0,
+        samples.back() / 1000.0);
+}
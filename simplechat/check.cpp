@@ -0,0 +1,173 @@
+#if defined(_MSC_VER)
+#include <WinSock2.h>
+#include <Windows.h>
+#else
+#include <introspection/not_win32.h>
+#endif
+#include <stdio.h>
+#include <introspection/sample_chat.h>
+#include "userlist.h"
+
+EXTERN_PROTOCOL(my_proto);
+
+/* Tries, against a running server, what a well behaved client doesn't
+   do, and says whether the server refused it: a second login on a
+   connection that is logged in already gets the connection kicked, and
+   leaves both names free to log in again. It logs in as the first two
+   users in the user list, so they must not be connected. Exits with 1 if
+   a check fails. */
+static void usage()
+{
+    fprintf(stderr, "usage: check servername port\n");
+}
+
+static void failed(char const *what, char const *who)
+{
+    fprintf(stderr, "FAILED: %s %s\n", what, who);
+    exit(1);
+}
+
+static bool recv_all(int sock, unsigned char *buf, size_t size)
+{
+    while (size > 0)
+    {
+        int r = recv(sock, (char *)buf, (int)size, 0);
+        if (r < 1)
+        {
+            return false;
+        }
+        buf += r;
+        size -= r;
+    }
+    return true;
+}
+
+static int connect_to(sockaddr_in const &sad)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0 || connect(sock, (sockaddr const *)&sad, sizeof(sad)) < 0)
+    {
+        failed("could not connect", "");
+    }
+    return sock;
+}
+
+static bool login(int sock, std::string const &name)
+{
+    LoginPacket lp;
+    lp.name = name;
+    lp.version = 1;
+    simple_stream ss;
+    ss.write_bytes(2, "\0");
+    my_proto.encode(lp, ss);
+    unsigned char *p = (unsigned char *)ss.unsafe_data();
+    size_t sz = ss.position() - 2;
+    p[0] = (sz >> 8) & 0xff;
+    p[1] = sz & 0xff;
+    return ::send(sock, (char const *)p, (int)(sz + 2), 0) == (int)(sz + 2);
+}
+
+/* Reads until a ConnectedPacket comes; false if the connection closes
+   first. Anything else that comes meanwhile is skipped. */
+static bool wait_connected(int sock)
+{
+    while (true)
+    {
+        unsigned char hdr[2];
+        std::vector<unsigned char> frame;
+        if (recv_all(sock, hdr, 2))
+        {
+            frame.resize((hdr[0] << 8) | hdr[1]);
+        }
+        if (frame.empty() || !recv_all(sock, &frame[0], frame.size()))
+        {
+            return false;
+        }
+        readonly_stream rs(&frame[0], frame.size());
+        while (rs.bytes_left() > 0)
+        {
+            void *pdu = 0;
+            int code = my_proto.decode_pooled(pdu, rs);
+            my_proto.release(code, pdu);
+            if (code == my_proto.code<ConnectedPacket>())
+            {
+                return true;
+            }
+        }
+    }
+}
+
+void do_check(int argc, char const *argv[])
+{
+    if (argc != 3)
+    {
+        usage();
+        return;
+    }
+    int port = atoi(argv[2]);
+    if (port < 1 || port > 65535)
+    {
+        usage();
+        return;
+    }
+    if (!load_userlist() || count_users() < 2)
+    {
+        fprintf(stderr, "the check logs in as the first two users in userlist.txt\n");
+        return;
+    }
+    UserInfo one, two;
+    get_user_by_index(0, one);
+    get_user_by_index(1, two);
+    WSADATA wsad;
+    memset(&wsad, 0, sizeof(wsad));
+    if (WSAStartup(MAKEWORD(2, 2), &wsad) != 0)
+    {
+        fprintf(stderr, "WSAStartup() failed\n");
+        return;
+    }
+    struct hostent *hent = gethostbyname(argv[1]);
+    if (!hent)
+    {
+        fprintf(stderr, "%s: host not found\n", argv[1]);
+        return;
+    }
+    sockaddr_in sad;
+    memset(&sad, 0, sizeof(sad));
+    sad.sin_family = AF_INET;
+    memcpy(&sad.sin_addr, hent->h_addr_list[0], 4);
+    sad.sin_port = htons(port);
+
+    try
+    {
+        //  a second login on the same connection gets it closed
+        int sock = connect_to(sad);
+        if (!login(sock, one.name) || !wait_connected(sock))
+        {
+            failed("could not log in as", one.name.c_str());
+        }
+        if (login(sock, two.name) && wait_connected(sock))
+        {
+            failed("a second login on one connection was let in as", two.name.c_str());
+        }
+        closesocket(sock);
+
+        //  and neither name is left logged in
+        int sock1 = connect_to(sad);
+        int sock2 = connect_to(sad);
+        if (!login(sock1, one.name) || !wait_connected(sock1))
+        {
+            failed("after a second login, could not log in again as", one.name.c_str());
+        }
+        if (!login(sock2, two.name) || !wait_connected(sock2))
+        {
+            failed("after a second login, could not log in again as", two.name.c_str());
+        }
+        closesocket(sock1);
+        closesocket(sock2);
+    }
+    catch (std::exception const &x)
+    {
+        failed("bad answer:", x.what());
+    }
+    printf("ok\n");
+}
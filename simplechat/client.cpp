@@ -62,6 +62,8 @@ static ClientHandler handler;
 
 static void setup_dispatch()
 {
+    /* decode each packet over the previous one of the same type, to save allocations */
+    dispatcher.recycle_pdus(true);
     /* add the four packets I'm prepared to deal with coming in to the dispatcher */
     dispatcher.add_handler<ConnectedPacket>(my_proto, &handler, &ClientHandler::OnConnected);
     dispatcher.add_handler<SomeoneSaidSomethingPacket>(my_proto, &handler, &ClientHandler::OnSomeoneSaidSomething);
@@ -72,13 +74,11 @@ static void setup_dispatch()
 static void decode_and_handle(void *data, size_t size)
 {
     introspection::readonly_stream ss(data, size);
-    char buf[256]; //  size of biggest struct in memory
     while (ss.bytes_left() > 0)
     {
-        /* decode the marshaled data based on the type code; return the type code */
-        int d = my_proto.decode(buf, sizeof(buf), ss);
-        /* dispatch to a handler based on the type code */
-        dispatcher.dispatch(d, buf);
+        /* decode the marshaled data based on the type code, and dispatch 
+           to a handler based on the type code */
+        dispatcher.decode_and_dispatch(my_proto, ss);
     }
 }
 
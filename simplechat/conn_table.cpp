@@ -0,0 +1,40 @@
+
+#include <introspection/lockfree.h>
+#include "conn_table.h"
+
+/* buffers a thread keeps for reuse, at most */
+const size_t MAX_FREE_BUFFERS = 1024;
+
+/* while it's on the free list, a buffer's first bytes link it */
+struct free_buffer
+{
+    free_buffer *next;
+};
+
+static INTROSPECTION_THREAD_LOCAL free_buffer *free_buffers;
+static INTROSPECTION_THREAD_LOCAL size_t free_buffer_count;
+
+unsigned char *take_recv_buffer()
+{
+    free_buffer *b = free_buffers;
+    if (b)
+    {
+        free_buffers = b->next;
+        --free_buffer_count;
+        return (unsigned char *)b;
+    }
+    return new unsigned char[RECV_BUFFER_SIZE];
+}
+
+void give_recv_buffer(unsigned char *buf)
+{
+    if (free_buffer_count >= MAX_FREE_BUFFERS)
+    {
+        delete[] buf;
+        return;
+    }
+    free_buffer *b = (free_buffer *)buf;
+    b->next = free_buffers;
+    free_buffers = b;
+    ++free_buffer_count;
+}
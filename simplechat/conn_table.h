@@ -0,0 +1,111 @@
+
+#if !defined(simplechat_conn_table_h)
+#define simplechat_conn_table_h
+
+#include <stddef.h>
+#include <vector>
+
+/* Where a server keeps its connections. The objects come from slabs of
+   SLAB_OBJECTS, made as the table grows and kept until it goes away, and
+   a connection that closes goes back on a free list still constructed, so
+   whatever it allocated for itself (handlers, string capacity) is there
+   for the next one; an accept allocates nothing once the table has been
+   that big before. A connection is found by its socket, which indexes an
+   array, and the live ones are also kept densely, so going over all of
+   them doesn't walk the holes. Removing one moves the last into its
+   place, so the order they're visited in changes.
+
+   T must be default constructible, and be ready for reuse once erased;
+   the table doesn't construct or destroy anything but whole slabs.
+   */
+template<typename T>
+class conn_table
+{
+    public:
+        enum { SLAB_OBJECTS = 64 };
+
+        conn_table()
+        {
+        }
+        ~conn_table()
+        {
+            for (size_t i = 0; i != slabs_.size(); ++i)
+            {
+                delete[] slabs_[i];
+            }
+        }
+        /* A free object, now the one for the socket (which must not have
+           one already). */
+        T *insert(int sock)
+        {
+            if (free_.empty())
+            {
+                T *slab = new T[SLAB_OBJECTS];
+                slabs_.push_back(slab);
+                for (int i = SLAB_OBJECTS; i != 0; --i)
+                {
+                    free_.push_back(&slab[i - 1]);
+                }
+            }
+            if ((size_t)sock >= bySock_.size())
+            {
+                bySock_.resize(sock + 1, 0);
+                liveAt_.resize(sock + 1, 0);
+            }
+            T *t = free_.back();
+            free_.pop_back();
+            bySock_[sock] = t;
+            liveAt_[sock] = live_.size();
+            live_.push_back(t);
+            liveSock_.push_back(sock);
+            return t;
+        }
+        /* the object for the socket, or null */
+        inline T *find(int sock) const
+        {
+            return sock >= 0 && (size_t)sock < bySock_.size() ? bySock_[sock] : 0;
+        }
+        /* the object goes back on the free list */
+        void erase(int sock)
+        {
+            T *t = find(sock);
+            if (!t)
+            {
+                return;
+            }
+            size_t at = liveAt_[sock];
+            live_[at] = live_.back();
+            liveSock_[at] = liveSock_.back();
+            liveAt_[liveSock_[at]] = at;
+            live_.pop_back();
+            liveSock_.pop_back();
+            bySock_[sock] = 0;
+            free_.push_back(t);
+        }
+        /* the live objects are at(0) to at(size() - 1) */
+        inline size_t size() const { return live_.size(); }
+        inline T *at(size_t i) const { return live_[i]; }
+        /* objects made, live or free */
+        inline size_t allocated() const { return slabs_.size() * SLAB_OBJECTS; }
+
+    private:
+        conn_table(conn_table const &);
+        conn_table &operator=(conn_table const &);
+        std::vector<T *> slabs_;
+        std::vector<T *> free_;
+        std::vector<T *> bySock_;
+        std::vector<size_t> liveAt_;
+        std::vector<T *> live_;
+        std::vector<int> liveSock_;
+};
+
+/* Receive buffers, for connections that have part of a frame. They come
+   from (and go back to) a free list for each thread, like the blocks of
+   a frame_queue, so a connection holds one only while a frame is arriving
+   in pieces, and an idle one holds none. */
+const size_t RECV_BUFFER_SIZE = 4096;
+
+unsigned char *take_recv_buffer();
+void give_recv_buffer(unsigned char *buf);
+
+#endif  //  simplechat_conn_table_h
@@ -0,0 +1,284 @@
+
+#if !defined(_MSC_VER)
+#include <introspection/not_win32.h>
+#include <sys/uio.h>
+#else
+#include <WinSock2.h>
+#include <Windows.h>
+#endif
+#include <introspection/lockfree.h>
+#include <new>
+#include <algorithm>
+#include "frame.h"
+
+shared_frame::shared_frame(size_t size, bool critical) :
+    refs_(1),
+    size_(size),
+    critical_(critical)
+{
+}
+
+shared_frame::~shared_frame()
+{
+}
+
+shared_frame *shared_frame::create(void const *data, size_t size)
+{
+    void *ptr = ::operator new(sizeof(shared_frame) + size);
+    shared_frame *frame = new (ptr) shared_frame(size, false);
+    memcpy((void *)frame->data(), data, size);
+    return frame;
+}
+
+shared_frame *shared_frame::from_stream(introspection::simple_stream &ss, bool critical)
+{
+    size_t sz = ss.position() - 2;
+    if (ss.position() < 2 || sz > 0xffff)
+    {
+        throw std::runtime_error("bad frame size in shared_frame::from_stream()");
+    }
+    unsigned char *p = (unsigned char *)ss.unsafe_data();
+    p[0] = (sz >> 8) & 0xff;
+    p[1] = sz & 0xff;
+    shared_frame *frame = create(p, sz + 2);
+    frame->critical_ = critical;
+    return frame;
+}
+
+void shared_frame::add_ref()
+{
+    introspection::atomic_increment(&refs_);
+}
+
+void shared_frame::release()
+{
+    if (introspection::atomic_add(&refs_, -1) == 0)
+    {
+        this->~shared_frame();
+        ::operator delete(this);
+    }
+}
+
+/* 32 words a block: a link, the used range, and the references */
+const int FRAME_BLOCK_REFS = 15;
+/* blocks a thread keeps for reuse, at most */
+const size_t MAX_FREE_BLOCKS = 4096;
+
+struct frame_block
+{
+    frame_block *next;
+    int begin;
+    int end;
+    frame_ref refs[FRAME_BLOCK_REFS];
+};
+
+//  a queue is only ever used by the thread that serves its connection
+static INTROSPECTION_THREAD_LOCAL frame_block *free_blocks;
+static INTROSPECTION_THREAD_LOCAL size_t free_block_count;
+
+static frame_block *take_block()
+{
+    frame_block *b = free_blocks;
+    if (b)
+    {
+        free_blocks = b->next;
+        --free_block_count;
+    }
+    else
+    {
+        b = new frame_block();
+    }
+    b->next = 0;
+    b->begin = 0;
+    b->end = 0;
+    return b;
+}
+
+static void give_block(frame_block *b)
+{
+    if (free_block_count >= MAX_FREE_BLOCKS)
+    {
+        delete b;
+        return;
+    }
+    b->next = free_blocks;
+    free_blocks = b;
+    ++free_block_count;
+}
+
+frame_queue::frame_queue() :
+    head_(0),
+    tail_(0),
+    count_(0),
+    bytes_(0)
+{
+}
+
+frame_queue::~frame_queue()
+{
+    clear();
+}
+
+void frame_queue::push(shared_frame *frame)
+{
+    if (!tail_ || tail_->end == FRAME_BLOCK_REFS)
+    {
+        frame_block *b = take_block();
+        if (tail_)
+        {
+            tail_->next = b;
+        }
+        else
+        {
+            head_ = b;
+        }
+        tail_ = b;
+    }
+    frame_ref &e = tail_->refs[tail_->end++];
+    e.frame = frame;
+    e.offset = 0;
+    frame->add_ref();
+    ++count_;
+    bytes_ += frame->size();
+}
+
+void frame_queue::clear()
+{
+    while (head_)
+    {
+        frame_block *b = head_;
+        for (int i = b->begin; i != b->end; ++i)
+        {
+            b->refs[i].frame->release();
+        }
+        head_ = b->next;
+        give_block(b);
+    }
+    tail_ = 0;
+    count_ = 0;
+    bytes_ = 0;
+}
+
+int frame_queue::gather(frame_ref *oFrames, int max) const
+{
+    int n = 0;
+    for (frame_block *b = head_; b && n < max; b = b->next)
+    {
+        for (int i = b->begin; i != b->end && n < max; ++i)
+        {
+            oFrames[n++] = b->refs[i];
+        }
+    }
+    return n;
+}
+
+void frame_queue::consume(size_t bytes)
+{
+    bytes_ -= bytes;
+    while (bytes > 0)
+    {
+        frame_ref &e = head_->refs[head_->begin];
+        size_t avail = e.frame->size() - e.offset;
+        if (bytes < avail)
+        {
+            e.offset += bytes;
+            break;
+        }
+        bytes -= avail;
+        e.frame->release();
+        --count_;
+        if (++head_->begin == head_->end)
+        {
+            frame_block *b = head_;
+            head_ = b->next;
+            if (!head_)
+            {
+                tail_ = 0;
+            }
+            give_block(b);
+        }
+    }
+}
+
+int frame_queue::send_to(int sock)
+{
+    frame_ref refs[MAX_SEND_FRAMES];
+    int n = gather(refs, MAX_SEND_FRAMES);
+#if defined(_MSC_VER)
+    WSABUF bufs[MAX_SEND_FRAMES];
+    for (int i = 0; i != n; ++i)
+    {
+        bufs[i].buf = (char *)refs[i].frame->data() + refs[i].offset;
+        bufs[i].len = (ULONG)(refs[i].frame->size() - refs[i].offset);
+    }
+    DWORD sent = 0;
+    if (WSASend(sock, bufs, (DWORD)n, &sent, 0, 0, 0) != 0)
+    {
+        return -1;
+    }
+    int w = (int)sent;
+#else
+    iovec bufs[MAX_SEND_FRAMES];
+    for (int i = 0; i != n; ++i)
+    {
+        bufs[i].iov_base = (void *)(refs[i].frame->data() + refs[i].offset);
+        bufs[i].iov_len = refs[i].frame->size() - refs[i].offset;
+    }
+    int w = (int)::writev(sock, bufs, n);
+#endif
+    if (w > 0)
+    {
+        consume((size_t)w);
+    }
+    return w;
+}
+
+frame_inbox::frame_inbox() :
+    head_(0)
+{
+}
+
+frame_inbox::~frame_inbox()
+{
+    std::vector<shared_frame *> left;
+    take_all(left);
+    for (size_t i = 0; i != left.size(); ++i)
+    {
+        left[i]->release();
+    }
+}
+
+bool frame_inbox::push(shared_frame *frame)
+{
+    node *n = new node();
+    n->frame = frame;
+    while (true)
+    {
+        void *head = introspection::atomic_load_ptr_acquire(&head_);
+        n->next = (node *)head;
+        if (introspection::atomic_cas_ptr(&head_, head, n))
+        {
+            return head == 0;
+        }
+    }
+}
+
+void frame_inbox::take_all(std::vector<shared_frame *> &oFrames)
+{
+    void *head;
+    do
+    {
+        head = introspection::atomic_load_ptr_acquire(&head_);
+    }
+    while (head && !introspection::atomic_cas_ptr(&head_, head, 0));
+    //  the list is newest first
+    size_t at = oFrames.size();
+    for (node *n = (node *)head; n != 0; )
+    {
+        node *next = n->next;
+        oFrames.push_back(n->frame);
+        delete n;
+        n = next;
+    }
+    std::reverse(oFrames.begin() + at, oFrames.end());
+}
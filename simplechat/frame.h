@@ -0,0 +1,112 @@
+
+#if !defined(simplechat_frame_h)
+#define simplechat_frame_h
+
+#include <introspection/introspection.h>
+
+/* A frame is what goes on the wire: a two byte (big-endian) length, and
+   that many bytes of encoded PDUs. Frames are immutable once built, and
+   reference counted, so a broadcast is built once and every recipient's
+   output queue points at the same bytes. The frame is freed when the last
+   recipient has sent it (or gone away).
+   */
+class shared_frame
+{
+    public:
+        /* a frame holding a copy of the data, with a count of one */
+        static shared_frame *create(void const *data, size_t size);
+        /* The stream holds two reserved bytes followed by the payload;
+           fills in the length and makes a frame of it. */
+        static shared_frame *from_stream(introspection::simple_stream &ss, bool critical = false);
+        void add_ref();
+        void release();
+        inline unsigned char const *data() const { return (unsigned char const *)(this + 1); }
+        inline size_t size() const { return size_; }
+        /* whether a user who isn't keeping up must still get it */
+        inline bool critical() const { return critical_; }
+
+    private:
+        shared_frame(size_t size, bool critical);
+        ~shared_frame();
+        shared_frame(shared_frame const &);
+        shared_frame &operator=(shared_frame const &);
+        //  frames may be shared between threads
+        long volatile refs_;
+        size_t size_;
+        bool critical_;
+        //  the data follows
+};
+
+/* a frame, and how much of it has been sent */
+struct frame_ref
+{
+    shared_frame *frame;
+    size_t offset;
+};
+
+/* how many frames one gathering write takes at most */
+const int MAX_SEND_FRAMES = 16;
+
+struct frame_block;
+
+/* A connection's output: the frames it has yet to send, and how far into
+   the first one it has got. The references are kept in a chain of fixed
+   size blocks, which come from (and go back to) a free list for each
+   thread, so a queue that grows and drains allocates nothing once the
+   server is warm, and an idle connection holds no blocks at all. */
+class frame_queue
+{
+    public:
+        frame_queue();
+        ~frame_queue();
+        /* queue the frame; the queue takes its own reference */
+        void push(shared_frame *frame);
+        /* Send as much as the socket takes, in one gathering write. Returns
+           what the write returned. */
+        int send_to(int sock);
+        /* For asynchronous writes: the frames at the front of the queue (at
+           most max), and, once the write is done, dropping what it sent. */
+        int gather(frame_ref *oFrames, int max) const;
+        void consume(size_t bytes);
+        void clear();
+        inline size_t bytes() const { return bytes_; }
+        inline bool empty() const { return count_ == 0; }
+
+    private:
+        frame_queue(frame_queue const &);
+        frame_queue &operator=(frame_queue const &);
+        frame_block *head_;
+        frame_block *tail_;
+        size_t count_;
+        size_t bytes_;
+};
+
+/* Frames on their way to another thread. Any number of threads may push;
+   one thread takes them all at once. Lock-free: a push is a compare-and-
+   swap onto a list, and taking swaps the whole list out, so no node is
+   ever looked at by two threads.
+   */
+class frame_inbox
+{
+    public:
+        frame_inbox();
+        ~frame_inbox();
+        /* Queue the frame, handing over a reference. Returns true if the
+           inbox was empty, so the owner may need waking. */
+        bool push(shared_frame *frame);
+        /* append everything pushed so far, oldest first; the references
+           are handed over */
+        void take_all(std::vector<shared_frame *> &oFrames);
+
+    private:
+        frame_inbox(frame_inbox const &);
+        frame_inbox &operator=(frame_inbox const &);
+        struct node
+        {
+            node *next;
+            shared_frame *frame;
+        };
+        void *volatile head_;
+};
+
+#endif  //  simplechat_frame_h
@@ -5,4 +5,13 @@
  */
 #include <introspection/introspection.cpp>
 #include <introspection/protocol.cpp>
+#include <introspection/protocol_stats.cpp>
+#include <introspection/codegen.cpp>
+#include <introspection/json.cpp>
+#include <introspection/transcode.cpp>
+#include <introspection/lazy_pdu.cpp>
+#include <introspection/registry.cpp>
+#include <introspection/pool.cpp>
+#include <introspection/trace.cpp>
+#include <introspection/message_ring.cpp>
 #include <introspection/sample_protocol.cpp>
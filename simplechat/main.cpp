@@ -10,9 +10,16 @@ EXTERN_PROTOCOL(my_proto);
 void usage()
 {
     fprintf(stderr, "usage:\n");
-    fprintf(stderr, "samplechat server p              -- start serving on port p\n");
+    fprintf(stderr, "samplechat server p [backend] [threads] [pin] [slow=s] [trace=l]\n");
+    fprintf(stderr, "                                 -- start serving on port p (epoll, uring or select)\n");
+    fprintf(stderr, "                                 -- and kick users who are behind for s seconds\n");
+    fprintf(stderr, "                                 -- and trace at level l (0 to 3)\n");
     fprintf(stderr, "samplechat edit                  -- edit user file\n");
     fprintf(stderr, "samplechat client user server p  -- connect to server, port p, as user user\n");
+    fprintf(stderr, "samplechat bench server p [s]    -- measure round trips on server, port p, for s seconds\n");
+    fprintf(stderr, "samplechat trace file [summary]  -- print a trace the server saved\n");
+    fprintf(stderr, "samplechat stats server p        -- show what the server on this host, port p, is doing\n");
+    fprintf(stderr, "samplechat check server p        -- check that the server on port p refuses what it should\n");
     fprintf(stderr, "The server uses a file named 'users.txt' for name/password information.\n");
     exit(1);
 }
@@ -20,6 +27,10 @@ void usage()
 void do_client(int argc, char const *argv[]);
 void do_server(int argc, char const *argv[]);
 void do_edit(int argc, char const *argv[]);
+void do_bench(int argc, char const *argv[]);
+void do_trace(int argc, char const *argv[]);
+void do_stats(int argc, char const *argv[]);
+void do_check(int argc, char const *argv[]);
 
 int main(int argc, char const *argv[])
 {
@@ -35,6 +46,18 @@ int main(int argc, char const *argv[])
     else if (!strcmp(argv[1], "edit")) {
         do_edit(argc-1, argv+1);
     }
+    else if (!strcmp(argv[1], "bench")) {
+        do_bench(argc-1, argv+1);
+    }
+    else if (!strcmp(argv[1], "trace")) {
+        do_trace(argc-1, argv+1);
+    }
+    else if (!strcmp(argv[1], "stats")) {
+        do_stats(argc-1, argv+1);
+    }
+    else if (!strcmp(argv[1], "check")) {
+        do_check(argc-1, argv+1);
+    }
     else {
         usage();
     }
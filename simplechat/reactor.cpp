@@ -0,0 +1,768 @@
+
+#if !defined(_MSC_VER)
+#include <introspection/not_win32.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <map>
+#include <set>
+#endif
+#endif
+#endif
+#else
+#include <WinSock2.h>
+#include <Windows.h>
+#endif
+#include <vector>
+#include <algorithm>
+#include "reactor.h"
+#include "frame.h"
+
+#if defined(IORING_RECV_MULTISHOT) && defined(__NR_io_uring_setup)
+#define SIMPLECHAT_IO_URING 1
+#endif
+
+bool set_nonblocking(int sock)
+{
+#if defined(_MSC_VER)
+    u_long one = 1;
+    return ioctlsocket(sock, FIONBIO, &one) == 0;
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+bool would_block()
+{
+#if defined(_MSC_VER)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+/* The fd_sets are kept up to date as sockets come and go, and copied for
+   each select(), so a wait costs one pass over the sockets. */
+class select_reactor : public reactor
+{
+    public:
+        select_reactor() :
+            syscalls_(0)
+        {
+            FD_ZERO(&rd_);
+            FD_ZERO(&wr_);
+        }
+        char const *name() const
+        {
+            return "select";
+        }
+        size_t capacity() const
+        {
+            return FD_SETSIZE;
+        }
+        bool add(int sock)
+        {
+#if !defined(_MSC_VER)
+            //  the fd_set is a bitmap indexed by descriptor
+            if (sock >= FD_SETSIZE)
+            {
+                return false;
+            }
+#endif
+            if (socks_.size() >= FD_SETSIZE)
+            {
+                return false;
+            }
+            socks_.push_back(sock);
+            FD_SET(sock, &rd_);
+            return true;
+        }
+        void remove(int sock)
+        {
+            std::vector<int>::iterator ptr(std::find(socks_.begin(), socks_.end(), sock));
+            if (ptr != socks_.end())
+            {
+                socks_.erase(ptr);
+                FD_CLR(sock, &rd_);
+                FD_CLR(sock, &wr_);
+            }
+        }
+        void want_write(int sock, bool want)
+        {
+            if (want)
+            {
+                FD_SET(sock, &wr_);
+            }
+            else
+            {
+                FD_CLR(sock, &wr_);
+            }
+        }
+        int wait(reactor_event *events, int max, int timeout_ms)
+        {
+            fd_set rd = rd_, wr = wr_;
+            int top = 0;
+            for (std::vector<int>::iterator ptr(socks_.begin()), end(socks_.end()); ptr != end; ++ptr)
+            {
+                if (*ptr > top)
+                {
+                    top = *ptr;
+                }
+            }
+            timeval tv;
+            tv.tv_sec = timeout_ms / 1000;
+            tv.tv_usec = (timeout_ms % 1000) * 1000;
+            ++syscalls_;
+            if (select(top + 1, &rd, &wr, 0, timeout_ms < 0 ? 0 : &tv) <= 0)
+            {
+                return 0;
+            }
+            int n = 0;
+            for (std::vector<int>::iterator ptr(socks_.begin()), end(socks_.end()); ptr != end && n < max; ++ptr)
+            {
+                unsigned int ev = (FD_ISSET(*ptr, &rd) ? REACTOR_READ : 0) | (FD_ISSET(*ptr, &wr) ? REACTOR_WRITE : 0);
+                if (ev)
+                {
+                    events[n].sock = *ptr;
+                    events[n].events = ev;
+                    events[n].data = 0;
+                    events[n].result = 0;
+                    ++n;
+                }
+            }
+            return n;
+        }
+        unsigned long long syscalls() const
+        {
+            return syscalls_;
+        }
+
+    private:
+        std::vector<int> socks_;
+        fd_set rd_;
+        fd_set wr_;
+        unsigned long long syscalls_;
+};
+
+#if defined(__linux__)
+/* Edge triggered: each socket is registered once, for both directions, and
+   the kernel only reports the ones that changed. */
+class epoll_reactor : public reactor
+{
+    public:
+        epoll_reactor(int fd) :
+            fd_(fd),
+            syscalls_(1)
+        {
+        }
+        ~epoll_reactor()
+        {
+            close(fd_);
+        }
+        char const *name() const
+        {
+            return "epoll";
+        }
+        size_t capacity() const
+        {
+            return (size_t)-1;
+        }
+        bool add(int sock)
+        {
+            epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.fd = sock;
+            ++syscalls_;
+            return epoll_ctl(fd_, EPOLL_CTL_ADD, sock, &ev) == 0;
+        }
+        void remove(int sock)
+        {
+            epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ++syscalls_;
+            epoll_ctl(fd_, EPOLL_CTL_DEL, sock, &ev);
+        }
+        void want_write(int, bool)
+        {
+        }
+        int wait(reactor_event *events, int max, int timeout_ms)
+        {
+            epoll_event evs[256];
+            ++syscalls_;
+            int n = epoll_wait(fd_, evs, max < 256 ? max : 256, timeout_ms);
+            for (int i = 0; i < n; ++i)
+            {
+                events[i].sock = evs[i].data.fd;
+                events[i].data = 0;
+                events[i].result = 0;
+                events[i].events = ((evs[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) ? REACTOR_READ : 0) |
+                    ((evs[i].events & EPOLLOUT) ? REACTOR_WRITE : 0);
+            }
+            return n < 0 ? 0 : n;
+        }
+        unsigned long long syscalls() const
+        {
+            return syscalls_;
+        }
+
+    private:
+        int fd_;
+        unsigned long long syscalls_;
+};
+#endif
+
+#if defined(SIMPLECHAT_IO_URING)
+/* Everything goes through one submission and one completion ring shared
+   with the kernel, using the raw system calls. Each socket has one
+   multishot receive outstanding: the kernel completes it every time data
+   arrives, into a buffer it takes from a ring of buffers provided up front,
+   so there is no read call at all. Sends are sendmsg() requests. All the
+   requests queued during a tick go to the kernel with the next wait, in a
+   single io_uring_enter().
+
+   The kernel may still be working on a request for a socket that has been
+   removed (and maybe closed, and its number reused), so requests point at
+   a slot rather than naming the socket, and a slot is only freed once the
+   kernel is done with it.
+   */
+const unsigned URING_ENTRIES = 1024;
+/* buffers for receives; a power of two */
+const unsigned URING_BUFFERS = 512;
+const unsigned URING_BUFFER_SIZE = 4096;
+const unsigned short URING_GROUP = 1;
+
+enum
+{
+    OP_RECV = 1,
+    OP_SEND = 2,
+    OP_POLL = 3,
+    OP_CANCEL = 4
+};
+
+class uring_reactor : public reactor
+{
+    public:
+        uring_reactor() :
+            fd_(-1),
+            ring_(0),
+            ringSize_(0),
+            sqes_(0),
+            sqesSize_(0),
+            sqTail_(0),
+            bufRing_(0),
+            bufs_(0),
+            bufTail_(0),
+            syscalls_(0)
+        {
+        }
+        ~uring_reactor()
+        {
+            if (fd_ >= 0)
+            {
+                //  closing the ring cancels whatever is outstanding
+                close(fd_);
+            }
+            for (std::set<slot *>::iterator ptr(all_.begin()), end(all_.end()); ptr != end; ++ptr)
+            {
+                release_frames(*ptr);
+                delete *ptr;
+            }
+            if (sqes_)
+            {
+                munmap(sqes_, sqesSize_);
+            }
+            if (ring_)
+            {
+                munmap(ring_, ringSize_);
+            }
+            free(bufRing_);
+            free(bufs_);
+        }
+        /* false if the kernel can't do what this needs */
+        bool init()
+        {
+            io_uring_params p;
+            memset(&p, 0, sizeof(p));
+            p.flags = IORING_SETUP_CQSIZE;
+            p.cq_entries = URING_ENTRIES * 4;
+            ++syscalls_;
+            fd_ = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+            if (fd_ < 0 || !(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG) ||
+                !(p.features & IORING_FEAT_NODROP))
+            {
+                return false;
+            }
+            size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+            ringSize_ = sqSize > cqSize ? sqSize : cqSize;
+            void *ring = mmap(0, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+            if (ring == MAP_FAILED)
+            {
+                return false;
+            }
+            ring_ = (unsigned char *)ring;
+            sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+            void *sqes = mmap(0, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED)
+            {
+                return false;
+            }
+            sqes_ = (io_uring_sqe *)sqes;
+            sqHead_ = (unsigned *)(ring_ + p.sq_off.head);
+            sqTailShared_ = (unsigned *)(ring_ + p.sq_off.tail);
+            sqMask_ = *(unsigned *)(ring_ + p.sq_off.ring_mask);
+            sqEntries_ = p.sq_entries;
+            sqArray_ = (unsigned *)(ring_ + p.sq_off.array);
+            sqTail_ = *sqTailShared_;
+            cqHead_ = (unsigned *)(ring_ + p.cq_off.head);
+            cqTail_ = (unsigned *)(ring_ + p.cq_off.tail);
+            cqMask_ = *(unsigned *)(ring_ + p.cq_off.ring_mask);
+            cqes_ = (io_uring_cqe *)(ring_ + p.cq_off.cqes);
+
+            //  the receive buffers, and the ring that hands them to the kernel
+            if (posix_memalign(&bufRing_, 4096, URING_BUFFERS * sizeof(io_uring_buf)) != 0 ||
+                posix_memalign((void **)&bufs_, 4096, URING_BUFFERS * URING_BUFFER_SIZE) != 0)
+            {
+                return false;
+            }
+            memset(bufRing_, 0, URING_BUFFERS * sizeof(io_uring_buf));
+            io_uring_buf_reg reg;
+            memset(&reg, 0, sizeof(reg));
+            reg.ring_addr = (unsigned long long)(uintptr_t)bufRing_;
+            reg.ring_entries = URING_BUFFERS;
+            reg.bgid = URING_GROUP;
+            ++syscalls_;
+            if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+            {
+                return false;
+            }
+            for (unsigned i = 0; i != URING_BUFFERS; ++i)
+            {
+                give_back(i);
+            }
+            publish_buffers();
+            return probe();
+        }
+        char const *name() const
+        {
+            return "uring";
+        }
+        size_t capacity() const
+        {
+            return (size_t)-1;
+        }
+        bool add(int sock)
+        {
+            //  the kernel waits for data itself; a non-blocking socket would 
+            //  make it hand back EAGAIN instead
+            int flags = fcntl(sock, F_GETFL, 0);
+            if (flags < 0 || fcntl(sock, F_SETFL, flags & ~O_NONBLOCK) < 0)
+            {
+                return false;
+            }
+            slot *s = new_slot(sock, false);
+            arm(s, OP_RECV);
+            return true;
+        }
+        bool watch(int sock)
+        {
+            slot *s = new_slot(sock, true);
+            arm(s, OP_POLL);
+            return true;
+        }
+        void remove(int sock)
+        {
+            std::map<int, slot *>::iterator ptr(slots_.find(sock));
+            if (ptr == slots_.end())
+            {
+                return;
+            }
+            slot *s = (*ptr).second;
+            slots_.erase(ptr);
+            s->alive = false;
+            cancel(s, s->watched ? OP_POLL : OP_RECV);
+            if (s->nframes)
+            {
+                cancel(s, OP_SEND);
+            }
+        }
+        void want_write(int, bool)
+        {
+        }
+        bool completes_io() const
+        {
+            return true;
+        }
+        bool send(int sock, frame_ref const *frames, int count)
+        {
+            std::map<int, slot *>::iterator ptr(slots_.find(sock));
+            if (ptr == slots_.end() || (*ptr).second->nframes || count < 1 || count > MAX_SEND_FRAMES)
+            {
+                return false;
+            }
+            slot *s = (*ptr).second;
+            for (int i = 0; i != count; ++i)
+            {
+                s->iov[i].iov_base = (void *)(frames[i].frame->data() + frames[i].offset);
+                s->iov[i].iov_len = frames[i].frame->size() - frames[i].offset;
+                s->frames[i] = frames[i].frame;
+                frames[i].frame->add_ref();
+            }
+            s->nframes = count;
+            memset(&s->msg, 0, sizeof(s->msg));
+            s->msg.msg_iov = s->iov;
+            s->msg.msg_iovlen = count;
+            io_uring_sqe *sqe = get_sqe(s, OP_SEND);
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = sock;
+            sqe->addr = (unsigned long long)(uintptr_t)&s->msg;
+            sqe->len = 1;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            return true;
+        }
+        int wait(reactor_event *events, int max, int timeout_ms)
+        {
+            //  the data the last events pointed at has been used by now
+            publish_buffers();
+            for (size_t i = 0; i != rearm_.size(); ++i)
+            {
+                if (rearm_[i]->alive)
+                {
+                    arm(rearm_[i], rearm_[i]->watched ? OP_POLL : OP_RECV);
+                }
+                release_slot(rearm_[i]);
+            }
+            rearm_.clear();
+            unsigned ready = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) - *cqHead_;
+            if (ready == 0 && timeout_ms != 0)
+            {
+                enter(1, timeout_ms);
+            }
+            else if (sqTail_ != __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE))
+            {
+                enter(0, 0);
+            }
+            return reap(events, max);
+        }
+        unsigned long long syscalls() const
+        {
+            return syscalls_;
+        }
+
+    private:
+        struct slot
+        {
+            int sock;
+            bool alive;
+            bool watched;
+            /* requests the kernel hasn't finished, and references held by 
+               the rearm list */
+            int pending;
+            msghdr msg;
+            iovec iov[MAX_SEND_FRAMES];
+            shared_frame *frames[MAX_SEND_FRAMES];
+            int nframes;
+        };
+
+        slot *new_slot(int sock, bool watched)
+        {
+            slot *s = new slot();
+            s->sock = sock;
+            s->alive = true;
+            s->watched = watched;
+            s->pending = 0;
+            s->nframes = 0;
+            slots_[sock] = s;
+            all_.insert(s);
+            return s;
+        }
+        void release_slot(slot *s)
+        {
+            if (--s->pending == 0 && !s->alive)
+            {
+                release_frames(s);
+                all_.erase(s);
+                delete s;
+            }
+        }
+        void release_frames(slot *s)
+        {
+            for (int i = 0; i != s->nframes; ++i)
+            {
+                s->frames[i]->release();
+            }
+            s->nframes = 0;
+        }
+        io_uring_sqe *get_sqe(slot *s, int op)
+        {
+            if (sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+            {
+                //  full; hand what's there to the kernel
+                enter(0, 0);
+            }
+            unsigned ix = sqTail_ & sqMask_;
+            sqArray_[ix] = ix;
+            ++sqTail_;
+            io_uring_sqe *sqe = &sqes_[ix];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->user_data = (unsigned long long)(uintptr_t)s | op;
+            if (s)
+            {
+                ++s->pending;
+            }
+            return sqe;
+        }
+        void arm(slot *s, int op)
+        {
+            io_uring_sqe *sqe = get_sqe(s, op);
+            sqe->fd = s->sock;
+            if (op == OP_POLL)
+            {
+                sqe->opcode = IORING_OP_POLL_ADD;
+                sqe->poll32_events = POLLIN;
+                sqe->len = IORING_POLL_ADD_MULTI;
+            }
+            else
+            {
+                sqe->opcode = IORING_OP_RECV;
+                sqe->ioprio = IORING_RECV_MULTISHOT;
+                sqe->flags = IOSQE_BUFFER_SELECT;
+                sqe->buf_group = URING_GROUP;
+            }
+        }
+        void cancel(slot *s, int op)
+        {
+            io_uring_sqe *sqe = get_sqe(s, OP_CANCEL);
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = (unsigned long long)(uintptr_t)s | op;
+        }
+        void give_back(unsigned bid)
+        {
+            //  io_uring_buf_ring's flexible array doesn't start at 0 in C++, so
+            //  index the entries directly
+            io_uring_buf *b = (io_uring_buf *)bufRing_ + (bufTail_ & (URING_BUFFERS - 1));
+            b->addr = (unsigned long long)(uintptr_t)(bufs_ + bid * URING_BUFFER_SIZE);
+            b->len = URING_BUFFER_SIZE;
+            b->bid = (unsigned short)bid;
+            ++bufTail_;
+        }
+        void publish_buffers()
+        {
+            for (size_t i = 0; i != lent_.size(); ++i)
+            {
+                give_back(lent_[i]);
+            }
+            lent_.clear();
+            //  the tail overlays the first entry's reserved field
+            __atomic_store_n(&((io_uring_buf *)bufRing_)->resv, bufTail_, __ATOMIC_RELEASE);
+        }
+        void enter(unsigned minComplete, int timeout_ms)
+        {
+            __atomic_store_n(sqTailShared_, sqTail_, __ATOMIC_RELEASE);
+            unsigned toSubmit = sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+            unsigned flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+            ++syscalls_;
+            if (minComplete && timeout_ms >= 0)
+            {
+                __kernel_timespec ts;
+                ts.tv_sec = timeout_ms / 1000;
+                ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+                io_uring_getevents_arg arg;
+                memset(&arg, 0, sizeof(arg));
+                arg.ts = (unsigned long long)(uintptr_t)&ts;
+                syscall(__NR_io_uring_enter, fd_, toSubmit, minComplete, flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+            }
+            else
+            {
+                syscall(__NR_io_uring_enter, fd_, toSubmit, minComplete, flags, 0, 0);
+            }
+        }
+        int reap(reactor_event *events, int max)
+        {
+            unsigned head = *cqHead_;
+            unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+            int n = 0;
+            while (head != tail && n < max)
+            {
+                io_uring_cqe const &cqe = cqes_[head & cqMask_];
+                ++head;
+                slot *s = (slot *)(uintptr_t)(cqe.user_data & ~(unsigned long long)7);
+                int op = (int)(cqe.user_data & 7);
+                bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+                if (cqe.flags & IORING_CQE_F_BUFFER)
+                {
+                    lent_.push_back(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                }
+                if (!s)
+                {
+                    continue;
+                }
+                reactor_event &ev = events[n];
+                ev.sock = s->sock;
+                ev.events = 0;
+                ev.data = 0;
+                ev.result = cqe.res;
+                if (op == OP_RECV)
+                {
+                    if (s->alive && cqe.res == -ENOBUFS)
+                    {
+                        //  all the buffers are out; try again once they're back
+                        more = false;
+                    }
+                    else if (s->alive)
+                    {
+                        ev.events = REACTOR_RECEIVED;
+                        if (cqe.res > 0)
+                        {
+                            ev.data = bufs_ + (cqe.flags >> IORING_CQE_BUFFER_SHIFT) * URING_BUFFER_SIZE;
+                        }
+                    }
+                    if (!more && s->alive && (cqe.res > 0 || cqe.res == -ENOBUFS))
+                    {
+                        //  the kernel ended the multishot; start another
+                        ++s->pending;
+                        rearm_.push_back(s);
+                    }
+                }
+                else if (op == OP_POLL)
+                {
+                    if (s->alive && cqe.res > 0)
+                    {
+                        ev.events = REACTOR_READ;
+                    }
+                    if (!more && s->alive)
+                    {
+                        ++s->pending;
+                        rearm_.push_back(s);
+                    }
+                }
+                else if (op == OP_SEND)
+                {
+                    release_frames(s);
+                    if (s->alive)
+                    {
+                        ev.events = REACTOR_SENT;
+                    }
+                }
+                if (ev.events)
+                {
+                    ++n;
+                }
+                if (!more)
+                {
+                    release_slot(s);
+                }
+            }
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+            return n;
+        }
+        /* Multishot receives need Linux 6.0; older kernels take the request
+           and then fail it. So try one on a socket pair. */
+        bool probe()
+        {
+            int sv[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+            {
+                return false;
+            }
+            slot *s = new_slot(sv[0], false);
+            arm(s, OP_RECV);
+            char c = 1;
+            bool ok = false;
+            if (::write(sv[1], &c, 1) == 1)
+            {
+                reactor_event ev[4];
+                for (int i = 0; i != 4 && !ok; ++i)
+                {
+                    int n = wait(ev, 4, 1000);
+                    //  a receive that ended on its own is not multishot
+                    ok = n > 0 && ev[0].result == 1 && rearm_.empty();
+                    if (n > 0 && !ok)
+                    {
+                        break;
+                    }
+                }
+            }
+            remove(sv[0]);
+            close(sv[0]);
+            close(sv[1]);
+            //  let the cancel go through
+            reactor_event ev[4];
+            wait(ev, 4, 0);
+            return ok;
+        }
+
+        int fd_;
+        unsigned char *ring_;
+        size_t ringSize_;
+        io_uring_sqe *sqes_;
+        size_t sqesSize_;
+        unsigned *sqHead_;
+        unsigned *sqTailShared_;
+        unsigned sqMask_;
+        unsigned sqEntries_;
+        unsigned *sqArray_;
+        unsigned sqTail_;
+        unsigned *cqHead_;
+        unsigned *cqTail_;
+        unsigned cqMask_;
+        io_uring_cqe *cqes_;
+        void *bufRing_;
+        unsigned char *bufs_;
+        unsigned short bufTail_;
+        /* buffers the events of the last wait point into */
+        std::vector<unsigned> lent_;
+        /* slots whose multishot request ended, to start again */
+        std::vector<slot *> rearm_;
+        std::map<int, slot *> slots_;
+        std::set<slot *> all_;
+        unsigned long long syscalls_;
+};
+#endif
+
+reactor *reactor::create(char const *backend)
+{
+#if defined(SIMPLECHAT_IO_URING)
+    if (backend && !strcmp(backend, "uring"))
+    {
+        uring_reactor *ur = new uring_reactor();
+        if (ur->init())
+        {
+            return ur;
+        }
+        delete ur;
+        fprintf(stderr, "io_uring is not usable on this kernel; using epoll\n");
+        backend = "epoll";
+    }
+#endif
+#if defined(__linux__)
+    if (!backend || !strcmp(backend, "epoll"))
+    {
+        int fd = epoll_create(256);
+        if (fd >= 0)
+        {
+            return new epoll_reactor(fd);
+        }
+        if (backend)
+        {
+            return 0;
+        }
+    }
+#endif
+    if (!backend || !strcmp(backend, "select"))
+    {
+        return new select_reactor();
+    }
+    return 0;
+}
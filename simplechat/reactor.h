@@ -0,0 +1,88 @@
+
+#if !defined(simplechat_reactor_h)
+#define simplechat_reactor_h
+
+#include <stddef.h>
+
+/* A reactor waits for sockets to become readable or writable. The server
+   only talks to this interface, so the backend can be chosen at start-up:
+   "epoll" (Linux) costs nothing for sockets that are idle, and hands back
+   just the ones that are ready; "select" works everywhere, but looks at
+   every socket on every wait, and can only take FD_SETSIZE of them;
+   "uring" (Linux 6.0 and up) does the reads and writes itself, for many
+   sockets per system call.
+
+   Backends may be edge triggered, so whoever gets an event must read (or
+   write) until the socket would block. Sockets must be non-blocking.
+
+   A backend that completes_io() reports data instead of readiness: what
+   was read from a socket arrives as a REACTOR_RECEIVED event, and writes
+   are handed over with send() and come back as REACTOR_SENT. Sockets that
+   are only watch()ed (the accepting socket) still get REACTOR_READ.
+   */
+
+struct frame_ref;
+
+enum
+{
+    REACTOR_READ = 1,
+    REACTOR_WRITE = 2,
+    REACTOR_RECEIVED = 4,
+    REACTOR_SENT = 8
+};
+
+struct reactor_event
+{
+    int sock;
+    unsigned int events;
+    /* for REACTOR_RECEIVED, the data, which stays valid until the next 
+       wait(); result is the byte count (0 or less when the socket is 
+       closed or failed). For REACTOR_SENT, how much was sent. */
+    void const *data;
+    int result;
+};
+
+class reactor
+{
+    public:
+        /* "epoll", "uring", "select", or 0 for the best this system has
+           (epoll, where there is one). Returns 0 if the backend isn't
+           available; "uring" falls back to epoll on kernels that can't. */
+        static reactor *create(char const *backend);
+        virtual ~reactor() {}
+        virtual char const *name() const = 0;
+        /* the most sockets this can watch */
+        virtual size_t capacity() const = 0;
+        /* start watching the socket for reads (and writes, when wanted) */
+        virtual bool add(int sock) = 0;
+        /* only ever report readiness to read on this socket */
+        virtual bool watch(int sock)
+        {
+            return add(sock);
+        }
+        virtual void remove(int sock) = 0;
+        /* Whether the socket has output waiting. Edge triggered backends
+           report every change in writability, and ignore this. */
+        virtual void want_write(int sock, bool want) = 0;
+        /* Wait at most timeout_ms (-1 to wait for ever), and return the
+           number of events put in the array. */
+        virtual int wait(reactor_event *events, int max, int timeout_ms) = 0;
+        virtual bool completes_io() const
+        {
+            return false;
+        }
+        /* Start writing the frames to the socket; one write at a time per 
+           socket. The backend keeps its own references until it's done. */
+        virtual bool send(int sock, frame_ref const *frames, int count)
+        {
+            return false;
+        }
+        /* system calls made by the backend so far */
+        virtual unsigned long long syscalls() const = 0;
+};
+
+bool set_nonblocking(int sock);
+/* whether the last socket call failed only because it would have blocked */
+bool would_block();
+
+#endif  //  simplechat_reactor_h
@@ -1,6 +1,8 @@
 
 #if !defined(_MSC_VER)
 #include <introspection/not_win32.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #else
 #include <WinSock2.h>
 #include <Windows.h>
@@ -9,11 +11,73 @@ typedef int w32_socklen_t;
 #include <assert.h>
 #include <time.h>
 #include <introspection/sample_chat.h>
-#include <map>
+#include <introspection/registry.h>
+#include <introspection/message_ring.h>
+#include <ctype.h>
 #include "userlist.h"
-#include "refptr.h"
+#include "frame.h"
+#include "conn_table.h"
+#include "reactor.h"
+#include "timer_wheel.h"
+#include <introspection/lockfree.h>
+#include <introspection/protocol_stats.h>
+#include <introspection/trace.h>
 
-#define TRACE(x) printf("%s:%d: %s\n", __FILE__, __LINE__, #x)
+/* What the server traces (see trace.h), with the socket and a count where 
+   there is one. "trace=level" on the command line sets the level; on 
+   systems that have them, SIGUSR1 steps it up (and round to off), and 
+   SIGUSR2 saves what's been traced to server.trace, for "simplechat trace". 
+   */
+static trace_point tp_accept("accept", TRACE_INFO);
+static trace_point tp_kick("kick", TRACE_INFO);
+static trace_point tp_timeout("timeout", TRACE_INFO);
+static trace_point tp_erase("erase", TRACE_INFO);
+static trace_point tp_wait("wait", TRACE_DEBUG);          //  timeout, ms
+static trace_point tp_woke("woke", TRACE_DEBUG);          //  events
+static trace_point tp_recv("recv", TRACE_DEBUG);          //  bytes
+static trace_point tp_send("send", TRACE_DEBUG);          //  bytes
+static trace_point tp_timers("timers", TRACE_DEBUG);      //  timers fired
+static trace_point tp_emit("emit", TRACE_DEBUG);          //  frame bytes
+static trace_point tp_frame("frame", TRACE_VERBOSE);      //  frame bytes
+static trace_point tp_enqueue("enqueue", TRACE_VERBOSE);  //  frame bytes
+static trace_point tp_drop("drop", TRACE_VERBOSE);        //  frame bytes
+
+static long volatile trace_save_requested;
+static char const *trace_path = "server.trace";
+
+static void save_trace()
+{
+    trace_t trace;
+    trace_snapshot(trace);
+    simple_stream ss;
+    trace_write(trace, ss);
+    FILE *f = fopen(trace_path, "wb");
+    if (!f || fwrite(ss.unsafe_data(), 1, ss.position(), f) != ss.position())
+    {
+        fprintf(stderr, "could not write %s\n", trace_path);
+    }
+    else
+    {
+        fprintf(stderr, "saved the trace of %u threads to %s\n", (unsigned int)trace.threads.size(), trace_path);
+    }
+    if (f)
+    {
+        fclose(f);
+    }
+}
+
+#if defined(SIGUSR1)
+static void step_trace_level(int)
+{
+    set_trace_level(trace_level() >= TRACE_VERBOSE ? TRACE_OFF : trace_level() + 1);
+}
+
+//  the saving is done by a shard, which the signal wakes up
+static void request_trace_save(int)
+{
+    trace_save_requested = 1;
+}
+#endif
 
 EXTERN_PROTOCOL(my_proto);
 
@@ -21,262 +85,710 @@ EXTERN_PROTOCOL(my_proto);
 const long TIMEOUT_CONNECTED = 60*15;
 /* Half a minute without authentication means you get the boot */
 const long TIMEOUT_NONCONNECTED = 30;
+/* how finely the shards' timers are kept, in milliseconds */
+const unsigned int TIMER_TICK_MS = 10;
+/* how often each shard says what it did, if it did anything */
+const long REPORT_INTERVAL = 10;
+
+/* The client takes frames of up to 4 kB, so the list of who's online that 
+   a new user gets stops at this many bytes of names. How many users there 
+   can be is up to the reactor: select() takes FD_SETSIZE sockets (on each 
+   shard), epoll has no limit of its own.
+   */
+const size_t MAX_LISTED_BYTES = 3072;
+
+/* Output backpressure. A user with more than the high watermark waiting to 
+   be sent is not keeping up, and gets only what matters (the answer to 
+   their login, and who comes and goes) until they are back under the low 
+   watermark; chat that happens meanwhile they miss. They are kicked if 
+   they stay behind for slow_grace seconds, or if even that much gets to 
+   the hard limit. The frames are shared, so these bound how long a slow 
+   user holds them, not a copy. */
+const size_t HIGH_WATERMARK = 64*1024;
+const size_t LOW_WATERMARK = 16*1024;
+const size_t HARD_QUEUED_BYTES = 1024*1024;
+static long slow_grace = 10;
 
-/* this is somewhat arbitrary, although the size of the login message and 
-   the 64-socket Windows select() limit does play into this particular socket 
-   implementation.
+/* why users get kicked, for ServerStats */
+enum KickReason
+{
+    KICK_UNKNOWN_USER,
+    KICK_ALREADY_CONNECTED,
+    KICK_NOT_LOGGED_IN,
+    KICK_BAD_FRAME,
+    KICK_BAD_MESSAGE,
+    KICK_SEND_FAILED,
+    KICK_TOO_SLOW,
+    KICK_NOT_LOCAL,
+    KICK_LOGGED_IN_TWICE,
+    KICK_REASONS
+};
+static char const *const kick_reasons[KICK_REASONS] =
+{
+    "unknown user name",
+    "already connected",
+    "attempt to speak before being logged in",
+    "bad frame size",
+    "bad message",
+    "failed to send on socket",
+    "too far behind",
+    "admin request from another host",
+    "second login on one connection",
+};
+
+/* when the server started, in clock_ns() milliseconds */
+static unsigned long long started_ms;
+
+/* The server runs as one or more shards. Each shard is a thread with its 
+   own accepting socket (they share the port with SO_REUSEPORT, and the 
+   kernel spreads new connections over them), its own reactor, its own 
+   users and its own tick. Shards share nothing on the hot path: what one 
+   shard broadcasts is encoded into a frame once, and handed to the other 
+   shards through their lock-free inboxes. With one shard, all of this is 
+   the single threaded server it always was.
    */
-const int MAX_USER_COUNT = 32;
+class ChatShard;
 
-/* Keep track of users connected, or attempting to connect, to the service
+/* Keep track of users connected, or attempting to connect, to the service. 
+   These live in a shard's conn_table, which keeps them for reuse: open() 
+   starts a connection, and close() ends it.
   */
 class ConnectedUser
 {
     public:
-        ConnectedUser(int sockfd) :
-            sockfd_(sockfd),
+        ConnectedUser() :
+            shard_(0),
+            sockfd_(-1),
+            local_(false),
             gotinfo_(false),
-            isdead_(false),
+            isdead_(true),
+            sending_(false),
+            throttled_(false),
+            user_(-1),
+            buf_(0),
             qoff_(0),
             qsize_(0),
-            ooff_(0),
-            osize_(0)
+            idle_(this, &ConnectedUser::on_idle),
+            slow_(this, &ConnectedUser::on_slow)
         {
-            time(&lastTime_);
+            dispatcher_.recycle_pdus(true);
             dispatcher_.add_handler(my_proto, this, &ConnectedUser::OnLogin);
             dispatcher_.add_handler(my_proto, this, &ConnectedUser::OnSaySomething);
+            dispatcher_.add_handler(my_proto, this, &ConnectedUser::OnServerStatsRequest);
         }
         ~ConnectedUser();
 
+        void open(ChatShard *shard, int sockfd, bool local);
+        void close();
         void service();
+        void received(void const *data, int size);
+        void parse();
+        /* decode the whole frames at the start of the data; returns how 
+           many bytes they took */
+        size_t decode_frames(unsigned char const *data, size_t size);
+        /* give the receive buffer back, if there's nothing in it */
+        void settle();
+        void lost(int r);
         void drain();
+        void sent(int w);
         void decode_one(void const *buf, size_t size);
-        void kick(char const *reason);
-        void enqueue(void const *buf, size_t size);
+        /* detail, if given, is what gets logged */
+        void kick(KickReason why, char const *detail = 0);
+        void die();
+        /* queue the frame, and send what's queued */
+        void enqueue(shared_frame *frame);
+        /* queue the frame; it goes on the next drain() */
+        void queue(shared_frame *frame);
         bool is_dead()
         {
             return isdead_;
         }
-        bool is_timed_out(time_t now)
+        char const *name() const
         {
-            return now > lastTime_ + (gotinfo_ ? TIMEOUT_CONNECTED : TIMEOUT_NONCONNECTED);
+            return user_ < 0 ? "" : user_at(user_).name.c_str();
         }
+        /* there was activity; start the timeout over */
+        void touch();
+        void on_idle();
+        void on_slow();
+        void check_watermark();
 
+        ChatShard *shard_;
         int sockfd_;
+        /* connected from this host, so may ask for ServerStats */
+        bool local_;
         bool gotinfo_;
         bool isdead_;
-        UserInfo info_;
-        unsigned char buf_[4096];
+        /* a write is with a completing reactor */
+        bool sending_;
+        /* over the high watermark (slow_ is running) */
+        bool throttled_;
+        /* position in the user list, once logged in */
+        int user_;
+        /* a receive buffer, only while part of a frame is in it */
+        unsigned char *buf_;
         int qoff_;
         int qsize_;
-        time_t lastTime_;
-        unsigned char obuf_[8192];
-        int ooff_;
-        int osize_;
+        frame_queue out_;
+        member_timer<ConnectedUser> idle_;
+        member_timer<ConnectedUser> slow_;
 
         introspection::dispatch_t dispatcher_;
 
         void OnLogin(LoginPacket const &lp);
         void OnSaySomething(SaySomethingPacket const &ssp);
+        void OnServerStatsRequest(ServerStatsRequest const &ssr);
 };
 
 
-class QueuedPacket
+class ChatShard
 {
     public:
-        virtual ~QueuedPacket() {}
-        virtual void emit(introspection::stream &ss) = 0;
+        ChatShard(int index);
+        ~ChatShard();
+        /* Open the accepting socket; "shared" if other shards listen on 
+           the same port. */
+        bool open(int port, char const *backend, bool shared);
+        /* serve for ever, on the calling thread */
+        void run(bool pin);
+        void service_loop();
+        void accept_all();
+        /* every so often, what this shard did, and what it cost */
+        void report();
+        /* add this shard's numbers to the totals */
+        void add_stats(ServerStats &oStats) const;
+        /* a frame from another shard, with a reference for this one */
+        void post(shared_frame *frame);
+        /* Broadcast a PDU. It's encoded now, into the outgoing ring, and 
+           goes out in the next frame of its kind; chat is what's left out 
+           if the ring is full. From another thread, post() something to 
+           wake the shard up as well. */
+        template<typename T>
+        void enqueue_outgoing(T const &t)
+        {
+            unsigned char buf[message_ring::MAX_MESSAGE_BYTES];
+            fixed_stream fs(buf, sizeof(buf));
+            my_proto.encode(t, fs);
+            if (!outgoing_.push(buf, fs.position(), my_proto.code<T>() != my_proto.code<SomeoneSaidSomethingPacket>()))
+            {
+                introspection::atomic_increment(&lostBroadcasts_);
+            }
+        }
+        /* make a frame of what's in the stream, for everyone on every 
+           shard, and start the stream over */
+        void emit(introspection::simple_stream &ss, bool critical);
+
+        int index_;
+        int asock_;
+        reactor *poller_;
+        /* Timeouts, and anything else that is to happen later. The time is 
+           taken once each time the reactor returns, and used for the whole 
+           tick. */
+        unsigned long long now_;
+        timer_wheel timers_;
+        member_timer<ChatShard> reportTimer_;
+        conn_table<ConnectedUser> users_;
+        message_ring outgoing_;
+        /* users to remove at the end of the tick */
+        std::vector<int> dieing_;
+        /* system calls made outside the reactor, and traffic */
+        unsigned long long syscalls_;
+        unsigned long long framesIn_;
+        unsigned long long framesOut_;
+        /* chat not sent to users who weren't keeping up */
+        unsigned long long framesDropped_;
+        /* broadcasts that didn't fit in the outgoing ring */
+        long volatile lostBroadcasts_;
+        unsigned long long reportedSyscalls_;
+        unsigned long long reportedFrames_;
+        /* For ServerStats. Only this shard's thread writes these, with 
+           plain adds and stores, and whichever shard answers a request 
+           reads them as they are, so its totals may be a little behind. 
+           The gauges are kept up as things change, rather than counted 
+           when asked, so nothing has to look at another shard's users. */
+        unsigned long long accepts_;
+        unsigned long long refused_;
+        unsigned long long kicks_[KICK_REASONS];
+        unsigned long long timeouts_;
+        unsigned long long disconnects_;
+        unsigned long long bytesIn_;
+        unsigned long long bytesOut_;
+        unsigned long long queuedBytes_;
+        unsigned long long peakQueuedBytes_;
+        unsigned long long tickNs_[PDU_HISTOGRAM_BUCKETS];
+        unsigned int connections_;
+        unsigned int loggedIn_;
+        unsigned int throttledUsers_;
+        unsigned int queueDepth_;
+        unsigned int framesInPerS_;
+        unsigned int framesOutPerS_;
+        unsigned long long ratedIn_;
+        unsigned long long ratedOut_;
+        /* broadcasts from the other shards, and the pipe that wakes this 
+           one up when they arrive */
+        frame_inbox inbox_;
+        std::vector<shared_frame *> incoming_;
+        int wake_[2];
+
+    private:
+        ChatShard(ChatShard const &);
+        ChatShard &operator=(ChatShard const &);
 };
 
-static std::map<int, ref_ptr<ConnectedUser> > users;
 static int port;
-static int asock;
-static std::list<ref_ptr<QueuedPacket> > queue;
+static std::vector<ChatShard *> shards;
+/* what all the shards have done, for an admin request */
+static void collect_stats(ServerStats &oStats);
 
-template<typename T>
-class QueuedPacketImpl : public QueuedPacket
+/* Who is logged in, on any shard, by position in the user list (which 
+   find_user() gives for a name, with a hash lookup): a flag for each user, 
+   and the ones logged in, densely, for the list a new user gets. Logging 
+   in or out is a few stores, however many users there are, or are 
+   online, so a spinlock around them is plenty. The list doesn't change 
+   while the server runs. */
+static long volatile online_lock;
+static std::vector<char> is_online;
+static std::vector<unsigned int> online;
+static std::vector<unsigned int> online_at;
+
+static void lock_online()
 {
-    public:
-        QueuedPacketImpl(T const &t) :
-            t_(t)
-        {
-        }
-        T t_;
-        void emit(introspection::stream &ss)
-        {
-            my_proto.encode(t_, ss);
-        }
-};
+    introspection::spin_lock(&online_lock);
+}
 
-template<typename T>
-void enqueue_outgoing(T const &t)
+static void unlock_online()
 {
-    queue.push_back(ref_ptr<QueuedPacket>(new QueuedPacketImpl<T>(t)));
+    introspection::spin_unlock(&online_lock);
 }
 
 ConnectedUser::~ConnectedUser()
 {
-    closesocket(sockfd_);
+    //  only ever with the table, which closes them all first
+    assert(isdead_ && !buf_);
+}
+
+void ConnectedUser::open(ChatShard *shard, int sockfd, bool local)
+{
+    shard_ = shard;
+    sockfd_ = sockfd;
+    local_ = local;
+    gotinfo_ = false;
+    isdead_ = false;
+    sending_ = false;
+    throttled_ = false;
+    qoff_ = 0;
+    qsize_ = 0;
+    user_ = -1;
+    touch();
+}
+
+void ConnectedUser::close()
+{
+    die();
+    if (buf_)
+    {
+        give_recv_buffer(buf_);
+        buf_ = 0;
+    }
+    shard_->queuedBytes_ -= out_.bytes();
+    out_.clear();
+    if (throttled_)
+    {
+        throttled_ = false;
+        --shard_->throttledUsers_;
+    }
     if (gotinfo_)
     {
+        gotinfo_ = false;
+        --shard_->loggedIn_;
+        lock_online();
+        is_online[user_] = 0;
+        unsigned int last = online.back();
+        online[online_at[user_]] = last;
+        online_at[last] = online_at[user_];
+        online.pop_back();
+        unlock_online();
         UserLeftPacket ulp;
-        ulp.who = info_.name;
-        enqueue_outgoing(ulp);
+        ulp.who = name();
+        shard_->enqueue_outgoing(ulp);
     }
+    //  last, so a client that sees it closed can log in again at once
+    closesocket(sockfd_);
+    sockfd_ = -1;
 }
 
 void ConnectedUser::service()
 {
-    int r = recv(sockfd_, (char *)&buf_[qoff_ + qsize_], sizeof(buf_)-qoff_-qsize_, 0);
-    if (r < 1)
+    //  read until the socket would block; an edge triggered reactor won't 
+    //  say again about data that's already there
+    while (!isdead_)
     {
-        //  this could be a legit disconnect
-        fprintf(stderr, "lost connection to %s: %d\n", info_.name.c_str(), WSAGetLastError());
-        isdead_ = true;
+        if (!buf_)
+        {
+            buf_ = take_recv_buffer();
+        }
+        ++shard_->syscalls_;
+        int r = recv(sockfd_, (char *)&buf_[qoff_ + qsize_], (int)RECV_BUFFER_SIZE - qoff_ - qsize_, 0);
+        tp_recv(sockfd_, r);
+        if (r < 0 && would_block())
+        {
+            break;
+        }
+        if (r < 1)
+        {
+            lost(r);
+            break;
+        }
+        shard_->bytesIn_ += r;
+        qsize_ += r;
+        parse();
     }
-    else
+    settle();
+}
+
+/* data a completing reactor read for us */
+void ConnectedUser::received(void const *data, int size)
+{
+    tp_recv(sockfd_, size);
+    if (size < 1)
     {
-        qsize_ += r;
-maybe_more:
-        if (qsize_ >= 2)
+        lost(size);
+        return;
+    }
+    shard_->bytesIn_ += size;
+    unsigned char const *ptr = (unsigned char const *)data;
+    if (qsize_ == 0)
+    {
+        //  whole frames are decoded where they are; only a piece of one 
+        //  needs a buffer to wait in
+        size_t n = decode_frames(ptr, size);
+        ptr += n;
+        size -= (int)n;
+    }
+    while (size > 0 && !isdead_)
+    {
+        if (!buf_)
         {
-            int len = (buf_[qoff_] << 8) | buf_[qoff_ + 1];
-            if (qsize_ >= len + 2)
-            {
-                decode_one(&buf_[qoff_ + 2], len);
-                qoff_ += 2 + len;
-                qsize_ -= 2 + len;
-                goto maybe_more;
-            }
-            else if (qoff_ > 0)
-            {
-                memmove(buf_, &buf_[qoff_], qsize_);
-                qoff_ = 0;
-            }
-            else
-            {
-                if (len > sizeof(buf_) - 2)
-                {
-                    //  this means he's sending junk packets
-                    kick("bad frame size");
-                }
-            }
+            buf_ = take_recv_buffer();
+        }
+        int n = (int)RECV_BUFFER_SIZE - qoff_ - qsize_;
+        if (n > size)
+        {
+            n = size;
+        }
+        memcpy(&buf_[qoff_ + qsize_], ptr, n);
+        qsize_ += n;
+        ptr += n;
+        size -= n;
+        parse();
+    }
+    settle();
+}
+
+void ConnectedUser::lost(int r)
+{
+    ++shard_->disconnects_;
+    //  this could be a legit disconnect
+    fprintf(stderr, "lost connection to %s: %d\n", name(), r < 0 ? (r == -1 ? WSAGetLastError() : -r) : 0);
+    die();
+}
+
+size_t ConnectedUser::decode_frames(unsigned char const *data, size_t size)
+{
+    size_t used = 0;
+    while (size - used >= 2 && !isdead_)
+    {
+        size_t len = (data[used] << 8) | data[used + 1];
+        if (len > RECV_BUFFER_SIZE - 2)
+        {
+            //  this means they're sending junk packets
+            kick(KICK_BAD_FRAME);
+            break;
+        }
+        if (size - used < len + 2)
+        {
+            break;
         }
+        decode_one(&data[used + 2], len);
+        used += 2 + len;
+    }
+    return used;
+}
+
+/* decode the whole frames in buf_, and make room for more */
+void ConnectedUser::parse()
+{
+    size_t n = decode_frames(&buf_[qoff_], qsize_);
+    if (isdead_)
+    {
+        qoff_ = 0;
+        qsize_ = 0;
+        return;
+    }
+    qoff_ += (int)n;
+    qsize_ -= (int)n;
+    if (qsize_ == 0)
+    {
+        qoff_ = 0;
+    }
+    else if (qoff_ > 0)
+    {
+        memmove(buf_, &buf_[qoff_], qsize_);
+        qoff_ = 0;
+    }
+}
+
+void ConnectedUser::settle()
+{
+    if (buf_ && qsize_ == 0)
+    {
+        give_recv_buffer(buf_);
+        buf_ = 0;
+        qoff_ = 0;
     }
 }
 
 void ConnectedUser::decode_one(void const *buf, size_t size)
 {
+    tp_frame(sockfd_, size);
+    ++shard_->framesIn_;
     try
     {
         introspection::readonly_stream rs(buf, size);
-        //  size of max packet struct in RAM
-        char pack[256];
-        int d = my_proto.decode(pack, sizeof(pack), rs);
-        dispatcher_.dispatch(d, pack);
+        dispatcher_.decode_and_dispatch(my_proto, rs);
     }
     catch (std::exception const &x)
     {
-        kick(x.what());
+        kick(KICK_BAD_MESSAGE, x.what());
+    }
+    if (!isdead_)
+    {
+        touch();
+    }
+}
+
+void ConnectedUser::touch()
+{
+    shard_->timers_.schedule(&idle_,
+        shard_->now_ + (unsigned long long)(gotinfo_ ? TIMEOUT_CONNECTED : TIMEOUT_NONCONNECTED) * 1000);
+}
+
+void ConnectedUser::on_idle()
+{
+    tp_timeout(sockfd_);
+    ++shard_->timeouts_;
+    die();
+}
+
+void ConnectedUser::on_slow()
+{
+    kick(KICK_TOO_SLOW, "too far behind for too long");
+}
+
+void ConnectedUser::enqueue(shared_frame *frame)
+{
+    queue(frame);
+    if (!isdead_)
+    {
+        drain();
     }
 }
 
-void ConnectedUser::enqueue(void const *data, size_t size)
+void ConnectedUser::queue(shared_frame *frame)
 {
-    if (size + osize_ > sizeof(obuf_))
+    if (throttled_ && !frame->critical())
     {
-        //  this means his networking is lagged out or disconnected
-        kick("failed to drain send buffer in a timely fashion");
+        ++shard_->framesDropped_;
+        tp_drop(sockfd_, frame->size());
+        return;
     }
-    else
+    if (frame->size() + out_.bytes() > HARD_QUEUED_BYTES)
     {
-        if (size + osize_ + ooff_ > sizeof(obuf_))
-        {
-            memmove(obuf_, &obuf_[ooff_], osize_);
-            ooff_ = 0;
-        }
-        memcpy(&obuf_[ooff_ + osize_], data, size);
-        osize_ += size;
+        //  this means their networking is lagged out or disconnected
+        kick(KICK_TOO_SLOW, "failed to drain send buffer in a timely fashion");
+        return;
+    }
+    ++shard_->framesOut_;
+    tp_enqueue(sockfd_, frame->size());
+    out_.push(frame);
+    shard_->queuedBytes_ += frame->size();
+    if (out_.bytes() > shard_->peakQueuedBytes_)
+    {
+        shard_->peakQueuedBytes_ = out_.bytes();
+    }
+    if (!throttled_ && out_.bytes() > HIGH_WATERMARK)
+    {
+        throttled_ = true;
+        ++shard_->throttledUsers_;
+        shard_->timers_.schedule(&slow_, shard_->now_ + (unsigned long long)slow_grace * 1000);
+    }
+}
+
+void ConnectedUser::check_watermark()
+{
+    if (throttled_ && out_.bytes() < LOW_WATERMARK)
+    {
+        throttled_ = false;
+        --shard_->throttledUsers_;
+        shard_->timers_.cancel(&slow_);
     }
 }
 
 void ConnectedUser::drain()
 {
-    int w = ::send(sockfd_, (char const *)&obuf_[ooff_], osize_, 0);
-    if (w < 1)
+    reactor *poller = shard_->poller_;
+    if (poller->completes_io())
     {
-        //  this means his networking is lagged out or disconnected
-        kick("failed to send on socket");
+        //  one write at a time; the rest goes when it's done
+        if (!sending_ && !out_.empty())
+        {
+            frame_ref refs[MAX_SEND_FRAMES];
+            int n = out_.gather(refs, MAX_SEND_FRAMES);
+            if (!poller->send(sockfd_, refs, n))
+            {
+                kick(KICK_SEND_FAILED);
+                return;
+            }
+            sending_ = true;
+        }
+        check_watermark();
+        return;
     }
-    else
+    while (!out_.empty())
     {
-        ooff_ += w;
-        osize_ -= w;
+        ++shard_->syscalls_;
+        int w = out_.send_to(sockfd_);
+        tp_send(sockfd_, w);
+        if (w < 0 && would_block())
+        {
+            break;
+        }
+        if (w < 1)
+        {
+            //  this means their networking is lagged out or disconnected
+            kick(KICK_SEND_FAILED);
+            return;
+        }
+        shard_->bytesOut_ += w;
+        shard_->queuedBytes_ -= w;
     }
+    poller->want_write(sockfd_, !out_.empty());
+    check_watermark();
 }
 
-void ConnectedUser::kick(char const *reason)
+void ConnectedUser::sent(int w)
 {
-    fprintf(stderr, "%s: kicking %s\n", reason, info_.name.c_str());
-    isdead_ = true;
+    tp_send(sockfd_, w);
+    sending_ = false;
+    if (w < 1)
+    {
+        kick(KICK_SEND_FAILED);
+        return;
+    }
+    out_.consume((size_t)w);
+    shard_->bytesOut_ += w;
+    shard_->queuedBytes_ -= w;
+    drain();
+}
+
+void ConnectedUser::kick(KickReason why, char const *detail)
+{
+    fprintf(stderr, "%s: kicking %s\n", detail ? detail : kick_reasons[why], name());
+    tp_kick(sockfd_, why);
+    ++shard_->kicks_[why];
+    die();
     qsize_ = 0;
     qoff_ = 0;
+    //  a completing reactor holds on to what it's writing itself
+    shard_->queuedBytes_ -= out_.bytes();
+    out_.clear();
+}
+
+void ConnectedUser::die()
+{
+    if (!isdead_)
+    {
+        isdead_ = true;
+        shard_->dieing_.push_back(sockfd_);
+        shard_->timers_.cancel(&idle_);
+        shard_->timers_.cancel(&slow_);
+    }
 }
 
 void ConnectedUser::OnLogin(LoginPacket const &lp)
 {
-    UserInfo ui;
     /* Verify that the user exists. I don't use a password.
        */
-    if (!get_user_by_name(lp.name.c_str(), ui))
+    //  a connection is one user; close() only takes user_ off line
+    if (gotinfo_)
     {
-        kick("unknown user name");
+        kick(KICK_LOGGED_IN_TWICE);
+        return;
+    }
+    int who = find_user(lp.name.c_str());
+    if (who < 0)
+    {
+        kick(KICK_UNKNOWN_USER);
         return;
     }
     ConnectedPacket cp;
     cp.result = 1;
     cp.version = 1;
-    for (std::map<int, ref_ptr<ConnectedUser> >::iterator ptr(users.begin()), end(users.end());
-        ptr != end; ++ptr)
+    //  only who is online is copied under the lock; the names are looked 
+    //  up after, and no more are listed than could fit
+    unsigned int listing[MAX_LISTED_BYTES / 4];
+    size_t nlisting = 0;
+    lock_online();
+    bool already = is_online[who] != 0;
+    if (!already)
     {
-        if ((*ptr).second->info_.name == ui.name)
-        {
-            kick("already connected");
-            return;
-        }
-        if ((*ptr).second->gotinfo_)
+        nlisting = online.size() < MAX_LISTED_BYTES / 4 ? online.size() : MAX_LISTED_BYTES / 4;
+        if (nlisting)
         {
-            cp.users.push_back((*ptr).second->info_.name);
+            memcpy(listing, &online[0], nlisting * sizeof(unsigned int));
         }
+        is_online[who] = 1;
+        online_at[who] = (unsigned int)online.size();
+        online.push_back(who);
+    }
+    unlock_online();
+    if (already)
+    {
+        kick(KICK_ALREADY_CONNECTED);
+        return;
+    }
+    size_t listed = 0;
+    for (size_t i = 0; i != nlisting && listed < MAX_LISTED_BYTES; ++i)
+    {
+        std::string const &name = user_at(listing[i]).name;
+        cp.users.push_back(name);
+        listed += 4 + name.size();
     }
     gotinfo_ = true;
-    info_ = ui;
+    ++shard_->loggedIn_;
+    user_ = who;
     //  send the response to the user
     simple_stream ss;
     ss.write_bytes(2, "\0");    //  space for frame size
     my_proto.encode(cp, ss);
-    unsigned char *p = (unsigned char *)ss.unsafe_data();
-    size_t sz = ss.position() - 2;
-    p[0] = (sz >> 8) & 0xff;
-    p[1] = sz & 0xff;
-    enqueue(p, sz + 2);
-
-    ss.set_position(0);
-    ss.truncate_at_pos();
+    shared_frame *frame = shared_frame::from_stream(ss, true);
+    enqueue(frame);
+    frame->release();
+
     UserJoinedPacket ujp;
-    ujp.who = info_.name;
-    enqueue_outgoing(ujp);
+    ujp.who = name();
+    shard_->enqueue_outgoing(ujp);
 }
 
 void ConnectedUser::OnSaySomething(SaySomethingPacket const &ssp)
 {
     if (!gotinfo_)
     {
-        kick("attempt to speak before being logged in");
+        kick(KICK_NOT_LOGGED_IN);
         return;
     }
     SomeoneSaidSomethingPacket sssp;
-    sssp.who = info_.name;
+    sssp.who = name();
     sssp.what = ssp.message;
     if (sssp.what.size() > 100)
     {
@@ -284,110 +796,454 @@ void ConnectedUser::OnSaySomething(SaySomethingPacket const &ssp)
         sssp.what.resize(97);
         sssp.what += "...";
     }
-    enqueue_outgoing(sssp);
+    shard_->enqueue_outgoing(sssp);
+}
+
+void ConnectedUser::OnServerStatsRequest(ServerStatsRequest const &ssr)
+{
+    if (!local_)
+    {
+        kick(KICK_NOT_LOCAL);
+        return;
+    }
+    ServerStats st;
+    collect_stats(st);
+    simple_stream ss;
+    ss.write_bytes(2, "\0");
+    my_proto.encode(st, ss);
+    shared_frame *frame = shared_frame::from_stream(ss, true);
+    enqueue(frame);
+    frame->release();
 }
 
 
-void accept_one()
+ChatShard::ChatShard(int index) :
+    index_(index),
+    asock_(-1),
+    poller_(0),
+    now_(introspection::clock_ns() / 1000000),
+    timers_(now_, TIMER_TICK_MS),
+    reportTimer_(this, &ChatShard::report),
+    syscalls_(0),
+    framesIn_(0),
+    framesOut_(0),
+    framesDropped_(0),
+    lostBroadcasts_(0),
+    reportedSyscalls_(0),
+    reportedFrames_(0),
+    accepts_(0),
+    refused_(0),
+    timeouts_(0),
+    disconnects_(0),
+    bytesIn_(0),
+    bytesOut_(0),
+    queuedBytes_(0),
+    peakQueuedBytes_(0),
+    connections_(0),
+    loggedIn_(0),
+    throttledUsers_(0),
+    queueDepth_(0),
+    framesInPerS_(0),
+    framesOutPerS_(0),
+    ratedIn_(0),
+    ratedOut_(0)
+{
+    memset(kicks_, 0, sizeof(kicks_));
+    memset(tickNs_, 0, sizeof(tickNs_));
+    wake_[0] = wake_[1] = -1;
+    timers_.schedule(&reportTimer_, now_ + REPORT_INTERVAL * 1000);
+}
+
+ChatShard::~ChatShard()
 {
+    while (users_.size())
+    {
+        int sock = users_.at(0)->sockfd_;
+        users_.at(0)->close();
+        users_.erase(sock);
+    }
+    if (asock_ >= 0)
+    {
+        closesocket(asock_);
+    }
+    delete poller_;
+}
+
+bool ChatShard::open(int port, char const *backend, bool shared)
+{
+    poller_ = reactor::create(backend);
+    if (!poller_)
+    {
+        fprintf(stderr, "The %s reactor is not available on this system\n", backend);
+        return false;
+    }
+    asock_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (asock_ < 0)
+    {
+        fprintf(stderr, "Could not create the accepting socket: %d\n", WSAGetLastError());
+        return false;
+    }
+    /* don't wait for the two minute timeout before allowing re-bind after a stopped server is re-started */
+    BOOL one = 1;
+    setsockopt(asock_, SOL_SOCKET, SO_REUSEADDR, (char const *)&one, sizeof(one));
+    if (shared)
+    {
+#if defined(SO_REUSEPORT)
+        if (setsockopt(asock_, SOL_SOCKET, SO_REUSEPORT, (char const *)&one, sizeof(one)) < 0)
+        {
+            fprintf(stderr, "SO_REUSEPORT failed: %d\n", WSAGetLastError());
+            return false;
+        }
+#if !defined(_MSC_VER)
+        if (pipe(wake_) < 0 || !set_nonblocking(wake_[0]) || !set_nonblocking(wake_[1]) || !poller_->watch(wake_[0]))
+        {
+            fprintf(stderr, "Could not create the shard wake-up pipe: %d\n", WSAGetLastError());
+            return false;
+        }
+#endif
+#else
+        fprintf(stderr, "More than one shard needs SO_REUSEPORT, which this system doesn't have\n");
+        return false;
+#endif
+    }
     sockaddr_in sin;
     memset(&sin, 0, sizeof(sin));
-    w32_socklen_t len = sizeof(sin);
-    int sock = accept(asock, (sockaddr *)&sin, &len);
-    if (sock < 0)
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    if (bind(asock_, (sockaddr const *)&sin, sizeof(sin)) < 0)
     {
-        fprintf(stderr, "error accepting socket: %d\n", WSAGetLastError());
-        return;
+        fprintf(stderr, "Could not bind the accepting socket to port %d: %d\n", port, WSAGetLastError());
+        return false;
     }
-    if (users.size() >= MAX_USER_COUNT)
+    if (listen(asock_, 128) < 0)
     {
-        //  just disconnect -- not enough capacity
-        closesocket(sock);
-        return;
+        fprintf(stderr, "listen() failed -- this almost never happens: %d\n", WSAGetLastError());
+        return false;
+    }
+    if (!set_nonblocking(asock_) || !poller_->watch(asock_))
+    {
+        fprintf(stderr, "Could not watch the accepting socket: %d\n", WSAGetLastError());
+        return false;
     }
-    users[sock] = ref_ptr<ConnectedUser>(new ConnectedUser(sock));
+    return true;
 }
 
-void service_loop()
+void ChatShard::run(bool pin)
 {
-    simple_stream ss;
-    ss.write_bytes(2, "\0");
-    //  limit the max size of an individual frame
-    while (queue.size() > 0 && ss.position() < 2000)
+#if defined(__linux__)
+    if (pin)
     {
-        TRACE(emit);
-        queue.front()->emit(ss);
-        queue.pop_front();
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        CPU_SET(index_ % (ncpu > 0 ? ncpu : 1), &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        {
+            fprintf(stderr, "shard %d: could not pin to a CPU\n", index_);
+        }
     }
-    size_t sz = ss.position() - 2;
-    unsigned char *p = (unsigned char *)ss.unsafe_data();
-    p[0] = (sz >> 8) & 0xff;
-    p[1] = sz & 0xff;
+#endif
+    while (true)
+    {
+        service_loop();
+    }
+}
 
-    fd_set fdrd, fdwr;
-    FD_ZERO(&fdrd);
-    FD_ZERO(&fdwr);
-    FD_SET(asock, &fdrd);
-    int top = asock;
-    for (std::map<int, ref_ptr<ConnectedUser> >::iterator ptr(users.begin()), end(users.end());
-            ptr != end; ++ptr)
+void ChatShard::post(shared_frame *frame)
+{
+    bool wake = inbox_.push(frame);
+#if !defined(_MSC_VER)
+    if (wake && wake_[1] >= 0)
     {
-        if (sz > 0)
+        //  if the pipe is full, the shard is awake already
+        char c = 0;
+        int w = ::write(wake_[1], &c, 1);
+        (void)w;
+    }
+#else
+    (void)wake;
+#endif
+}
+
+void ChatShard::accept_all()
+{
+    while (true)
+    {
+        sockaddr_in sin;
+        memset(&sin, 0, sizeof(sin));
+        w32_socklen_t len = sizeof(sin);
+        ++syscalls_;
+        int sock = accept(asock_, (sockaddr *)&sin, &len);
+        if (sock < 0)
         {
-            TRACE(enqueue);
-            (*ptr).second->enqueue(ss.unsafe_data(), ss.position());
+            if (!would_block())
+            {
+                fprintf(stderr, "error accepting socket: %d\n", WSAGetLastError());
+            }
+            return;
         }
-        FD_SET((*ptr).first, &fdrd);
-        if ((*ptr).second->osize_ > 0)
+        //  the accepting socket takes one of the reactor's slots
+        if (users_.size() + 1 >= poller_->capacity() || !set_nonblocking(sock) || !poller_->add(sock))
         {
-            FD_SET((*ptr).first, &fdwr);
+            //  just disconnect -- not enough capacity
+            closesocket(sock);
+            ++refused_;
+            continue;
         }
-        if ((*ptr).first > top)
+        //  frames go out as soon as they're made; waiting to fill a packet 
+        //  would hold them until the user's ACK of the last one
+        BOOL one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char const *)&one, sizeof(one));
+        tp_accept(sock);
+        ++accepts_;
+        ++connections_;
+        bool local = (ntohl(sin.sin_addr.s_addr) >> 24) == 127;
+        users_.insert(sock)->open(this, sock, local);
+    }
+}
+
+void ChatShard::service_loop()
+{
+    //  what the other shards broadcast since last time
+    incoming_.clear();
+    inbox_.take_all(incoming_);
+
+    //  who comes and goes goes in frames of their own, which even users 
+    //  who are behind get, so their list of who's online stays right
+    simple_stream presence;
+    simple_stream chat;
+    presence.write_bytes(2, "\0");
+    chat.write_bytes(2, "\0");
+    //  the messages are encoded already; they just go in frames, which 
+    //  are cut at about 2 kB
+    size_t size;
+    bool critical;
+    while (outgoing_.front(size, critical))
+    {
+        simple_stream &ss = critical ? presence : chat;
+        if (ss.position() + size > 2000 && ss.position() > 2)
         {
-            top = (*ptr).first;
+            emit(ss, critical);
         }
+        outgoing_.pop_to(ss);
     }
-    TRACE(select);
-    select(top+1, &fdrd, &fdwr, 0, 0);
-    TRACE(select_done);
-    if (FD_ISSET(asock, &fdrd))
+    emit(presence, true);
+    emit(chat, false);
+    //  each user gets all of the frames queued, then one send for them
+    if (!incoming_.empty())
     {
-        TRACE(accept_one);
-        accept_one();
+        for (size_t u = 0; u != users_.size(); ++u)
+        {
+            ConnectedUser *cu = users_.at(u);
+            for (size_t i = 0; i != incoming_.size() && !cu->is_dead(); ++i)
+            {
+                cu->queue(incoming_[i]);
+            }
+            if (!cu->is_dead())
+            {
+                cu->drain();
+            }
+        }
     }
-    std::list<int> dieing;
-    time_t now;
-    time(&now);
-    for (std::map<int, ref_ptr<ConnectedUser> >::iterator ptr(users.begin()), end(users.end());
-        ptr != end; ++ptr)
+    for (size_t i = 0; i != incoming_.size(); ++i)
     {
-        if (FD_ISSET((*ptr).first, &fdwr))
+        incoming_[i]->release();
+    }
+
+    //  only the sockets that have something to say come back
+    reactor_event events[256];
+    //  nothing to do until the next timer, unless a socket has news
+    now_ = introspection::clock_ns() / 1000000;
+    int timeout = outgoing_.empty() ? (int)timers_.next_timeout(now_) : 0;
+    tp_wait(-1, timeout);
+    int n = poller_->wait(events, 256, timeout);
+    tp_woke(-1, n);
+    unsigned long long woke = introspection::clock_ns();
+    now_ = woke / 1000000;
+    for (int i = 0; i != n; ++i)
+    {
+        if (events[i].sock == asock_)
+        {
+            accept_all();
+            continue;
+        }
+#if !defined(_MSC_VER)
+        if (events[i].sock == wake_[0])
+        {
+            //  the frames are picked up at the top of the next tick
+            char tmp[64];
+            do
+            {
+                ++syscalls_;
+            }
+            while (::read(wake_[0], tmp, sizeof(tmp)) > 0);
+            continue;
+        }
+#endif
+        ConnectedUser *cu = users_.find(events[i].sock);
+        if (!cu || cu->is_dead())
+        {
+            continue;
+        }
+        if (events[i].events & REACTOR_WRITE)
+        {
+            cu->drain();
+        }
+        if (events[i].events & REACTOR_READ)
+        {
+            cu->service();
+        }
+        if (events[i].events & REACTOR_SENT)
         {
-            TRACE(drain);
-            (*ptr).second->drain();
+            cu->sent(events[i].result);
         }
-        if (FD_ISSET((*ptr).first, &fdrd))
+        if (events[i].events & REACTOR_RECEIVED)
         {
-            TRACE(service);
-            (*ptr).second->service();
+            cu->received(events[i].data, events[i].result);
         }
-        if ((*ptr).second->is_dead() || (*ptr).second->is_timed_out(now))
+    }
+
+    //  only the timers that are due are looked at, however many users
+    size_t fired = timers_.advance(now_);
+    if (fired)
+    {
+        tp_timers(-1, fired);
+    }
+    for (size_t i = 0; i != dieing_.size(); ++i)
+    {
+        tp_erase(dieing_[i]);
+        poller_->remove(dieing_[i]);
+        users_.find(dieing_[i])->close();
+        users_.erase(dieing_[i]);
+        --connections_;
+    }
+    dieing_.clear();
+    queueDepth_ = (unsigned int)outgoing_.size();
+
+    //  whichever shard sees the request first does it
+    if (trace_save_requested && introspection::atomic_cas(&trace_save_requested, 1, 0))
+    {
+        save_trace();
+    }
+
+    unsigned long long took = introspection::clock_ns() - woke;
+    int bucket = 0;
+    while (took > 1 && bucket < PDU_HISTOGRAM_BUCKETS - 1)
+    {
+        took >>= 1;
+        ++bucket;
+    }
+    ++tickNs_[bucket];
+}
+
+void ChatShard::emit(simple_stream &ss, bool critical)
+{
+    if (ss.position() <= 2)
+    {
+        return;
+    }
+    //  one frame, which every user's queue refers to, on every shard
+    shared_frame *frame = shared_frame::from_stream(ss, critical);
+    tp_emit(-1, frame->size());
+    for (size_t i = 0; i != shards.size(); ++i)
+    {
+        if (shards[i] != this)
         {
-            TRACE(dieing);
-            dieing.push_back((*ptr).first);
+            frame->add_ref();
+            shards[i]->post(frame);
         }
     }
-    for (std::list<int>::iterator ptr(dieing.begin()), end(dieing.end());
-        ptr != end; ++ptr)
+    incoming_.push_back(frame);
+    ss.set_position(2);
+}
+
+void ChatShard::report()
+{
+    timers_.schedule(&reportTimer_, now_ + REPORT_INTERVAL * 1000);
+    framesInPerS_ = (unsigned int)((framesIn_ - ratedIn_) / REPORT_INTERVAL);
+    framesOutPerS_ = (unsigned int)((framesOut_ - ratedOut_) / REPORT_INTERVAL);
+    ratedIn_ = framesIn_;
+    ratedOut_ = framesOut_;
+    unsigned long long calls = syscalls_ + poller_->syscalls();
+    unsigned long long frames = framesIn_ + framesOut_;
+    if (frames == reportedFrames_)
+    {
+        return;
+    }
+    //  a message is a frame a user sent, or one sent to a user
+    fprintf(stderr, "shard %d (%s): %llu frames in, %llu out, %llu dropped, %ld broadcasts lost, %.2f system calls per frame\n",
+        index_, poller_->name(), framesIn_, framesOut_, framesDropped_, introspection::atomic_load_acquire(&lostBroadcasts_),
+        (double)(calls - reportedSyscalls_) / (double)(frames - reportedFrames_));
+    reportedSyscalls_ = calls;
+    reportedFrames_ = frames;
+}
+
+void ChatShard::add_stats(ServerStats &oStats) const
+{
+    oStats.connections += connections_;
+    oStats.logged_in += loggedIn_;
+    oStats.accepts += accepts_;
+    oStats.refused += refused_;
+    for (int i = 0; i != KICK_REASONS; ++i)
+    {
+        oStats.kicks[i].count += kicks_[i];
+    }
+    oStats.timeouts += timeouts_;
+    oStats.disconnects += disconnects_;
+    oStats.bytes_in += bytesIn_;
+    oStats.bytes_out += bytesOut_;
+    oStats.frames_in += framesIn_;
+    oStats.frames_out += framesOut_;
+    oStats.frames_dropped += framesDropped_;
+    oStats.frames_in_per_s += framesInPerS_;
+    oStats.frames_out_per_s += framesOutPerS_;
+    oStats.queue_depth += queueDepth_;
+    oStats.queued_bytes += queuedBytes_;
+    if (peakQueuedBytes_ > oStats.peak_queued_bytes)
+    {
+        oStats.peak_queued_bytes = peakQueuedBytes_;
+    }
+    oStats.throttled += throttledUsers_;
+    for (int i = 0; i != PDU_HISTOGRAM_BUCKETS; ++i)
     {
-        TRACE(erase);
-        users.erase(*ptr);
+        oStats.tick_ns_log2[i] += tickNs_[i];
     }
 }
 
+static void collect_stats(ServerStats &oStats)
+{
+    oStats.shards = (unsigned int)shards.size();
+    oStats.uptime_s = (introspection::clock_ns() / 1000000 - started_ms) / 1000;
+    oStats.connections = oStats.logged_in = 0;
+    oStats.accepts = oStats.refused = oStats.timeouts = oStats.disconnects = 0;
+    oStats.bytes_in = oStats.bytes_out = 0;
+    oStats.frames_in = oStats.frames_out = oStats.frames_dropped = 0;
+    oStats.frames_in_per_s = oStats.frames_out_per_s = 0;
+    oStats.queue_depth = oStats.throttled = 0;
+    oStats.queued_bytes = oStats.peak_queued_bytes = 0;
+    oStats.kicks.resize(KICK_REASONS);
+    for (int i = 0; i != KICK_REASONS; ++i)
+    {
+        oStats.kicks[i].reason = kick_reasons[i];
+        oStats.kicks[i].count = 0;
+    }
+    oStats.tick_ns_log2.assign(PDU_HISTOGRAM_BUCKETS, 0);
+    for (size_t i = 0; i != shards.size(); ++i)
+    {
+        shards[i]->add_stats(oStats);
+    }
+}
+
+static bool pin_shards;
+
+static void shard_thread(void *arg)
+{
+    ((ChatShard *)arg)->run(pin_shards);
+}
+
 static void usage()
 {
-    fprintf(stderr, "usage: server port\n");
+    fprintf(stderr, "usage: server port [epoll|uring|select] [threads] [pin] [slow=seconds] [trace=level]\n");
 }
 
 void do_server(int argc, char const *argv[])
@@ -397,7 +1253,10 @@ void do_server(int argc, char const *argv[])
         fprintf(stderr, "can't load userlist.txt -- please create one with 'edit' first\n");
         return;
     }
-    if (argc != 2)
+    is_online.assign(count_users(), 0);
+    online_at.assign(count_users(), 0);
+    online.reserve(count_users());
+    if (argc < 2)
     {
         usage();
         return;
@@ -408,40 +1267,93 @@ void do_server(int argc, char const *argv[])
         usage();
         return;
     }
-    
-    WSADATA wsad;
-    memset(&wsad, 0, sizeof(wsad));
-    if (WSAStartup(MAKEWORD(2, 2), &wsad) < 0)
+    char const *backend = 0;
+    int nshards = 1;
+    bool pin = false;
+    for (int i = 2; i < argc; ++i)
     {
-        fprintf(stderr, "Could not start WinSock\n");
-        return;
+        if (!strcmp(argv[i], "pin"))
+        {
+            pin = true;
+        }
+        else if (!strncmp(argv[i], "trace=", 6))
+        {
+            set_trace_level(atoi(argv[i] + 6));
+        }
+        else if (!strncmp(argv[i], "slow=", 5))
+        {
+            slow_grace = atol(argv[i] + 5);
+            if (slow_grace < 1)
+            {
+                usage();
+                return;
+            }
+        }
+        else if (isdigit((unsigned char)argv[i][0]))
+        {
+            nshards = atoi(argv[i]);
+        }
+        else
+        {
+            backend = argv[i];
+        }
     }
-    asock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (asock < 0)
+    if (nshards < 1 || nshards > 256)
     {
-        fprintf(stderr, "Could not create the accepting socket: %d\n", WSAGetLastError());
+        usage();
         return;
     }
-    /* don't wait for the two minute timeout before allowing re-bind after a stopped server is re-started */
-    BOOL one = 1;
-    setsockopt(asock, SOL_SOCKET, SO_REUSEADDR, (char const *)&one, sizeof(one));
-    sockaddr_in sin;
-    memset(&sin, 0, sizeof(sin));
-    sin.sin_family = AF_INET;
-    sin.sin_port = htons(port);
-    if (bind(asock, (sockaddr const *)&sin, sizeof(sin)) < 0)
+
+    //  build all the type info now, rather than on the first message of each 
+    //  type -- and before there are threads to race for it
+    warm_up_report_t report;
+    warm_up(&report);
+    started_ms = introspection::clock_ns() / 1000000;
+    std::string text;
+    to_json(report, text);
+    fprintf(stderr, "warm_up: %s\n", text.c_str());
+    
+    WSADATA wsad;
+    memset(&wsad, 0, sizeof(wsad));
+    if (WSAStartup(MAKEWORD(2, 2), &wsad) < 0)
     {
-        fprintf(stderr, "Could not bind the accepting socket to port %d: %d\n", port, WSAGetLastError());
+        fprintf(stderr, "Could not start WinSock\n");
         return;
     }
-    if (listen(asock, 10) < 0)
+#if !defined(_MSC_VER)
+    //  a user who goes away while data is on its way is not a reason to stop
+    signal(SIGPIPE, SIG_IGN);
+#endif
+#if defined(SIGUSR1)
+    signal(SIGUSR1, &step_trace_level);
+    signal(SIGUSR2, &request_trace_save);
+#endif
+    for (int i = 0; i != nshards; ++i)
     {
-        fprintf(stderr, "listen() failed -- this almost never happens: %d\n", WSAGetLastError());
-        return;
+        shards.push_back(new ChatShard(i));
+        if (!shards.back()->open(port, backend, nshards > 1))
+        {
+            return;
+        }
     }
+    fprintf(stderr, "serving port %d using %s, %d shard%s%s\n", port, shards[0]->poller_->name(),
+        nshards, nshards > 1 ? "s" : "", pin ? ", pinned" : "");
 
-    while (true)
+    //  the calling thread is the first shard
+    pin_shards = pin;
+    for (int i = 1; i != nshards; ++i)
     {
-        service_loop();
+        uintptr_t thr = _beginthread(&shard_thread, 0, shards[i]);
+#if defined(_MSC_VER)
+        //  the CRT says it failed with -1; not_win32.h says 0
+        if (thr == (uintptr_t)-1)
+#else
+        if (!thr)
+#endif
+        {
+            fprintf(stderr, "Could not start shard %d\n", i);
+            return;
+        }
     }
+    shards[0]->run(pin);
 }
@@ -0,0 +1,136 @@
+
+#if defined(_MSC_VER)
+#include <WinSock2.h>
+#include <Windows.h>
+#else
+#include <introspection/not_win32.h>
+#endif
+#include <stdio.h>
+#include <introspection/sample_chat.h>
+
+EXTERN_PROTOCOL(my_proto);
+
+/* Asks a server on this host for its ServerStats, and prints each member
+   as to_text() has it, with its description. */
+static void usage()
+{
+    fprintf(stderr, "usage: stats servername port\n");
+}
+
+static bool recv_all(int sock, unsigned char *buf, size_t size)
+{
+    while (size > 0)
+    {
+        int r = recv(sock, (char *)buf, (int)size, 0);
+        if (r < 1)
+        {
+            return false;
+        }
+        buf += r;
+        size -= r;
+    }
+    return true;
+}
+
+void do_stats(int argc, char const *argv[])
+{
+    if (argc != 3)
+    {
+        usage();
+        return;
+    }
+    int port = atoi(argv[2]);
+    if (port < 1 || port > 65535)
+    {
+        usage();
+        return;
+    }
+    WSADATA wsad;
+    memset(&wsad, 0, sizeof(wsad));
+    if (WSAStartup(MAKEWORD(2, 2), &wsad) != 0)
+    {
+        fprintf(stderr, "WSAStartup() failed\n");
+        return;
+    }
+    struct hostent *hent = gethostbyname(argv[1]);
+    if (!hent)
+    {
+        fprintf(stderr, "%s: host not found\n", argv[1]);
+        return;
+    }
+    sockaddr_in sad;
+    memset(&sad, 0, sizeof(sad));
+    sad.sin_family = AF_INET;
+    memcpy(&sad.sin_addr, hent->h_addr_list[0], 4);
+    sad.sin_port = htons(port);
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0 || connect(sock, (sockaddr *)&sad, sizeof(sad)) < 0)
+    {
+        fprintf(stderr, "could not connect to %s port %d\n", argv[1], port);
+        return;
+    }
+
+    ServerStatsRequest ssr;
+    ssr.version = 1;
+    simple_stream ss;
+    ss.write_bytes(2, "\0");
+    my_proto.encode(ssr, ss);
+    unsigned char *p = (unsigned char *)ss.unsafe_data();
+    size_t sz = ss.position() - 2;
+    p[0] = (sz >> 8) & 0xff;
+    p[1] = sz & 0xff;
+    if (::send(sock, (char const *)p, (int)(sz + 2), 0) != (int)(sz + 2))
+    {
+        fprintf(stderr, "could not send the request\n");
+        closesocket(sock);
+        return;
+    }
+
+    //  chat that's broadcast meanwhile comes too; skip it
+    ServerStats st;
+    bool got = false;
+    while (!got)
+    {
+        unsigned char hdr[2];
+        std::vector<unsigned char> frame;
+        if (recv_all(sock, hdr, 2))
+        {
+            frame.resize((hdr[0] << 8) | hdr[1]);
+        }
+        if (frame.empty() || !recv_all(sock, &frame[0], frame.size()))
+        {
+            fprintf(stderr, "the server closed the connection (only requests from its own host are answered)\n");
+            closesocket(sock);
+            return;
+        }
+        try
+        {
+            readonly_stream rs(&frame[0], frame.size());
+            while (rs.bytes_left() > 0 && !got)
+            {
+                void *pdu = 0;
+                int code = my_proto.decode_pooled(pdu, rs);
+                if (code == my_proto.code<ServerStats>())
+                {
+                    st = *(ServerStats *)pdu;
+                    got = true;
+                }
+                my_proto.release(code, pdu);
+            }
+        }
+        catch (std::exception const &x)
+        {
+            fprintf(stderr, "bad answer: %s\n", x.what());
+            closesocket(sock);
+            return;
+        }
+    }
+    closesocket(sock);
+    type_info_base const &ti = ServerStats::member_info();
+    for (member_t::iterator ptr(ti.begin()), end(ti.end()); ptr != end; ++ptr)
+    {
+        std::string text;
+        (*ptr).access().to_text(&st, text);
+        printf("%-18s %s\n    (%s)\n", (*ptr).name(), text.c_str(), (*ptr).info().desc());
+    }
+}
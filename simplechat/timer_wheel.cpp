@@ -0,0 +1,216 @@
+
+#include "timer_wheel.h"
+
+static void unlink(timer_link *l)
+{
+    l->prev->next = l->next;
+    l->next->prev = l->prev;
+    l->prev = l->next = l;
+}
+
+static void link_before(timer_link *head, timer_link *l)
+{
+    l->prev = head->prev;
+    l->next = head;
+    head->prev->next = l;
+    head->prev = l;
+}
+
+/* move everything in the list at from to the (empty) list at to */
+static void splice(timer_link *from, timer_link *to)
+{
+    if (from->next == from)
+    {
+        to->prev = to->next = to;
+        return;
+    }
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    from->prev = from->next = from;
+}
+
+timer::timer() :
+    wheel_(0),
+    due_(0)
+{
+    prev = next = this;
+}
+
+timer::~timer()
+{
+    if (wheel_)
+    {
+        wheel_->cancel(this);
+    }
+}
+
+timer_wheel::timer_wheel(unsigned long long now_ms, unsigned int tick_ms) :
+    tickMs_(tick_ms ? tick_ms : 1),
+    startMs_(now_ms),
+    now_(0),
+    count_(0)
+{
+    for (int w = 0; w != WHEELS; ++w)
+    {
+        for (int s = 0; s != SLOTS; ++s)
+        {
+            slots_[w][s].prev = slots_[w][s].next = &slots_[w][s];
+        }
+    }
+}
+
+timer_wheel::~timer_wheel()
+{
+    //  the timers outlive us; they're just not scheduled any more
+    for (int w = 0; w != WHEELS; ++w)
+    {
+        for (int s = 0; s != SLOTS; ++s)
+        {
+            while (slots_[w][s].next != &slots_[w][s])
+            {
+                timer *t = static_cast<timer *>(slots_[w][s].next);
+                unlink(t);
+                t->wheel_ = 0;
+            }
+        }
+    }
+}
+
+void timer_wheel::schedule(timer *t, unsigned long long due_ms)
+{
+    if (t->wheel_)
+    {
+        t->wheel_->cancel(t);
+    }
+    //  round up, so a timer never fires early
+    unsigned long long due = due_ms > startMs_ ? (due_ms - startMs_ + tickMs_ - 1) / tickMs_ : 0;
+    //  the slot for this tick is done with
+    if (due <= now_)
+    {
+        due = now_ + 1;
+    }
+    t->due_ = due;
+    t->wheel_ = this;
+    ++count_;
+    place(t);
+}
+
+void timer_wheel::cancel(timer *t)
+{
+    if (t->wheel_ == this)
+    {
+        unlink(t);
+        t->wheel_ = 0;
+        --count_;
+    }
+}
+
+/* In the first wheel that reaches the timer's tick. The slot of each wheel
+   for the current tick is done with, so a timer goes in the slot of the
+   right wheel's next turn, if that's where its tick falls. */
+void timer_wheel::place(timer *t)
+{
+    unsigned long long delta = t->due_ > now_ ? t->due_ - now_ : 0;
+    for (int w = 0; w != WHEELS; ++w)
+    {
+        int shift = w * SLOT_BITS;
+        if (delta < (1ULL << (shift + SLOT_BITS)) || w == WHEELS - 1)
+        {
+            if (w == WHEELS - 1 && delta >= (1ULL << (shift + SLOT_BITS)))
+            {
+                //  further out than the wheels go: fire at the far end
+                t->due_ = now_ + (1ULL << (shift + SLOT_BITS)) - 1;
+            }
+            link_before(&slots_[w][(t->due_ >> shift) & (SLOTS - 1)], t);
+            return;
+        }
+    }
+}
+
+void timer_wheel::move_down(int wheel, int slot)
+{
+    timer_link list;
+    splice(&slots_[wheel][slot], &list);
+    while (list.next != &list)
+    {
+        timer *t = static_cast<timer *>(list.next);
+        unlink(t);
+        place(t);
+    }
+}
+
+size_t timer_wheel::advance(unsigned long long now_ms)
+{
+    unsigned long long target = now_ms > startMs_ ? (now_ms - startMs_) / tickMs_ : 0;
+    size_t fired = 0;
+    while (now_ < target)
+    {
+        if (count_ == 0)
+        {
+            now_ = target;
+            break;
+        }
+        ++now_;
+        //  each wheel that has come round to a new slot hands it down
+        for (int w = 1; w != WHEELS; ++w)
+        {
+            int shift = w * SLOT_BITS;
+            if (now_ & ((1ULL << shift) - 1))
+            {
+                break;
+            }
+            move_down(w, (int)((now_ >> shift) & (SLOTS - 1)));
+        }
+        //  A timer may schedule or cancel others (or itself) as it fires,
+        //  so the due ones are taken out of the wheel first.
+        timer_link due;
+        splice(&slots_[0][now_ & (SLOTS - 1)], &due);
+        while (due.next != &due)
+        {
+            timer *t = static_cast<timer *>(due.next);
+            unlink(t);
+            t->wheel_ = 0;
+            --count_;
+            ++fired;
+            t->on_timer();
+        }
+    }
+    return fired;
+}
+
+long timer_wheel::next_timeout(unsigned long long now_ms) const
+{
+    if (count_ == 0)
+    {
+        return -1;
+    }
+    unsigned long long next = 0;
+    for (int w = 0; w != WHEELS; ++w)
+    {
+        int shift = w * SLOT_BITS;
+        unsigned long long turn = now_ >> shift;
+        //  the slot for this turn is done; one turn on, it's the last
+        for (unsigned long long k = 1; k <= SLOTS; ++k)
+        {
+            timer_link const &head = slots_[w][(turn + k) & (SLOTS - 1)];
+            if (head.next != &head)
+            {
+                unsigned long long at = (turn + k) << shift;
+                if (!next || at < next)
+                {
+                    next = at;
+                }
+                break;
+            }
+        }
+    }
+    unsigned long long at_ms = startMs_ + next * tickMs_;
+    if (at_ms <= now_ms)
+    {
+        return 0;
+    }
+    unsigned long long wait = at_ms - now_ms;
+    return wait > 0x7fffffffUL ? 0x7fffffffL : (long)wait;
+}
@@ -0,0 +1,108 @@
+
+#if !defined(simplechat_timer_wheel_h)
+#define simplechat_timer_wheel_h
+
+#include <stddef.h>
+
+/* A hierarchical timer wheel: four wheels of 64 slots each, where a slot of
+   the first is one tick, and a slot of each next wheel is a whole turn of
+   the one before it. A timer goes in the slot of the first wheel that
+   reaches far enough; when a wheel comes round to a slot, the timers in it
+   move down to the wheel below, and the ones in the first wheel's slot are
+   due. Scheduling, rescheduling and cancelling are O(1) (timers are links
+   in a list), and advancing costs only the timers that are due, plus the
+   ones that move down, which each do at most three times. Nothing looks
+   at timers that aren't near due, so a timeout per connection costs
+   nothing while the connection is busy.
+
+   Times are in milliseconds on any clock that only goes forward; timers
+   fire on the first advance() at or after their tick.
+   */
+
+class timer_wheel;
+
+struct timer_link
+{
+    timer_link *prev;
+    timer_link *next;
+};
+
+/* Something to do at a time. A timer is in at most one wheel, at most
+   once; destroying it cancels it. */
+class timer : private timer_link
+{
+    public:
+        timer();
+        virtual ~timer();
+        inline bool scheduled() const { return wheel_ != 0; }
+        /* called by advance(), once the timer is due, and no longer
+           scheduled; it may schedule itself again */
+        virtual void on_timer() = 0;
+
+    private:
+        friend class timer_wheel;
+        timer(timer const &);
+        timer &operator=(timer const &);
+        timer_wheel *wheel_;
+        unsigned long long due_;
+};
+
+/* a timer that calls a member function */
+template<typename T>
+class member_timer : public timer
+{
+    public:
+        member_timer(T *obj, void (T::*func)()) :
+            obj_(obj),
+            func_(func)
+        {
+        }
+        void on_timer()
+        {
+            (obj_->*func_)();
+        }
+
+    private:
+        T *obj_;
+        void (T::*func_)();
+};
+
+class timer_wheel
+{
+    public:
+        /* the wheel starts at now_ms, and turns tick_ms at a time */
+        timer_wheel(unsigned long long now_ms, unsigned int tick_ms);
+        ~timer_wheel();
+        /* Fire at (or just after) due_ms; a timer that's already scheduled
+           is moved. Times in the past fire on the next advance(). */
+        void schedule(timer *t, unsigned long long due_ms);
+        void cancel(timer *t);
+        /* fire everything that's due by now_ms; returns how many fired */
+        size_t advance(unsigned long long now_ms);
+        /* How long from now_ms until advance() has something to do (fire a
+           timer, or move some down a wheel), for waiting on; -1 if there
+           are no timers. */
+        long next_timeout(unsigned long long now_ms) const;
+        inline size_t size() const { return count_; }
+
+    private:
+        timer_wheel(timer_wheel const &);
+        timer_wheel &operator=(timer_wheel const &);
+        enum
+        {
+            WHEELS = 4,
+            SLOT_BITS = 6,
+            SLOTS = 1 << SLOT_BITS
+        };
+        void place(timer *t);
+        void move_down(int wheel, int slot);
+        unsigned int tickMs_;
+        unsigned long long startMs_;
+        /* the last tick advance() did */
+        unsigned long long now_;
+        size_t count_;
+        /* each slot is the head of a circular list */
+        timer_link slots_[WHEELS][SLOTS];
+};
+
+#endif  //  simplechat_timer_wheel_h
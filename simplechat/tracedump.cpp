@@ -0,0 +1,65 @@
+
+#if !defined(_MSC_VER)
+#include <introspection/not_win32.h>
+#endif
+#include <stdio.h>
+#include <introspection/trace.h>
+
+using namespace introspection;
+
+/* Reads a trace the server saved (on SIGUSR2), and prints every event, or
+   with "summary", how many there were of each, and how long it was from
+   each to whatever came next on its thread -- for the "wait" point, that's
+   how long the server slept; for the others, roughly how long that step
+   took.
+   */
+static void usage()
+{
+    fprintf(stderr, "usage: trace file [summary]\n");
+}
+
+void do_trace(int argc, char const *argv[])
+{
+    if (argc != 2 && !(argc == 3 && !strcmp(argv[2], "summary")))
+    {
+        usage();
+        return;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (!f)
+    {
+        fprintf(stderr, "%s: can't open\n", argv[1]);
+        return;
+    }
+    std::vector<char> data;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    trace_t trace;
+    try
+    {
+        readonly_stream rs(data.empty() ? 0 : &data[0], data.size());
+        trace_read(rs, trace);
+    }
+    catch (std::exception const &x)
+    {
+        fprintf(stderr, "%s: %s\n", argv[1], x.what());
+        return;
+    }
+    std::string text;
+    if (argc == 3)
+    {
+        std::vector<trace_summary_t> summary;
+        trace_summarize(trace, summary);
+        to_text(summary, text);
+    }
+    else
+    {
+        to_text(trace, text);
+    }
+    fwrite(text.data(), 1, text.size(), stdout);
+}
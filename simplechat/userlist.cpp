@@ -6,6 +6,61 @@
 static char const *userlist_path;
 static std::vector<UserInfo> userlist;
 
+/* Hash indexes of the list, by name and by e-mail address: the position 
+   in userlist, plus one, or 0 for an empty slot. Open addressing with 
+   linear probing (like a type's member index), a power of two in size, 
+   and at most half full. Adding a user adds to them; anything that moves 
+   users around builds them again. */
+static std::vector<unsigned int> by_name;
+static std::vector<unsigned int> by_email;
+
+static void index_add(std::vector<unsigned int> &index, std::string UserInfo::*key, unsigned int pos)
+{
+    std::string const &k = userlist[pos].*key;
+    size_t mask = index.size() - 1;
+    size_t slot = introspection::hash_name(k.data(), k.size()) & mask;
+    while (index[slot] != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    index[slot] = pos + 1;
+}
+
+static int index_find(std::vector<unsigned int> const &index, std::string UserInfo::*key, char const *value)
+{
+    if (index.empty())
+    {
+        return -1;
+    }
+    size_t len = strlen(value);
+    size_t mask = index.size() - 1;
+    for (size_t slot = introspection::hash_name(value, len) & mask; index[slot] != 0; slot = (slot + 1) & mask)
+    {
+        std::string const &k = userlist[index[slot] - 1].*key;
+        if (k.size() == len && !memcmp(k.data(), value, len))
+        {
+            return (int)index[slot] - 1;
+        }
+    }
+    return -1;
+}
+
+static void build_indexes()
+{
+    size_t size = 16;
+    while (size < userlist.size() * 2 + 2)
+    {
+        size <<= 1;
+    }
+    by_name.assign(size, 0);
+    by_email.assign(size, 0);
+    for (unsigned int i = 0; i != userlist.size(); ++i)
+    {
+        index_add(by_name, &UserInfo::name, i);
+        index_add(by_email, &UserInfo::email, i);
+    }
+}
+
 bool load_userlist()
 {
     char const *names[] = {
@@ -43,6 +98,7 @@ bool load_userlist()
         userlist.push_back(ui);
     }
     fclose(f);
+    build_indexes();
     return true;
 }
 
@@ -82,18 +138,23 @@ void get_user_by_index(unsigned int index, UserInfo &ui)
     ui = userlist[index];
 }
 
-bool get_user_by_name(char const *name, UserInfo &ui)
+UserInfo const &user_at(unsigned int index)
 {
-    for (std::vector<UserInfo>::iterator ptr(userlist.begin()), end(userlist.end());
-            ptr != end; ++ptr)
+    if (index >= userlist.size())
     {
-        if ((*ptr).name == name)
-        {
-            ui = *ptr;
-            return true;
-        }
+        throw std::runtime_error("user_at(): index out of range");
     }
-    return false;
+    return userlist[index];
+}
+
+int find_user(char const *name)
+{
+    return index_find(by_name, &UserInfo::name, name);
+}
+
+int find_user_by_email(char const *email)
+{
+    return index_find(by_email, &UserInfo::email, email);
 }
 
 bool update_user_by_index(unsigned int index, UserInfo const &ui)
@@ -102,15 +163,17 @@ bool update_user_by_index(unsigned int index, UserInfo const &ui)
     {
         return false;
     }
-    for (std::vector<UserInfo>::iterator ptr(userlist.begin()), end(userlist.end());
-            ptr != end; ++ptr)
+    int other = find_user(ui.name.c_str());
+    if (other >= 0 && (unsigned int)other != index)
     {
-        if ((*ptr).name == ui.name && ptr-userlist.begin() != index)
-        {
-            return false;
-        }
+        return false;
     }
+    bool moved = userlist[index].name != ui.name || userlist[index].email != ui.email;
     userlist[index] = ui;
+    if (moved)
+    {
+        build_indexes();
+    }
     return true;
 }
 
@@ -121,19 +184,25 @@ void delete_user_by_index(unsigned int index)
         throw std::runtime_error("get_user_by_index(): index out of range");
     }
     userlist.erase(userlist.begin() + index);
+    build_indexes();
 }
 
 bool new_user(UserInfo const &ui)
 {
-    for (std::vector<UserInfo>::iterator ptr(userlist.begin()), end(userlist.end());
-            ptr != end; ++ptr)
+    if (find_user(ui.name.c_str()) >= 0)
     {
-        if ((*ptr).name == ui.name)
-        {
-            return false;
-        }
+        return false;
     }
     userlist.push_back(ui);
+    if (userlist.size() * 2 + 2 > by_name.size())
+    {
+        build_indexes();
+    }
+    else
+    {
+        index_add(by_name, &UserInfo::name, (unsigned int)userlist.size() - 1);
+        index_add(by_email, &UserInfo::email, (unsigned int)userlist.size() - 1);
+    }
     return true;
 }
 
@@ -8,7 +8,12 @@ bool load_userlist();
 bool save_userlist();
 unsigned int count_users();
 void get_user_by_index(unsigned int index, UserInfo &ui);
-bool get_user_by_name(char const *name, UserInfo &ui);
+/* the position of the user with that name, or -1; a hash lookup */
+int find_user(char const *name);
+/* the same by e-mail address; if more than one user has it, one of them */
+int find_user_by_email(char const *email);
+/* good until the list changes */
+UserInfo const &user_at(unsigned int index);
 bool update_user_by_index(unsigned int index, UserInfo const &ui);
 void delete_user_by_index(unsigned int index);
 bool new_user(UserInfo const &ui);